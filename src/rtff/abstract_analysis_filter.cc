@@ -0,0 +1,88 @@
+#include "rtff/abstract_analysis_filter.h"
+
+#include "rtff/buffer/buffer.h"
+#include "rtff/buffer/overlap_ring_buffer.h"
+#include "rtff/denormal.h"
+#include "rtff/filter_impl.h"
+
+namespace rtff {
+
+class AbstractAnalysisFilter::Impl {
+ public:
+  TimeAmplitudeBuffer amplitude_block;
+  TimeFrequencyBuffer frequential_block;
+  std::vector<const std::complex<float>*> frequential_data;
+};
+
+AbstractAnalysisFilter::AbstractAnalysisFilter()
+    : fft_size_(2048),
+      overlap_(2048 * 0.5),
+      window_type_(fft_window::Type::Hamming),
+      channel_count_(0) {}
+
+AbstractAnalysisFilter::~AbstractAnalysisFilter() {}
+
+void AbstractAnalysisFilter::Init(uint32_t channel_count, uint32_t fft_size,
+                                  uint32_t overlap, std::error_code& err) {
+  Init(channel_count, fft_size, overlap, fft_window::Type::Hamming, err);
+}
+
+void AbstractAnalysisFilter::Init(uint32_t channel_count, uint32_t fft_size,
+                                  uint32_t overlap,
+                                  fft_window::Type windows_type,
+                                  std::error_code& err) {
+  fft_size_ = fft_size;
+  overlap_ = overlap;
+  window_type_ = windows_type;
+  Init(channel_count, err);
+}
+
+void AbstractAnalysisFilter::Init(uint32_t channel_count, std::error_code& err) {
+  channel_count_ = channel_count;
+  input_buffer_ = std::make_shared<MultichannelOverlapRingBuffer>(
+      fft_size(), hop_size(), channel_count);
+
+  // init single block buffers
+  buffers_ = std::make_shared<Impl>();
+  buffers_->amplitude_block.Init(fft_size(), channel_count);
+  buffers_->frequential_block.Init(fft_size() / 2 + 1, channel_count);
+  for (auto data : buffers_->frequential_block.data_ptr()) {
+    buffers_->frequential_data.push_back(data);
+  }
+
+  impl_ = std::make_shared<FilterImpl>();
+  impl_->Init(fft_size(), overlap(), windows_type(), channel_count,
+              FilterImpl::Mode::Analysis, err);
+  if (err) {
+    return;
+  }
+  PrepareToPlay();
+}
+
+uint32_t AbstractAnalysisFilter::fft_size() const { return fft_size_; }
+uint32_t AbstractAnalysisFilter::overlap() const { return overlap_; }
+fft_window::Type AbstractAnalysisFilter::windows_type() const {
+  return window_type_;
+}
+uint32_t AbstractAnalysisFilter::hop_size() const {
+  return fft_size_ - overlap_;
+}
+uint32_t AbstractAnalysisFilter::channel_count() const {
+  return channel_count_;
+}
+
+void AbstractAnalysisFilter::ProcessBlock(const AudioBuffer& buffer) {
+  ScopedDenormalFlush denormal_flush;
+  input_buffer_->Write(buffer, buffer.frame_count());
+
+  // analyze as many blocks as possible
+  while (input_buffer_->Read(&(buffers_->amplitude_block))) {
+    impl_->Analyze(buffers_->amplitude_block, &(buffers_->frequential_block));
+    ProcessAnalyzedBlock(buffers_->frequential_data,
+                         buffers_->frequential_block.size());
+  }
+}
+
+void AbstractAnalysisFilter::PrepareToPlay() {}
+
+}  // namespace rtff
@@ -0,0 +1,121 @@
+#ifndef RTFF_ABSTRACT_ANALYSIS_FILTER_H_
+#define RTFF_ABSTRACT_ANALYSIS_FILTER_H_
+
+#include <complex>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+#include "rtff/buffer/audio_buffer.h"
+
+#include "rtff/fft/window_type.h"
+
+namespace rtff {
+
+class MultichannelOverlapRingBuffer;
+class FilterImpl;
+
+/**
+ * @brief Base class of analysis only frequential filters.
+ * Feed raw audio data and observe it in the time frequency domain. Nothing is
+ * synthesized back: no inverse transform, overlap-add state nor output buffer
+ * is allocated.
+ * @note frame n covers the input samples [n * hop_size, n * hop_size +
+ * fft_size[
+ */
+class AbstractAnalysisFilter {
+ public:
+  AbstractAnalysisFilter();
+  virtual ~AbstractAnalysisFilter();
+  /**
+   * @brief Initialize the filter with the default Hamming window
+   * @param channel_count: the number of channel of the input signal
+   * @param fft_size: the length in samples of the fourier transform window.
+   * @param overlap: the number of samples that will be kept between each
+   * window.
+   * @param err: an error code that gets set if something goes wrong
+   */
+  void Init(uint32_t channel_count, uint32_t fft_size, uint32_t overlap,
+            std::error_code& err);
+
+  /**
+   * @brief Initialize the filter
+   * @param channel_count: the number of channel of the input signal
+   * @param fft_size: the length in samples of the fourier transform window.
+   * @param overlap: the number of samples that will be kept between each
+   * window.
+   * @param windows_type: type of analysis window for FFT
+   * @param err: an error code that gets set if something goes wrong
+   */
+  void Init(uint32_t channel_count, uint32_t fft_size, uint32_t overlap,
+            fft_window::Type windows_type, std::error_code& err);
+
+  /**
+   * @brief Initialize the filter with default stft parameters
+   * @param channel_count: the number of channel of the input signal
+   * @param err: an error code that gets set if something goes wrong
+   */
+  void Init(uint32_t channel_count, std::error_code& err);
+
+  /**
+   * @brief Analyze a buffer
+   * @note the buffer should have the same channel_count as the filter. Its
+   * frame count may vary from one call to the other but should not exceed
+   * 7 * fft_size
+   * @param buffer: the data. It is left untouched
+   */
+  virtual void ProcessBlock(const AudioBuffer& buffer);
+
+  /**
+   * @return the fft size in samples
+   */
+  uint32_t fft_size() const;
+  /**
+   * @return the overlap in samples
+   */
+  uint32_t overlap() const;
+  /**
+   * @return the windows type
+   */
+  fft_window::Type windows_type() const;
+  /**
+   * @return the hop size in sample
+   */
+  uint32_t hop_size() const;
+  /**
+   * @return the number of channel of the input signal
+   */
+  uint32_t channel_count() const;
+
+ protected:
+  /**
+   * @brief function called at the end of the initialization process.
+   * @note Override this to initialize custom member in child classes
+   */
+  virtual void PrepareToPlay();
+
+  /**
+   * @brief Observe a frequential buffer.
+   * @note that function is called by the ProcessBlock function. It shouldn't be
+   * called on its own
+   * Override this function to design your analysis
+   */
+  virtual void ProcessAnalyzedBlock(std::vector<const std::complex<float>*> data,
+                                    uint32_t size) = 0;
+
+ private:
+  uint32_t fft_size_;
+  uint32_t overlap_;
+  fft_window::Type window_type_;
+  uint32_t channel_count_;
+  std::shared_ptr<MultichannelOverlapRingBuffer> input_buffer_;
+
+  std::shared_ptr<FilterImpl> impl_;
+
+  class Impl;
+  std::shared_ptr<Impl> buffers_;
+};
+
+}  // namespace rtff
+
+#endif  // RTFF_ABSTRACT_ANALYSIS_FILTER_H_
@@ -1,126 +1,863 @@
 #include "rtff/abstract_filter.h"
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <utility>
+
+#include "rtff/buffer/arena.h"
 #include "rtff/buffer/buffer.h"
+#include "rtff/denormal.h"
 #include "rtff/filter_impl.h"
+#include "rtff/stft_config.h"
 #include "rtff/buffer/ring_buffer.h"
 #include "rtff/buffer/overlap_ring_buffer.h"
 
 namespace rtff {
 
+namespace {
+
+// trace span names of the StageCounters stages
+const char* kStageNames[StageCounters::kStageCount] = {
+    "InputCopy", "Analyze", "Process", "Synthesize", "OutputCopy"};
+
+}  // namespace
+
 class AbstractFilter::Impl {
  public:
+  // the analyzed frames, kept in place until their lookahead frames are
+  // analyzed. The frame processed next is the oldest one
+  struct FrameRing {
+    /**
+     * @brief allocate lookahead + 1 frames
+     * @param arena: an allocated arena the frames were reserved in. If
+     * nullptr, the frames allocate their own memory
+     */
+    void Init(uint32_t lookahead, uint32_t bin_count, uint32_t channel_count,
+              std::shared_ptr<Arena> arena = nullptr) {
+      frames.resize(lookahead + 1);
+      for (auto& frame : frames) {
+        frame.Init(bin_count, channel_count, arena);
+      }
+      silent_channels.assign(lookahead + 1,
+                             std::vector<uint8_t>(channel_count, 0));
+      Reset();
+    }
+    void Reset() {
+      oldest = 0;
+      count = 0;
+    }
+    /**
+     * @return the slot the next analyzed frame is written to
+     */
+    uint32_t next() const { return (oldest + count) % frames.size(); }
+    /**
+     * @return true when the oldest frame has all its lookahead frames
+     */
+    bool full() const { return count == frames.size(); }
+
+    std::vector<TimeFrequencyBuffer> frames;
+    // the silent channels of each frame
+    std::vector<std::vector<uint8_t>> silent_channels;
+    uint32_t oldest = 0;
+    uint32_t count = 0;
+  };
+
+  // a configuration Reconfigure can switch to. Its transforms and single
+  // block buffers are swapped with the filter ones while it is processed
+  struct Configuration {
+    uint32_t fft_size;
+    uint32_t overlap;
+    fft_window::Type window_type;
+    fft_window::Type synthesis_window_type;
+    std::shared_ptr<FilterImpl> impl;
+    TimeAmplitudeBuffer amplitude_block;
+    TimeAmplitudeBuffer output_amplitude_block;
+    FrameRing frequential_blocks;
+  };
+
+  /**
+   * @return the index of a prepared configuration, -1 if there is none
+   */
+  int32_t Find(uint32_t fft_size, uint32_t overlap,
+               fft_window::Type windows_type) const {
+    for (size_t idx = 0; idx < configurations.size(); idx++) {
+      auto& configuration = configurations[idx];
+      if (configuration.fft_size == fft_size &&
+          configuration.overlap == overlap &&
+          configuration.window_type == windows_type &&
+          configuration.synthesis_window_type == windows_type) {
+        return static_cast<int32_t>(idx);
+      }
+    }
+    return -1;
+  }
+
   TimeAmplitudeBuffer amplitude_block;
   TimeAmplitudeBuffer output_amplitude_block;
-  TimeFrequencyBuffer frequential_block;
+  FrameRing frequential_blocks;
+  std::vector<uint8_t> active_channels;
+
+  // the prepared configurations, except the current one
+  std::vector<Configuration> configurations;
+  // the configuration being switched to, -1 when not switching
+  int32_t pending_idx = -1;
+  // the ring buffers of the configuration being switched to
+  std::shared_ptr<MultichannelOverlapRingBuffer> pending_input_buffer;
+  std::shared_ptr<MultichannelRingBuffer> pending_output_buffer;
+  // the number of frames processed since the switch started, the number of
+  // frames before the new output is complete and the crossfade length
+  uint32_t switch_position = 0;
+  uint32_t crossfade_start = 0;
+  uint32_t crossfade_size = 0;
+  // the output of the configuration being switched to
+  std::shared_ptr<AudioBuffer> crossfade_block;
+  // integer samples are processed as floats while switching
+  std::shared_ptr<AudioBuffer> pcm_block;
 };
 
 AbstractFilter::AbstractFilter() :
   fft_size_(2048),
   overlap_(2048 * 0.5),
   window_type_(fft_window::Type::Hamming),
-  block_size_(512) {}
+  synthesis_window_type_(fft_window::Type::Hamming),
+  overlap_save_(false),
+  block_size_(512),
+  max_fft_size_(0),
+  huge_pages_(false),
+  dither_enabled_(false),
+  pair_transforms_(false),
+  denormal_flush_(true),
+  tail_flush_threshold_(0),
+  frame_history_size_(0),
+  frame_history_storage_(FrameHistory::Storage::Complex),
+  lookahead_(0),
+  lookahead_source_(nullptr),
+  silence_threshold_(-1) {}
 
 AbstractFilter::~AbstractFilter() {}
 
-void AbstractFilter::Init(uint8_t channel_count, uint32_t fft_size,
+void AbstractFilter::Init(uint32_t channel_count, uint32_t fft_size,
                           uint32_t overlap, std::error_code& err) {
   Init(channel_count, fft_size, overlap, fft_window::Type::Hamming, err);
 }
 
-void AbstractFilter::Init(uint8_t channel_count, uint32_t fft_size,
+void AbstractFilter::Init(uint32_t channel_count, uint32_t fft_size,
                           uint32_t overlap, fft_window::Type windows_type,
                           std::error_code& err) {
+  Init(channel_count, fft_size, overlap, windows_type, windows_type, err);
+}
+
+void AbstractFilter::Init(uint32_t channel_count, uint32_t fft_size,
+                          uint32_t overlap,
+                          fft_window::Type analysis_windows_type,
+                          fft_window::Type synthesis_windows_type,
+                          std::error_code& err) {
   fft_size_ = fft_size;
   overlap_ = overlap;
-  window_type_ = windows_type;
+  window_type_ = analysis_windows_type;
+  synthesis_window_type_ = synthesis_windows_type;
+  overlap_save_ = false;
+  max_fft_size_ = 0;
   Init(channel_count, err);
 }
 
-void AbstractFilter::Init(uint8_t channel_count, std::error_code& err) {
+void AbstractFilter::InitOverlapSave(uint32_t channel_count, uint32_t fft_size,
+                                     uint32_t filter_length,
+                                     std::error_code& err) {
+  if (filter_length == 0 || filter_length > fft_size) {
+    err = std::make_error_code(std::errc::invalid_argument);
+    return;
+  }
+  fft_size_ = fft_size;
+  overlap_ = filter_length - 1;
+  window_type_ = fft_window::Type::Rectangular;
+  synthesis_window_type_ = fft_window::Type::Rectangular;
+  overlap_save_ = true;
+  max_fft_size_ = 0;
+  Init(channel_count, err);
+}
+
+void AbstractFilter::Init(uint32_t channel_count, std::error_code& err) {
+  if (max_fft_size_ && fft_size() > max_fft_size_) {
+    err = std::make_error_code(std::errc::invalid_argument);
+    return;
+  }
   channel_count_ = channel_count;
-  InitBuffers();
+  auto config =
+      overlap_save()
+          ? StftConfig::GetOverlapSave(fft_size(), overlap() + 1, err)
+          : StftConfig::Get(fft_size(), overlap(), windows_type(),
+                            synthesis_windows_type(), err);
+  if (err) {
+    return;
+  }
+  auto arena = AllocateArena(*config, err);
+  if (err) {
+    return;
+  }
 
-  // init single block buffers
   buffers_ = std::make_shared<Impl>();
-  buffers_->amplitude_block.Init(fft_size(), channel_count);
-  buffers_->output_amplitude_block.Init(hop_size(), channel_count);
-  buffers_->frequential_block.Init(fft_size() / 2 + 1, channel_count);
+  buffers_->active_channels.assign(channel_count, 1);
+  InitBuffers(arena);
 
   impl_ = std::make_shared<FilterImpl>();
-  impl_->Init(fft_size(), overlap(), windows_type(), channel_count, err);
+  impl_->Init(config, channel_count, FilterImpl::Mode::AnalysisSynthesis,
+              arena, err);
   if (err) {
     return;
   }
+  impl_->set_pair_transforms(pair_transforms_, err);
+  if (err) {
+    return;
+  }
+  impl_->set_tail_flush_threshold(tail_flush_threshold_);
+  InitFrameHistory();
   PrepareToPlay();
 }
 
-void AbstractFilter::InitBuffers() {
-  input_buffer_ = std::make_shared<MultichannelOverlapRingBuffer>(
-      fft_size(), hop_size(), channel_count());
+std::shared_ptr<Arena> AbstractFilter::AllocateArena(
+    const StftConfig& config, std::error_code& err) const {
+  // every buffer of the filter is reserved here, in a single allocation.
+  // A prepared filter has a second pair of ring buffers for the
+  // configuration it switches to, and every ring fits the max fft size
+  auto arena = std::make_shared<Arena>();
+  auto ring_count = max_fft_size_ ? 2 : 1;
+  for (auto ring_idx = 0; ring_idx < ring_count; ring_idx++) {
+    MultichannelOverlapRingBuffer::Reserve(std::max(max_fft_size_, fft_size()),
+                                           channel_count(), arena.get());
+    MultichannelRingBuffer::Reserve(OutputBufferSize(), channel_count(),
+                                    arena.get());
+  }
+  TimeAmplitudeBuffer::Reserve(fft_size(), channel_count(), arena.get());
+  TimeAmplitudeBuffer::Reserve(hop_size(), channel_count(), arena.get());
+  for (uint32_t frame_idx = 0; frame_idx <= lookahead_; frame_idx++) {
+    TimeFrequencyBuffer::Reserve(fft_size() / 2 + 1, channel_count(),
+                                 arena.get());
+  }
+  FilterImpl::ReserveBuffers(config, channel_count(),
+                             FilterImpl::Mode::AnalysisSynthesis, arena.get());
+  arena->Allocate(huge_pages_, err);
+  return arena;
+}
 
+uint32_t AbstractFilter::OutputBufferSize() const {
   // We must make sure the ring buffer is not smaller than the hop size, because
   // the output amplitude buffer will try to write blocks of hop size into it
+  auto max_hop_size = std::max(max_fft_size_, hop_size());
   uint32_t arbitrary_buffer_size = block_size() * 8;
-  if (arbitrary_buffer_size <= hop_size()) {
-    arbitrary_buffer_size = hop_size() * 2;
+  if (arbitrary_buffer_size <= max_hop_size) {
+    arbitrary_buffer_size = max_hop_size * 2;
   }
-  output_buffer_ = std::make_shared<MultichannelRingBuffer>(
-      arbitrary_buffer_size, channel_count());
+  return arbitrary_buffer_size;
+}
 
-  // initialize the intput_buffer_ with hop_size frames of zeros
+void AbstractFilter::ResetBuffers(MultichannelOverlapRingBuffer* input_buffer,
+                                  MultichannelRingBuffer* output_buffer) const {
+  input_buffer->Reset(fft_size(), hop_size());
+  output_buffer->Reset();
+
+  // initialize the input buffer with zeros
   if (fft_size() > block_size()) {
-    input_buffer_->InitWithZeros(fft_size() - block_size());
+    input_buffer->InitWithZeros(fft_size() - block_size());
+  }
+}
+
+void AbstractFilter::InitBuffers(std::shared_ptr<Arena> arena) {
+  auto ring_fft_size = std::max(max_fft_size_, fft_size());
+  input_buffer_ = std::make_shared<MultichannelOverlapRingBuffer>(
+      ring_fft_size, hop_size(), channel_count(), arena);
+  input_buffer_->set_silence_threshold(silence_threshold_);
+  output_buffer_ = std::make_shared<MultichannelRingBuffer>(
+      OutputBufferSize(), channel_count(), arena);
+  ResetBuffers(input_buffer_.get(), output_buffer_.get());
+
+  // init single block buffers
+  buffers_->amplitude_block.Init(fft_size(), channel_count(), arena);
+  buffers_->output_amplitude_block.Init(hop_size(), channel_count(), arena);
+  buffers_->frequential_blocks.Init(lookahead_, fft_size() / 2 + 1,
+                                    channel_count(), arena);
+
+  // any switch is cancelled
+  buffers_->pending_idx = -1;
+  if (max_fft_size_) {
+    buffers_->pending_input_buffer =
+        std::make_shared<MultichannelOverlapRingBuffer>(
+            ring_fft_size, hop_size(), channel_count(), arena);
+    buffers_->pending_input_buffer->set_silence_threshold(silence_threshold_);
+    buffers_->pending_output_buffer = std::make_shared<MultichannelRingBuffer>(
+        OutputBufferSize(), channel_count(), arena);
+    buffers_->crossfade_block =
+        std::make_shared<AudioBuffer>(block_size(), channel_count());
+    buffers_->pcm_block =
+        std::make_shared<AudioBuffer>(block_size(), channel_count());
+  }
+}
+
+void AbstractFilter::Prepare(uint32_t max_fft_size, uint32_t channel_count,
+                             std::error_code& err) {
+  if (overlap_save()) {
+    err = std::make_error_code(std::errc::not_supported);
+    return;
+  }
+  if (max_fft_size < fft_size()) {
+    err = std::make_error_code(std::errc::invalid_argument);
+    return;
+  }
+  max_fft_size_ = max_fft_size;
+  Init(channel_count, err);
+}
+
+void AbstractFilter::PrepareConfiguration(uint32_t fft_size, uint32_t overlap,
+                                          fft_window::Type windows_type,
+                                          std::error_code& err) {
+  if (!max_fft_size_ || !impl_ || fft_size > max_fft_size_) {
+    err = std::make_error_code(std::errc::invalid_argument);
+    return;
+  }
+  auto current = fft_size_ == fft_size && overlap_ == overlap &&
+                 window_type_ == windows_type &&
+                 synthesis_window_type_ == windows_type;
+  if (current || buffers_->Find(fft_size, overlap, windows_type) >= 0) {
+    return;
+  }
+  auto config = StftConfig::Get(fft_size, overlap, windows_type, err);
+  if (err) {
+    return;
+  }
+
+  Impl::Configuration configuration;
+  configuration.fft_size = fft_size;
+  configuration.overlap = overlap;
+  configuration.window_type = windows_type;
+  configuration.synthesis_window_type = windows_type;
+  configuration.impl = std::make_shared<FilterImpl>();
+  configuration.impl->Init(config, channel_count(),
+                           FilterImpl::Mode::AnalysisSynthesis, err);
+  if (err) {
+    return;
+  }
+  configuration.impl->set_pair_transforms(pair_transforms_, err);
+  if (err) {
+    return;
+  }
+  configuration.impl->set_tail_flush_threshold(tail_flush_threshold_);
+  configuration.amplitude_block.Init(fft_size, channel_count());
+  configuration.output_amplitude_block.Init(fft_size - overlap,
+                                            channel_count());
+  configuration.frequential_blocks.Init(lookahead_, fft_size / 2 + 1,
+                                        channel_count());
+  buffers_->configurations.push_back(std::move(configuration));
+}
+
+void AbstractFilter::Reconfigure(uint32_t fft_size, uint32_t overlap,
+                                 fft_window::Type windows_type,
+                                 std::error_code& err) {
+  if (!max_fft_size_ || !impl_) {
+    err = std::make_error_code(std::errc::invalid_argument);
+    return;
+  }
+  if (fft_size_ == fft_size && overlap_ == overlap &&
+      window_type_ == windows_type && synthesis_window_type_ == windows_type) {
+    // back to the current configuration
+    buffers_->pending_idx = -1;
+    return;
+  }
+  auto pending_idx = buffers_->Find(fft_size, overlap, windows_type);
+  if (pending_idx < 0) {
+    err = std::make_error_code(std::errc::invalid_argument);
+    return;
+  }
+
+  // the new configuration starts as a new stream. Its output is complete
+  // once its first frames don't overlap the zeros the stream starts with
+  buffers_->pending_idx = pending_idx;
+  SwapPending();
+  impl_->Reset();
+  ResetBuffers(input_buffer_.get(), output_buffer_.get());
+  buffers_->frequential_blocks.Reset();
+  buffers_->crossfade_start = FrameLatency() + this->fft_size();
+  buffers_->crossfade_size = this->fft_size();
+  SwapPending();
+  buffers_->switch_position = 0;
+}
+
+bool AbstractFilter::reconfiguring() const {
+  return buffers_ && buffers_->pending_idx >= 0;
+}
+uint32_t AbstractFilter::max_fft_size() const { return max_fft_size_; }
+
+void AbstractFilter::SwapPending() {
+  auto& pending = buffers_->configurations[buffers_->pending_idx];
+  std::swap(fft_size_, pending.fft_size);
+  std::swap(overlap_, pending.overlap);
+  std::swap(window_type_, pending.window_type);
+  std::swap(synthesis_window_type_, pending.synthesis_window_type);
+  std::swap(impl_, pending.impl);
+  std::swap(buffers_->amplitude_block, pending.amplitude_block);
+  std::swap(buffers_->output_amplitude_block, pending.output_amplitude_block);
+  std::swap(buffers_->frequential_blocks, pending.frequential_blocks);
+  std::swap(input_buffer_, buffers_->pending_input_buffer);
+  std::swap(output_buffer_, buffers_->pending_output_buffer);
+}
+
+void AbstractFilter::Crossfade(AudioBuffer* buffer) {
+  auto& state = *buffers_;
+  auto frame_count = buffer->frame_count();
+  auto& pending = *state.crossfade_block;
+  if (!state.pending_output_buffer->Read(&pending, frame_count)) {
+    for (auto channel_idx = 0; channel_idx < channel_count(); channel_idx++) {
+      std::fill(pending.data(channel_idx),
+                pending.data(channel_idx) + frame_count, 0);
+    }
+  }
+
+  // the current output is kept until the new one is complete
+  if (state.switch_position + frame_count > state.crossfade_start) {
+    for (auto channel_idx = 0; channel_idx < channel_count(); channel_idx++) {
+      auto output = buffer->data(channel_idx);
+      auto input = pending.data(channel_idx);
+      for (uint32_t frame_idx = 0; frame_idx < frame_count; frame_idx++) {
+        auto position = state.switch_position + frame_idx;
+        if (position < state.crossfade_start) {
+          continue;
+        }
+        auto gain = std::min(
+            1.f, static_cast<float>(position - state.crossfade_start + 1) /
+                     state.crossfade_size);
+        output[frame_idx] += gain * (input[frame_idx] - output[frame_idx]);
+      }
+    }
+  }
+
+  state.switch_position += frame_count;
+  if (state.switch_position >= state.crossfade_start + state.crossfade_size) {
+    // the filter only runs the new configuration from now on
+    SwapPending();
+    state.pending_idx = -1;
+    frame_history_.Reset(fft_size() / 2 + 1);
   }
 }
 
 void AbstractFilter::set_block_size(uint32_t value) {
   block_size_ = value;
-  InitBuffers();
+  ReallocateBuffers();
   PrepareToPlay();
 }
+
+void AbstractFilter::ReallocateBuffers() {
+  // the buffers are allocated by Init
+  if (!impl_) {
+    return;
+  }
+  std::error_code err;
+  auto arena = AllocateArena(*impl_->config(), err);
+  if (!err) {
+    impl_->InitBuffers(arena, err);
+  }
+  if (err) {
+    throw std::bad_alloc();
+  }
+  InitBuffers(arena);
+}
+
+void AbstractFilter::set_huge_pages(bool enabled) { huge_pages_ = enabled; }
+bool AbstractFilter::huge_pages() const { return huge_pages_; }
+
 uint32_t AbstractFilter::block_size() const { return block_size_; }
-uint8_t AbstractFilter::channel_count() const { return channel_count_; }
+uint32_t AbstractFilter::channel_count() const { return channel_count_; }
 
 uint32_t AbstractFilter::window_size() const { return impl_->window_size(); }
 uint32_t AbstractFilter::fft_size() const { return fft_size_; }
 uint32_t AbstractFilter::overlap() const { return overlap_; }
 fft_window::Type AbstractFilter::windows_type() const { return window_type_; }
+fft_window::Type AbstractFilter::synthesis_windows_type() const {
+  return synthesis_window_type_;
+}
 uint32_t AbstractFilter::hop_size() const { return fft_size_ - overlap_; }
+bool AbstractFilter::overlap_save() const { return overlap_save_; }
 
 uint32_t AbstractFilter::FrameLatency() const {
+  // overlap-save outputs the end of each frame instead of its start
+  auto saved = overlap_save() ? overlap() : 0;
   // latency has three different states:
+  // the synthesis waits for the lookahead frames
+  auto lookahead = lookahead_ * hop_size();
   if (hop_size() % block_size() == 0) {
     // when hop size can be devided by block size
-    return fft_size() - block_size();
+    return fft_size() - block_size() - saved + lookahead;
   } else if (block_size() < fft_size()) {
-    return fft_size();
+    return fft_size() - saved + lookahead;
   } else {
-    return block_size();
+    return block_size() - saved + lookahead;
   }
 }
 
+void AbstractFilter::set_dither(bool enabled) { dither_enabled_ = enabled; }
+bool AbstractFilter::dither() const { return dither_enabled_; }
+
+void AbstractFilter::set_pair_transforms(bool enabled, std::error_code& err) {
+  if (impl_) {
+    impl_->set_pair_transforms(enabled, err);
+    if (err) {
+      return;
+    }
+    for (auto& configuration : buffers_->configurations) {
+      configuration.impl->set_pair_transforms(enabled, err);
+      if (err) {
+        return;
+      }
+    }
+  }
+  pair_transforms_ = enabled;
+}
+bool AbstractFilter::pair_transforms() const { return pair_transforms_; }
+
+void AbstractFilter::set_denormal_flush(bool enabled) {
+  denormal_flush_ = enabled;
+}
+bool AbstractFilter::denormal_flush() const { return denormal_flush_; }
+
+void AbstractFilter::set_tail_flush_threshold(float threshold) {
+  tail_flush_threshold_ = std::abs(threshold);
+  if (impl_) {
+    impl_->set_tail_flush_threshold(tail_flush_threshold_);
+    for (auto& configuration : buffers_->configurations) {
+      configuration.impl->set_tail_flush_threshold(tail_flush_threshold_);
+    }
+  }
+}
+float AbstractFilter::tail_flush_threshold() const {
+  return tail_flush_threshold_;
+}
+
+void AbstractFilter::set_frame_history(uint32_t frame_count,
+                                       FrameHistory::Storage storage) {
+  frame_history_size_ = frame_count;
+  frame_history_storage_ = storage;
+  // the history is allocated by Init
+  if (impl_) {
+    InitFrameHistory();
+  }
+}
+const FrameHistory& AbstractFilter::frame_history() const {
+  return frame_history_;
+}
+
+void AbstractFilter::set_lookahead(uint32_t frame_count) {
+  lookahead_ = frame_count;
+  if (impl_) {
+    for (auto& configuration : buffers_->configurations) {
+      configuration.frequential_blocks.Init(
+          lookahead_, configuration.fft_size / 2 + 1, channel_count());
+    }
+  }
+  ReallocateBuffers();
+}
+uint32_t AbstractFilter::lookahead() const { return lookahead_; }
+
+const std::complex<float>* AbstractFilter::lookahead_frame(
+    uint32_t frame_idx, uint32_t channel_idx) const {
+  auto& source = lookahead_source_ ? *lookahead_source_ : *this;
+  auto& ring = source.buffers_->frequential_blocks;
+  assert(frame_idx < ring.frames.size());
+  auto slot = (ring.oldest + frame_idx) % ring.frames.size();
+  return ring.frames[slot].matrix().col(channel_idx).data();
+}
+
+void AbstractFilter::InitFrameHistory() {
+  // room for the largest configuration Reconfigure can switch to
+  auto max_fft_size = std::max(max_fft_size_, fft_size());
+  frame_history_.Init(frame_history_size_, max_fft_size / 2 + 1,
+                      channel_count(), frame_history_storage_);
+  frame_history_.Reset(fft_size() / 2 + 1);
+}
+
+void AbstractFilter::set_silence_detection(bool enabled, float threshold) {
+  silence_threshold_ = enabled ? std::abs(threshold) : -1;
+  if (input_buffer_) {
+    input_buffer_->set_silence_threshold(silence_threshold_);
+  }
+  if (buffers_ && buffers_->pending_input_buffer) {
+    buffers_->pending_input_buffer->set_silence_threshold(silence_threshold_);
+  }
+}
+bool AbstractFilter::silence_detection() const {
+  return silence_threshold_ >= 0;
+}
+
+void AbstractFilter::set_channel_active(uint32_t channel_idx, bool active) {
+  buffers_->active_channels[channel_idx] = active;
+}
+bool AbstractFilter::channel_active(uint32_t channel_idx) const {
+  return buffers_->active_channels[channel_idx];
+}
+
 void AbstractFilter::ProcessBlock(AudioBuffer* buffer) {
+  ScopedDenormalFlush denormal_flush(denormal_flush_);
+  auto deadline_start = deadline_monitor_.Start();
+  auto block_start = InstrumentationTime();
+  auto time = block_start;
   auto frame_count = buffer->frame_count();
   input_buffer_->Write(*buffer, frame_count);
+  auto switching = buffers_->pending_idx >= 0;
+  if (switching) {
+    // the configuration being switched to processes the same input
+    buffers_->pending_input_buffer->Write(*buffer, frame_count);
+  }
 
-  // process as many blocks as possible
-  while (input_buffer_->Read(&(buffers_->amplitude_block))) {
-    impl_->Analyze(buffers_->amplitude_block, &(buffers_->frequential_block));
-    ProcessTransformedBlock(buffers_->frequential_block.data_ptr(),
-                            buffers_->frequential_block.size());
-    impl_->Synthesize(buffers_->frequential_block,
-                      &(buffers_->output_amplitude_block));
-    output_buffer_->Write(buffers_->output_amplitude_block,
-                          buffers_->output_amplitude_block.size());
+  auto hop_count = ProcessAvailableFrames(&time);
+  if (switching) {
+    SwapPending();
+    // the history only keeps the frames of the current configuration
+    hop_count += ProcessAvailableFrames(&time, false);
+    SwapPending();
   }
 
-  if (output_buffer_->Read(buffer, frame_count)) {
+  if (!output_buffer_->Read(buffer, frame_count)) {
+    // if we don't have enough data to be read, just fill with zeros
+    for (auto channel_idx = 0; channel_idx < buffer->channel_count(); channel_idx++) {
+      std::fill(buffer->data(channel_idx), buffer->data(channel_idx) + frame_count, 0);
+    }
+  }
+  if (switching) {
+    Crossfade(buffer);
+  }
+  RecordBlock(block_start, time, frame_count, hop_count);
+  deadline_monitor_.Stop(deadline_start, frame_count, hop_count);
+}
+
+void AbstractFilter::ProcessInterleavedBlock(const int16_t* input,
+                                             int16_t* output) {
+  ProcessInterleaved(input, output);
+}
+void AbstractFilter::ProcessInterleavedBlock(const pcm::Int24* input,
+                                             pcm::Int24* output) {
+  ProcessInterleaved(input, output);
+}
+void AbstractFilter::ProcessInterleavedBlock(const int32_t* input,
+                                             int32_t* output) {
+  ProcessInterleaved(input, output);
+}
+
+void AbstractFilter::ProcessPlanarBlock(const int16_t* const* input,
+                                        int16_t* const* output) {
+  ProcessPlanar(input, output);
+}
+void AbstractFilter::ProcessPlanarBlock(const pcm::Int24* const* input,
+                                        pcm::Int24* const* output) {
+  ProcessPlanar(input, output);
+}
+void AbstractFilter::ProcessPlanarBlock(const int32_t* const* input,
+                                        int32_t* const* output) {
+  ProcessPlanar(input, output);
+}
+
+template <typename T>
+void AbstractFilter::ProcessInterleaved(const T* input, T* output) {
+  if (buffers_->pending_idx >= 0) {
+    // the outputs are crossfaded as floats while switching
+    auto& block = *buffers_->pcm_block;
+    for (auto channel_idx = 0; channel_idx < channel_count(); channel_idx++) {
+      pcm::ToFloat(input + channel_idx, channel_count(), block_size(),
+                   block.data(channel_idx));
+    }
+    AbstractFilter::ProcessBlock(&block);
+    auto dither = dither_enabled_ ? &dither_ : nullptr;
+    for (auto channel_idx = 0; channel_idx < channel_count(); channel_idx++) {
+      pcm::FromFloat(block.data(channel_idx), block_size(),
+                     output + channel_idx, channel_count(), dither);
+    }
+    return;
+  }
+  ScopedDenormalFlush denormal_flush(denormal_flush_);
+  auto deadline_start = deadline_monitor_.Start();
+  auto block_start = InstrumentationTime();
+  auto time = block_start;
+  auto frame_count = block_size();
+  input_buffer_->WriteInterleaved(input, frame_count);
+
+  auto hop_count = ProcessAvailableFrames(&time);
+
+  auto dither = dither_enabled_ ? &dither_ : nullptr;
+  if (!output_buffer_->ReadInterleaved(output, frame_count, dither)) {
+    // if we don't have enough data to be read, just fill with zeros
+    std::fill(output, output + frame_count * channel_count(), T());
+  }
+  RecordBlock(block_start, time, frame_count, hop_count);
+  deadline_monitor_.Stop(deadline_start, frame_count, hop_count);
+}
+
+template <typename T>
+void AbstractFilter::ProcessPlanar(const T* const* input, T* const* output) {
+  if (buffers_->pending_idx >= 0) {
+    // the outputs are crossfaded as floats while switching
+    auto& block = *buffers_->pcm_block;
+    for (auto channel_idx = 0; channel_idx < channel_count(); channel_idx++) {
+      pcm::ToFloat(input[channel_idx], 1, block_size(),
+                   block.data(channel_idx));
+    }
+    AbstractFilter::ProcessBlock(&block);
+    auto dither = dither_enabled_ ? &dither_ : nullptr;
+    for (auto channel_idx = 0; channel_idx < channel_count(); channel_idx++) {
+      pcm::FromFloat(block.data(channel_idx), block_size(),
+                     output[channel_idx], 1, dither);
+    }
+    return;
+  }
+  ScopedDenormalFlush denormal_flush(denormal_flush_);
+  auto deadline_start = deadline_monitor_.Start();
+  auto block_start = InstrumentationTime();
+  auto time = block_start;
+  auto frame_count = block_size();
+  input_buffer_->WritePlanar(input, frame_count);
+
+  auto hop_count = ProcessAvailableFrames(&time);
+
+  auto dither = dither_enabled_ ? &dither_ : nullptr;
+  if (!output_buffer_->ReadPlanar(output, frame_count, dither)) {
+    // if we don't have enough data to be read, just fill with zeros
+    for (auto channel_idx = 0; channel_idx < channel_count(); channel_idx++) {
+      std::fill(output[channel_idx], output[channel_idx] + frame_count, T());
+    }
+  }
+  RecordBlock(block_start, time, frame_count, hop_count);
+  deadline_monitor_.Stop(deadline_start, frame_count, hop_count);
+}
+
+uint32_t AbstractFilter::ProcessAvailableFrames(uint64_t* time,
+                                               bool keep_history) {
+  using Stage = StageCounters::Stage;
+  uint32_t hop_count = 0;
+  // each frame is read from the input ring and a hop is written to the output
+  const uint64_t frame_bytes =
+      static_cast<uint64_t>(fft_size() + hop_size()) * channel_count() *
+      sizeof(float);
+
+  auto& ring = buffers_->frequential_blocks;
+  auto& active_channels = buffers_->active_channels;
+  auto all_active = std::find(active_channels.begin(), active_channels.end(),
+                              0) == active_channels.end();
+  if (all_active && !silence_detection()) {
+    // process as many blocks as possible
+    while (input_buffer_->Read(&(buffers_->amplitude_block))) {
+      EndStage(Stage::InputCopy, time);
+      impl_->Analyze(buffers_->amplitude_block, &ring.frames[ring.next()]);
+      ring.count++;
+      EndStage(Stage::Analyze, time);
+      ProcessFrame(keep_history, false, time);
+      counters_.AddHop();
+      hop_count++;
+      counters_.AddCopiedBytes(frame_bytes);
+    }
+    EndStage(Stage::InputCopy, time);
+    return hop_count;
+  }
+
+  // same loop, skipping the transforms of silent and inactive channels
+  while (input_buffer_->Read(&(buffers_->amplitude_block),
+                             &ring.silent_channels[ring.next()])) {
+    EndStage(Stage::InputCopy, time);
+    auto& silent_channels = ring.silent_channels[ring.next()];
+    for (auto channel_idx = 0; channel_idx < channel_count(); channel_idx++) {
+      silent_channels[channel_idx] |= !active_channels[channel_idx];
+    }
+    impl_->Analyze(buffers_->amplitude_block, &ring.frames[ring.next()],
+                   silent_channels);
+    ring.count++;
+    EndStage(Stage::Analyze, time);
+    ProcessFrame(keep_history, true, time);
+    counters_.AddHop();
+    hop_count++;
+    counters_.AddCopiedBytes(frame_bytes);
+  }
+  EndStage(Stage::InputCopy, time);
+  return hop_count;
+}
+
+void AbstractFilter::ProcessFrame(bool keep_history, bool skip_silent,
+                                  uint64_t* time) {
+  using Stage = StageCounters::Stage;
+  auto& ring = buffers_->frequential_blocks;
+  auto& output = buffers_->output_amplitude_block;
+  if (!ring.full()) {
+    // the stream starts with one hop of zeros per lookahead frame
+    output.matrix().setZero();
+    EndStage(Stage::Synthesize, time);
+  } else {
+    auto& frame = ring.frames[ring.oldest];
+    auto& silent_channels = ring.silent_channels[ring.oldest];
+    auto data = frame.data_ptr();
+    if (keep_history) {
+      frame_history_.Push(data.data());
+    }
+    auto all_silent =
+        skip_silent && std::find(silent_channels.begin(),
+                                 silent_channels.end(),
+                                 0) == silent_channels.end();
+    if (!all_silent) {
+      ProcessTransformedBlock(data, frame.size());
+    }
+    EndStage(Stage::Process, time);
+    if (skip_silent) {
+      impl_->Synthesize(frame, &output, silent_channels);
+    } else {
+      impl_->Synthesize(frame, &output);
+    }
+    EndStage(Stage::Synthesize, time);
+    ring.oldest = (ring.oldest + 1) % ring.frames.size();
+    ring.count--;
+  }
+  output_buffer_->Write(output, output.size());
+  EndStage(Stage::OutputCopy, time);
+}
+
+uint64_t AbstractFilter::InstrumentationTime() const {
+  if (!StageCounters::enabled() && !tracer_) {
+    return 0;
+  }
+  return Tracer::Now();
+}
+
+void AbstractFilter::EndStage(StageCounters::Stage stage, uint64_t* time) {
+  if (!StageCounters::enabled() && !tracer_) {
     return;
   }
-  // if we don't have enough data to be read, just fill with zeros
-  for (auto channel_idx = 0; channel_idx < buffer->channel_count(); channel_idx++) {
-    std::fill(buffer->data(channel_idx), buffer->data(channel_idx) + frame_count, 0);
+  auto now = Tracer::Now();
+  counters_.Add(stage, now - *time);
+  if (tracer_) {
+    tracer_->Record(kStageNames[static_cast<uint8_t>(stage)], *time, now);
+  }
+  *time = now;
+}
+
+void AbstractFilter::RecordBlock(uint64_t block_start, uint64_t time,
+                                 uint32_t frame_count, uint32_t hop_count) {
+  EndStage(StageCounters::Stage::OutputCopy, &time);
+  if (tracer_) {
+    tracer_->Record("ProcessBlock", block_start, time, frame_count, hop_count);
   }
+  // the block is written to the input ring and read from the output ring
+  counters_.AddCopiedBytes(2 * static_cast<uint64_t>(frame_count) *
+                           channel_count() * sizeof(float));
+  counters_.AddBlock();
+}
+
+const StageCounters& AbstractFilter::stage_counters() const {
+  return counters_;
+}
+StageCounters& AbstractFilter::stage_counters() { return counters_; }
+
+void AbstractFilter::set_tracer(std::shared_ptr<Tracer> tracer) {
+  tracer_ = tracer;
+}
+std::shared_ptr<Tracer> AbstractFilter::tracer() const { return tracer_; }
+
+const DeadlineMonitor& AbstractFilter::deadline_monitor() const {
+  return deadline_monitor_;
+}
+DeadlineMonitor& AbstractFilter::deadline_monitor() {
+  return deadline_monitor_;
 }
 
 void AbstractFilter::PrepareToPlay() {}
@@ -7,14 +7,21 @@
 #include <vector>
 
 #include "rtff/buffer/audio_buffer.h"
+#include "rtff/buffer/pcm.h"
 
 #include "rtff/fft/window_type.h"
+#include "rtff/frame_history.h"
+#include "rtff/instrumentation/deadline_monitor.h"
+#include "rtff/instrumentation/stage_counters.h"
+#include "rtff/instrumentation/tracer.h"
 
 namespace rtff {
 
+class Arena;
 class MultichannelOverlapRingBuffer;
 class MultichannelRingBuffer;
 class FilterImpl;
+class StftConfig;
 
 /**
  * @brief Base class of frequential filters.
@@ -32,7 +39,7 @@ class AbstractFilter {
    * window.
    * @param err: an error code that gets set if something goes wrong
    */
-  void Init(uint8_t channel_count, uint32_t fft_size, uint32_t overlap,
+  void Init(uint32_t channel_count, uint32_t fft_size, uint32_t overlap,
             std::error_code& err);
   
   /**
@@ -45,24 +52,127 @@ class AbstractFilter {
    * to Hamming to ensure backward compatibility
    * @param err: an error code that gets set if something goes wrong
    */
-  void Init(uint8_t channel_count, uint32_t fft_size, uint32_t overlap,
+  void Init(uint32_t channel_count, uint32_t fft_size, uint32_t overlap,
             fft_window::Type windows_type, std::error_code& err);
 
+  /**
+   * @brief Initialize the filter with different analysis and synthesis windows
+   * @note when the windows are constant overlap-add (for instance a periodic
+   * Hann analysis window with a rectangular synthesis window at 50% or 75%
+   * overlap), the synthesis doesn't apply any per sample gain
+   * @param channel_count: the number of channel of the input signal
+   * @param fft_size: the length in samples of the fourier transform window.
+   * @param overlap: the number of samples that will be kept between each
+   * window.
+   * @param analysis_windows_type: type of the analysis window
+   * @param synthesis_windows_type: type of the synthesis window
+   * @param err: an error code that gets set if something goes wrong
+   */
+  void Init(uint32_t channel_count, uint32_t fft_size, uint32_t overlap,
+            fft_window::Type analysis_windows_type,
+            fft_window::Type synthesis_windows_type, std::error_code& err);
+
+  /**
+   * @brief Initialize the filter for linear filtering with overlap-save
+   * @note frames are not windowed and the hop size is fft_size - filter_length
+   * + 1. ProcessTransformedBlock still receives each frame spectrum: when it
+   * multiplies it by the response of a filter of at most filter_length taps,
+   * the output is the exact linear convolution, with no windowing artifact.
+   * The latency is overlap frames lower than with overlap-add
+   * @param channel_count: the number of channel of the input signal
+   * @param fft_size: the length in samples of the fourier transform window.
+   * @param filter_length: the maximum number of taps of the applied filter
+   * @param err: an error code that gets set if something goes wrong
+   */
+  void InitOverlapSave(uint32_t channel_count, uint32_t fft_size,
+                       uint32_t filter_length, std::error_code& err);
+
   /**
    * @brief Initialize the filter with default stft parameters
    * @param channel_count: the number of channel of the input signal
    * @param err: an error code that gets set if something goes wrong
    */
-  void Init(uint8_t channel_count, std::error_code& err);
+  void Init(uint32_t channel_count, std::error_code& err);
+
+  /**
+   * @brief Initialize the filter with room for stft configurations up to
+   * max_fft_size, so that Reconfigure can switch between them while
+   * processing
+   * @note the filter is initialized with its current stft parameters, as
+   * with Init. The configurations to switch to are then added with
+   * PrepareConfiguration. Not supported with overlap-save
+   * @param max_fft_size: the largest fft size of the prepared configurations
+   * @param channel_count: the number of channel of the input signal
+   * @param err: an error code that gets set if something goes wrong
+   */
+  void Prepare(uint32_t max_fft_size, uint32_t channel_count,
+               std::error_code& err);
+  /**
+   * @brief create the transforms, windows and buffers of a configuration
+   * Reconfigure can switch to
+   * @note it allocates, so it must not run concurrently with processing.
+   * Prepare must be called first
+   * @param fft_size: the fft size, up to the max fft size given to Prepare
+   * @param overlap: the overlap
+   * @param windows_type: type of analysis and synthesis window
+   * @param err: an error code that gets set if something goes wrong
+   */
+  void PrepareConfiguration(uint32_t fft_size, uint32_t overlap,
+                            fft_window::Type windows_type,
+                            std::error_code& err);
+  /**
+   * @brief switch to a prepared configuration. It doesn't allocate and can
+   * be called between two blocks on the processing thread
+   * @note the new configuration processes the input next to the current one
+   * until its output is complete, then both outputs are crossfaded over one
+   * frame of the new configuration. During the switch, ProcessTransformedBlock
+   * is called for both configurations, and the accessors match the
+   * configuration of the processed frame. Once the switch is over, the
+   * accessors and FrameLatency report the new configuration.
+   * Switching during a switch starts over, switching back to the current
+   * configuration cancels it. A filter that belongs to a FilterBatch must not
+   * be reconfigured
+   * @param fft_size: the fft size
+   * @param overlap: the overlap
+   * @param windows_type: type of analysis and synthesis window
+   * @param err: an error code that gets set if the configuration wasn't
+   * prepared
+   */
+  void Reconfigure(uint32_t fft_size, uint32_t overlap,
+                   fft_window::Type windows_type, std::error_code& err);
+  /**
+   * @return true while switching to another configuration
+   */
+  bool reconfiguring() const;
+  /**
+   * @return the max fft size given to Prepare, 0 if the filter wasn't prepared
+   */
+  uint32_t max_fft_size() const;
 
   /**
    * @brief define the block size
    * @note the block size correspond to the number of frames contained in each
-   * AudioBuffer sent to filter using the ProcessBlock function
+   * AudioBuffer sent to filter using the ProcessBlock function. The buffers
+   * are allocated again, which resets the stream
    * @param value: the block size
    */
   void set_block_size(uint32_t value);
 
+  /**
+   * @brief back the filter buffers with huge pages. Disabled by default
+   * @note every buffer of a filter is taken out of a single aligned
+   * allocation, made by Init and set_block_size. When enabled and the
+   * allocation is large enough, it is mapped with the transparent huge pages
+   * hint, which reduces TLB misses. Only supported on linux, ignored
+   * elsewhere
+   * @param enabled: true to use huge pages from the next allocation
+   */
+  void set_huge_pages(bool enabled);
+  /**
+   * @return true if huge pages are requested
+   */
+  bool huge_pages() const;
+
   /**
    * @brief Process a buffer
    * @note the buffer should have the same channel_count and its frame_number
@@ -71,10 +181,196 @@ class AbstractFilter {
    */
   virtual void ProcessBlock(AudioBuffer* buffer);
 
+  /**
+   * @brief Process a block of interleaved integer samples
+   * @note samples are converted while being written to and read from the
+   * filter ring buffers, so no float AudioBuffer is needed. Output samples are
+   * saturated and optionally dithered.
+   * @param input: block_size * channel_count interleaved samples
+   * @param output: block_size * channel_count interleaved samples. It can
+   * point to the same memory as input
+   * @see set_dither
+   */
+  void ProcessInterleavedBlock(const int16_t* input, int16_t* output);
+  void ProcessInterleavedBlock(const pcm::Int24* input, pcm::Int24* output);
+  void ProcessInterleavedBlock(const int32_t* input, int32_t* output);
+
+  /**
+   * @brief Process a block of planar integer samples
+   * @param input: channel_count pointers to block_size samples
+   * @param output: channel_count pointers to block_size samples. They can
+   * point to the same memory as input
+   * @see ProcessInterleavedBlock
+   */
+  void ProcessPlanarBlock(const int16_t* const* input, int16_t* const* output);
+  void ProcessPlanarBlock(const pcm::Int24* const* input,
+                          pcm::Int24* const* output);
+  void ProcessPlanarBlock(const int32_t* const* input, int32_t* const* output);
+
+  /**
+   * @brief enable triangular dither when converting the output to integer
+   * samples. Disabled by default
+   * @param enabled: true to dither the integer outputs
+   */
+  void set_dither(bool enabled);
+  /**
+   * @return true if integer outputs are dithered
+   */
+  bool dither() const;
+
+  /**
+   * @brief transform the channels two by two with a single complex fft
+   * instead of one real fft per channel. Disabled by default
+   * @note the frequential data given to ProcessTransformedBlock is the same,
+   * up to rounding errors. An odd last channel is transformed on its own
+   * @param enabled: true to transform channel pairs
+   * @param err: an error code that gets set if the fft backend fails to
+   * prepare the pair transforms
+   */
+  void set_pair_transforms(bool enabled, std::error_code& err);
+  /**
+   * @return true if channels are transformed two by two
+   */
+  bool pair_transforms() const;
+
+  /**
+   * @brief flush denormal floats to zero while processing. Enabled by default
+   * @note denormals appear when the signal decays to silence and slow down
+   * most CPUs. The floating point mode of the calling thread is set by each
+   * Process call and restored before it returns
+   * @see ScopedDenormalFlush
+   * @param enabled: true to flush denormals
+   */
+  void set_denormal_flush(bool enabled);
+  /**
+   * @return true if denormals are flushed while processing
+   */
+  bool denormal_flush() const;
+
+  /**
+   * @brief flush the tiny values of the overlap-add tail. Disabled by default
+   * @note tail samples whose absolute value is lower or equal to the threshold
+   * are set to zero after each synthesis, so a decaying tail reaches zero
+   * without going through denormals, and silent channels stop overlapping it
+   * @param threshold: the flush threshold, 0 to disable the flush
+   */
+  void set_tail_flush_threshold(float threshold);
+  /**
+   * @return the flush threshold of the overlap-add tail
+   */
+  float tail_flush_threshold() const;
+
+  /**
+   * @brief keep the last analyzed frames for ProcessTransformedBlock.
+   * Disabled by default
+   * @note each frame is added to the history right before
+   * ProcessTransformedBlock receives it, so the newest frame of the history
+   * is the one being processed. It allocates, and the history is cleared by
+   * Init and when Reconfigure switches to another configuration
+   * @param frame_count: the number of frames kept, 0 to disable the history
+   * @param storage: how the frames are stored
+   */
+  void set_frame_history(
+      uint32_t frame_count,
+      FrameHistory::Storage storage = FrameHistory::Storage::Complex);
+  /**
+   * @return the last analyzed frames
+   * @see set_frame_history
+   */
+  const FrameHistory& frame_history() const;
+
+  /**
+   * @brief let ProcessTransformedBlock see the frames analyzed after the one
+   * it processes. Disabled by default
+   * @note each analyzed frame stays in place in a ring of lookahead + 1
+   * frames until its lookahead frames are analyzed too, so the synthesis is
+   * delayed by lookahead hops, which FrameLatency reports. Lookahead frames
+   * are read with lookahead_frame and are not processed yet. The buffers are
+   * allocated again, which resets the stream. A filter with lookahead can't
+   * belong to a FilterBatch
+   * @param frame_count: the number of lookahead frames, 0 to disable it
+   */
+  void set_lookahead(uint32_t frame_count);
+  /**
+   * @return the number of lookahead frames
+   */
+  uint32_t lookahead() const;
+  /**
+   * @brief access a frame analyzed after the one being processed, from
+   * ProcessTransformedBlock
+   * @param frame_idx: 1 for the next frame, up to lookahead
+   * @param channel_idx: the channel index
+   * @return the fft_size / 2 + 1 bins of the frame
+   */
+  const std::complex<float>* lookahead_frame(uint32_t frame_idx,
+                                             uint32_t channel_idx) const;
+
+  /**
+   * @brief skip the transforms of silent channels. Disabled by default
+   * @note a channel frame is silent when every sample of its window is silent.
+   * Its spectrum is set to zero and its overlap-add tail keeps being flushed,
+   * so with a zero threshold the output is the same as without detection as
+   * long as ProcessTransformedBlock doesn't create signal out of silence. When
+   * every channel is silent, ProcessTransformedBlock is not called at all
+   * @param enabled: true to enable the detection
+   * @param threshold: samples with an absolute value lower or equal to the
+   * threshold are considered silent
+   */
+  void set_silence_detection(bool enabled, float threshold = 0);
+  /**
+   * @return true if silent channels are detected
+   */
+  bool silence_detection() const;
+
+  /**
+   * @brief enable or disable a channel. Every channel is active after Init
+   * @note inactive channels are neither analyzed nor synthesized. They output
+   * zeros once their overlap-add tail is flushed, and the spectrum sent to
+   * ProcessTransformedBlock is set to zero
+   * @param channel_idx: the channel index
+   * @param active: false to disable the channel
+   */
+  void set_channel_active(uint32_t channel_idx, bool active);
+  /**
+   * @return true if the channel is active
+   */
+  bool channel_active(uint32_t channel_idx) const;
+
+  /**
+   * @brief access the per stage time, hop and copy counters
+   * @note counters are only updated when the library is compiled with
+   * RTFF_ENABLE_INSTRUMENTATION. They can be read from any thread
+   * @return the counters
+   */
+  const StageCounters& stage_counters() const;
+  StageCounters& stage_counters();
+
+  /**
+   * @brief access the real time deadline monitor
+   * @note the monitor is disabled until its sample rate is set. Then each
+   * ProcessBlock call is compared to the duration of its block
+   * @return the monitor
+   */
+  const DeadlineMonitor& deadline_monitor() const;
+  DeadlineMonitor& deadline_monitor();
+
+  /**
+   * @brief trace each ProcessBlock call and each of its stages
+   * @note the tracer can be shared by several filters running on different
+   * threads
+   * @param tracer: the tracer receiving the spans, nullptr to stop tracing
+   */
+  void set_tracer(std::shared_ptr<Tracer> tracer);
+  /**
+   * @return the tracer receiving the spans, if any
+   */
+  std::shared_ptr<Tracer> tracer() const;
+
   /**
    * @brief Acccess the number of frame of latency generated by the filter
    * @note Due to fourier transform computation, a filter most usually creates
-   * latency. It depends on the block size, overlap and fft size.
+   * latency. It depends on the block size, overlap and fft size. The
+   * lookahead adds lookahead hops.
    * @return The latency generated by the filter in frames.
    */
   virtual uint32_t FrameLatency() const;
@@ -91,6 +387,15 @@ class AbstractFilter {
    * @return the windows type
    */
   fft_window::Type windows_type() const;
+  /**
+   * @return the synthesis windows type
+   */
+  fft_window::Type synthesis_windows_type() const;
+  /**
+   * @return true if the filter uses overlap-save
+   * @see InitOverlapSave
+   */
+  bool overlap_save() const;
   /**
    * @return the hop size in sample
    */
@@ -108,9 +413,12 @@ class AbstractFilter {
   /**
    * @return the number of channel of the input signal
    */
-  uint8_t channel_count() const;
+  uint32_t channel_count() const;
 
  protected:
+  friend class FilterBatch;
+  friend class FilterChain;
+
   /**
    * @brief function called at the end of the initialization process.
    * @note Override this to initialize custom member in child classes
@@ -127,13 +435,119 @@ class AbstractFilter {
                                        uint32_t size) = 0;
 
  private:
-  void InitBuffers();
+  /**
+   * @brief reserve and allocate the arena every buffer of the filter is
+   * taken out of
+   * @param config: the stft configuration
+   * @param err: an error code that gets set if the allocation fails
+   * @return the arena
+   */
+  std::shared_ptr<Arena> AllocateArena(const StftConfig& config,
+                                       std::error_code& err) const;
+  /**
+   * @brief take the ring buffers and the single block buffers out of the
+   * arena
+   */
+  void InitBuffers(std::shared_ptr<Arena> arena);
+  /**
+   * @return the number of frames of the output ring buffer
+   */
+  uint32_t OutputBufferSize() const;
+  /**
+   * @brief empty the ring buffers of a configuration and fill the input
+   * with the frames of zeros that start a stream
+   */
+  void ResetBuffers(MultichannelOverlapRingBuffer* input_buffer,
+                    MultichannelRingBuffer* output_buffer) const;
+  /**
+   * @brief allocate the buffers again, for the current block size and
+   * lookahead
+   */
+  void ReallocateBuffers();
+  /**
+   * @brief allocate the frame history for the current configuration
+   */
+  void InitFrameHistory();
+  /**
+   * @brief swap the stft parameters, transforms and buffers of the filter
+   * with the ones of the configuration it is switching to
+   */
+  void SwapPending();
+  /**
+   * @brief crossfade the output of the configuration the filter is switching
+   * to into a block, and end the switch after the crossfade
+   * @param buffer: the block read from the current configuration
+   */
+  void Crossfade(AudioBuffer* buffer);
+  /**
+   * @brief process and synthesize the oldest analyzed frame once its
+   * lookahead frames are analyzed, output a hop of zeros otherwise
+   * @param keep_history: false to leave the frame history untouched
+   * @param skip_silent: true to skip the silent channels of the frame
+   * @param time: the start time of the process stage, set to the end time of
+   * the output copy stage
+   */
+  void ProcessFrame(bool keep_history, bool skip_silent, uint64_t* time);
+  /**
+   * @brief process every frame available in the input buffer and push the
+   * result into the output buffer
+   * @param time: the start time of the input copy stage, set to the end time
+   * of the last recorded stage
+   * @param keep_history: false to leave the frame history untouched
+   * @return the number of processed frames
+   */
+  uint32_t ProcessAvailableFrames(uint64_t* time, bool keep_history = true);
+  /**
+   * @return the current time if the counters or the tracer are enabled, 0
+   * otherwise
+   */
+  uint64_t InstrumentationTime() const;
+  /**
+   * @brief record a stage in the counters and the tracer
+   * @param stage: the stage
+   * @param time: the start time of the stage, set to its end time
+   */
+  void EndStage(StageCounters::Stage stage, uint64_t* time);
+  /**
+   * @brief record the output copy stage and the end of a block
+   * @param block_start: the start time of the block
+   * @param time: the start time of the output copy stage
+   * @param frame_count: the number of frames of the block
+   * @param hop_count: the number of frames processed during the block
+   */
+  void RecordBlock(uint64_t block_start, uint64_t time, uint32_t frame_count,
+                   uint32_t hop_count);
+  template <typename T>
+  void ProcessInterleaved(const T* input, T* output);
+  template <typename T>
+  void ProcessPlanar(const T* const* input, T* const* output);
 
   uint32_t fft_size_;
   uint32_t overlap_;
   fft_window::Type window_type_;
+  fft_window::Type synthesis_window_type_;
+  bool overlap_save_;
   uint32_t block_size_;
-  uint8_t channel_count_;
+  uint32_t channel_count_;
+  // 0 when the filter isn't prepared for Reconfigure
+  uint32_t max_fft_size_;
+  bool huge_pages_;
+  bool dither_enabled_;
+  pcm::Dither dither_;
+  bool pair_transforms_;
+  bool denormal_flush_;
+  float tail_flush_threshold_;
+  uint32_t frame_history_size_;
+  FrameHistory::Storage frame_history_storage_;
+  FrameHistory frame_history_;
+  uint32_t lookahead_;
+  // the filter whose lookahead frames are read, when it runs in a FilterChain
+  const AbstractFilter* lookahead_source_;
+  // negative when silence detection is disabled
+  float silence_threshold_;
+  StageCounters counters_;
+  DeadlineMonitor deadline_monitor_;
+  std::shared_ptr<Tracer> tracer_;
   std::shared_ptr<MultichannelOverlapRingBuffer> input_buffer_;
   std::shared_ptr<MultichannelRingBuffer> output_buffer_;
 
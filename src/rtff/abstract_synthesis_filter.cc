@@ -0,0 +1,107 @@
+#include "rtff/abstract_synthesis_filter.h"
+
+#include "rtff/buffer/buffer.h"
+#include "rtff/buffer/ring_buffer.h"
+#include "rtff/denormal.h"
+#include "rtff/filter_impl.h"
+
+namespace rtff {
+
+class AbstractSynthesisFilter::Impl {
+ public:
+  TimeAmplitudeBuffer output_amplitude_block;
+  TimeFrequencyBuffer frequential_block;
+  std::vector<std::complex<float>*> frequential_data;
+};
+
+AbstractSynthesisFilter::AbstractSynthesisFilter()
+    : fft_size_(2048),
+      overlap_(2048 * 0.5),
+      window_type_(fft_window::Type::Hamming),
+      block_size_(512),
+      channel_count_(0) {}
+
+AbstractSynthesisFilter::~AbstractSynthesisFilter() {}
+
+void AbstractSynthesisFilter::Init(uint32_t channel_count, uint32_t fft_size,
+                                   uint32_t overlap, std::error_code& err) {
+  Init(channel_count, fft_size, overlap, fft_window::Type::Hamming, err);
+}
+
+void AbstractSynthesisFilter::Init(uint32_t channel_count, uint32_t fft_size,
+                                   uint32_t overlap,
+                                   fft_window::Type windows_type,
+                                   std::error_code& err) {
+  fft_size_ = fft_size;
+  overlap_ = overlap;
+  window_type_ = windows_type;
+  Init(channel_count, err);
+}
+
+void AbstractSynthesisFilter::Init(uint32_t channel_count,
+                                   std::error_code& err) {
+  channel_count_ = channel_count;
+  InitBuffers();
+
+  // init single block buffers
+  buffers_ = std::make_shared<Impl>();
+  buffers_->output_amplitude_block.Init(hop_size(), channel_count);
+  buffers_->frequential_block.Init(fft_size() / 2 + 1, channel_count);
+  buffers_->frequential_data = buffers_->frequential_block.data_ptr();
+
+  impl_ = std::make_shared<FilterImpl>();
+  impl_->Init(fft_size(), overlap(), windows_type(), channel_count,
+              FilterImpl::Mode::Synthesis, err);
+  if (err) {
+    return;
+  }
+  PrepareToPlay();
+}
+
+void AbstractSynthesisFilter::InitBuffers() {
+  // a block is read as soon as enough frames have been synthesized, so at
+  // most one hop can remain on top of it
+  output_buffer_ = std::make_shared<MultichannelRingBuffer>(
+      block_size() + hop_size(), channel_count());
+}
+
+void AbstractSynthesisFilter::set_block_size(uint32_t value) {
+  block_size_ = value;
+  InitBuffers();
+  PrepareToPlay();
+}
+
+uint32_t AbstractSynthesisFilter::fft_size() const { return fft_size_; }
+uint32_t AbstractSynthesisFilter::overlap() const { return overlap_; }
+fft_window::Type AbstractSynthesisFilter::windows_type() const {
+  return window_type_;
+}
+uint32_t AbstractSynthesisFilter::hop_size() const {
+  return fft_size_ - overlap_;
+}
+uint32_t AbstractSynthesisFilter::block_size() const { return block_size_; }
+uint32_t AbstractSynthesisFilter::channel_count() const {
+  return channel_count_;
+}
+
+void AbstractSynthesisFilter::ProcessBlock(AudioBuffer* buffer) {
+  ScopedDenormalFlush denormal_flush;
+  auto frame_count = buffer->frame_count();
+  // synthesize frames until we have enough data
+  while (!output_buffer_->Read(buffer, frame_count)) {
+    auto& frequential_block = buffers_->frequential_block;
+    for (uint32_t channel_idx = 0; channel_idx < channel_count();
+         channel_idx++) {
+      frequential_block.channel(channel_idx).setZero();
+    }
+    GenerateTransformedBlock(buffers_->frequential_data,
+                             frequential_block.size());
+    impl_->Synthesize(frequential_block, &(buffers_->output_amplitude_block));
+    output_buffer_->Write(buffers_->output_amplitude_block,
+                          buffers_->output_amplitude_block.size());
+  }
+}
+
+void AbstractSynthesisFilter::PrepareToPlay() {}
+
+}  // namespace rtff
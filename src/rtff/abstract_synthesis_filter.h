@@ -0,0 +1,134 @@
+#ifndef RTFF_ABSTRACT_SYNTHESIS_FILTER_H_
+#define RTFF_ABSTRACT_SYNTHESIS_FILTER_H_
+
+#include <complex>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+#include "rtff/buffer/audio_buffer.h"
+
+#include "rtff/fft/window_type.h"
+
+namespace rtff {
+
+class MultichannelRingBuffer;
+class FilterImpl;
+
+/**
+ * @brief Base class of synthesis only frequential filters.
+ * Time frequency frames are produced by the filter itself, one per hop, and
+ * converted to raw audio data through overlap-add. No input buffer, analysis
+ * window nor forward transform is allocated.
+ */
+class AbstractSynthesisFilter {
+ public:
+  AbstractSynthesisFilter();
+  virtual ~AbstractSynthesisFilter();
+  /**
+   * @brief Initialize the filter with the default Hamming window
+   * @param channel_count: the number of channel of the output signal
+   * @param fft_size: the length in samples of the fourier transform window.
+   * @param overlap: the number of samples that will be kept between each
+   * window.
+   * @param err: an error code that gets set if something goes wrong
+   */
+  void Init(uint32_t channel_count, uint32_t fft_size, uint32_t overlap,
+            std::error_code& err);
+
+  /**
+   * @brief Initialize the filter
+   * @param channel_count: the number of channel of the output signal
+   * @param fft_size: the length in samples of the fourier transform window.
+   * @param overlap: the number of samples that will be kept between each
+   * window.
+   * @param windows_type: type of analysis and synthesis window the frames are
+   * expected to be produced with
+   * @param err: an error code that gets set if something goes wrong
+   */
+  void Init(uint32_t channel_count, uint32_t fft_size, uint32_t overlap,
+            fft_window::Type windows_type, std::error_code& err);
+
+  /**
+   * @brief Initialize the filter with default stft parameters
+   * @param channel_count: the number of channel of the output signal
+   * @param err: an error code that gets set if something goes wrong
+   */
+  void Init(uint32_t channel_count, std::error_code& err);
+
+  /**
+   * @brief define the maximum block size
+   * @param value: the block size
+   */
+  void set_block_size(uint32_t value);
+
+  /**
+   * @brief Fill a buffer with synthesized data
+   * @note GenerateTransformedBlock is called once per hop, as many times as
+   * needed to fill the buffer. The buffer frame count must not be greater
+   * than the block size
+   * @param buffer: the buffer to fill
+   */
+  virtual void ProcessBlock(AudioBuffer* buffer);
+
+  /**
+   * @return the fft size in samples
+   */
+  uint32_t fft_size() const;
+  /**
+   * @return the overlap in samples
+   */
+  uint32_t overlap() const;
+  /**
+   * @return the windows type
+   */
+  fft_window::Type windows_type() const;
+  /**
+   * @return the hop size in sample
+   */
+  uint32_t hop_size() const;
+  /**
+   * @return the block size
+   * @see set_block_size
+   */
+  uint32_t block_size() const;
+  /**
+   * @return the number of channel of the output signal
+   */
+  uint32_t channel_count() const;
+
+ protected:
+  /**
+   * @brief function called at the end of the initialization process.
+   * @note Override this to initialize custom member in child classes
+   */
+  virtual void PrepareToPlay();
+
+  /**
+   * @brief Produce the next frequential frame.
+   * @note that function is called by the ProcessBlock function. It shouldn't be
+   * called on its own. The data is zeroed before each call
+   * Override this function to design your generator
+   */
+  virtual void GenerateTransformedBlock(std::vector<std::complex<float>*> data,
+                                        uint32_t size) = 0;
+
+ private:
+  void InitBuffers();
+
+  uint32_t fft_size_;
+  uint32_t overlap_;
+  fft_window::Type window_type_;
+  uint32_t block_size_;
+  uint32_t channel_count_;
+  std::shared_ptr<MultichannelRingBuffer> output_buffer_;
+
+  std::shared_ptr<FilterImpl> impl_;
+
+  class Impl;
+  std::shared_ptr<Impl> buffers_;
+};
+
+}  // namespace rtff
+
+#endif  // RTFF_ABSTRACT_SYNTHESIS_FILTER_H_
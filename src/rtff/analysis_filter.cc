@@ -0,0 +1,16 @@
+#include "rtff/analysis_filter.h"
+
+namespace rtff {
+
+AnalysisFilter::AnalysisFilter()
+    : rtff::AbstractAnalysisFilter(),
+      execute([](std::vector<const std::complex<float>*>, uint32_t) {}) {}
+
+AnalysisFilter::~AnalysisFilter() {}
+
+void AnalysisFilter::ProcessAnalyzedBlock(
+    std::vector<const std::complex<float>*> data, uint32_t size) {
+  execute(data, size);
+}
+
+}  // namespace rtff
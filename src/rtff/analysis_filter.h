@@ -0,0 +1,33 @@
+#ifndef RTFF_ANALYSIS_FILTER_H_
+#define RTFF_ANALYSIS_FILTER_H_
+
+#include <functional>
+
+#include "rtff/abstract_analysis_filter.h"
+
+namespace rtff {
+
+/**
+ * @brief Simple analysis filter that applies the execute function on each
+ * frame
+ */
+class AnalysisFilter : public AbstractAnalysisFilter {
+ public:
+  AnalysisFilter();
+  virtual ~AnalysisFilter();
+
+  /**
+   * @brief the function to be executed on each time frequency block
+   * @see rtff::AbstractAnalysisFilter::ProcessAnalyzedBlock for more.
+   */
+  std::function<void(std::vector<const std::complex<float>*>, uint32_t)>
+      execute;
+
+ protected:
+  void ProcessAnalyzedBlock(std::vector<const std::complex<float>*> data,
+                            uint32_t size) override;
+};
+
+}  // namespace rtff
+
+#endif  // RTFF_ANALYSIS_FILTER_H_
@@ -0,0 +1,422 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "rtff/filter.h"
+#include "rtff/filter_batch.h"
+#include "rtff/filterbank.h"
+#include "rtff/partitioned_convolver.h"
+#include "rtff/stream_processor.h"
+
+namespace {
+
+const auto kBlockSize = 512;
+const auto kBlockCount = 2000;
+// the number of turns of the channel count measures
+const uint32_t kRoundCount = 10;
+
+/**
+ * @brief process blocks of noise through a pass-through filter
+ * @return the mean processing time of a block in microseconds
+ */
+double MeasureFilter(uint32_t channel_count, uint32_t fft_size,
+                     bool pair_transforms, uint32_t block_count = kBlockCount) {
+  std::error_code err;
+  rtff::Filter filter;
+  filter.set_pair_transforms(pair_transforms, err);
+  filter.Init(channel_count, fft_size, fft_size / 2, err);
+  if (err) {
+    std::cerr << "Error when initializing the filter: " << err.message()
+              << std::endl;
+    return 0;
+  }
+  filter.set_block_size(kBlockSize);
+
+  rtff::AudioBuffer buffer(kBlockSize, channel_count);
+  for (auto channel_idx = 0; channel_idx < channel_count; channel_idx++) {
+    Eigen::Map<Eigen::VectorXf>(buffer.data(channel_idx), kBlockSize)
+        .setRandom();
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t block_idx = 0; block_idx < block_count; block_idx++) {
+    filter.ProcessBlock(&buffer);
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() /
+         block_count;
+}
+
+/**
+ * @brief process blocks of noise, then blocks of noise decayed to denormals
+ * @param denormal_flush: true to flush denormals while processing
+ * @param quiet_duration: set to the mean processing time of a decayed block
+ * @return the mean processing time of a loud block in microseconds
+ */
+double MeasureDenormals(bool denormal_flush, double* quiet_duration) {
+  const uint32_t channel_count = 2;
+  const uint32_t block_count = 500;
+  std::error_code err;
+  rtff::Filter filter;
+  filter.Init(channel_count, 2048, 1536, rtff::fft_window::Type::Hann, err);
+  if (err) {
+    std::cerr << "Error when initializing the filter: " << err.message()
+              << std::endl;
+    return 0;
+  }
+  filter.set_block_size(kBlockSize);
+  filter.set_denormal_flush(denormal_flush);
+
+  rtff::AudioBuffer loud(kBlockSize, channel_count);
+  rtff::AudioBuffer quiet(kBlockSize, channel_count);
+  for (uint32_t channel_idx = 0; channel_idx < channel_count; channel_idx++) {
+    Eigen::Map<Eigen::VectorXf>(loud.data(channel_idx), kBlockSize)
+        .setRandom();
+    // what remains of a long decay, below the smallest normal float
+    Eigen::Map<Eigen::VectorXf>(quiet.data(channel_idx), kBlockSize) =
+        Eigen::VectorXf::Random(kBlockSize) * 1e-39f;
+  }
+
+  double durations[2] = {0, 0};
+  rtff::AudioBuffer buffer(kBlockSize, channel_count);
+  for (uint32_t block_idx = 0; block_idx < block_count; block_idx++) {
+    auto& input = block_idx < block_count / 2 ? loud : quiet;
+    for (uint32_t channel_idx = 0; channel_idx < channel_count;
+         channel_idx++) {
+      std::copy(input.data(channel_idx), input.data(channel_idx) + kBlockSize,
+                buffer.data(channel_idx));
+    }
+    auto start = std::chrono::steady_clock::now();
+    filter.ProcessBlock(&buffer);
+    auto end = std::chrono::steady_clock::now();
+    durations[block_idx >= block_count / 2] +=
+        std::chrono::duration<double, std::micro>(end - start).count();
+  }
+  *quiet_duration = durations[1] / (block_count / 2);
+  return durations[0] / (block_count / 2);
+}
+
+/**
+ * @brief process blocks of many stereo streams on a stream processor
+ * @return the number of processed blocks per second
+ */
+double MeasureStreams(uint32_t stream_count, uint32_t thread_count,
+                      uint32_t block_count) {
+  const uint32_t channel_count = 2;
+  const uint32_t fft_size = 1024;
+  std::error_code err;
+  rtff::StreamProcessor processor(thread_count, true);
+  std::vector<rtff::AudioBuffer> buffers;
+  for (uint32_t stream_idx = 0; stream_idx < stream_count; stream_idx++) {
+    auto filter = std::make_shared<rtff::Filter>();
+    filter->Init(channel_count, fft_size, fft_size / 2, err);
+    if (err) {
+      std::cerr << "Error when initializing the filter: " << err.message()
+                << std::endl;
+      return 0;
+    }
+    filter->set_block_size(kBlockSize);
+    processor.AddStream(filter);
+    buffers.emplace_back(kBlockSize, channel_count);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t block_idx = 0; block_idx < block_count; block_idx++) {
+    for (uint32_t stream_idx = 0; stream_idx < stream_count; stream_idx++) {
+      processor.Submit(stream_idx, &buffers[stream_idx], nullptr);
+    }
+    // a stream buffer can't be reused before its block is processed
+    processor.Wait();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return block_count * stream_count /
+         std::chrono::duration<double>(end - start).count();
+}
+
+/**
+ * @brief process blocks of many mono streams, separately or in a batch
+ * @return the mean processing time of a block of a stream in microseconds
+ */
+double MeasureBatch(uint32_t stream_count, uint32_t fft_size, bool batched) {
+  const uint32_t block_count = 200;
+  std::error_code err;
+  rtff::FilterBatch batch;
+  std::vector<std::shared_ptr<rtff::Filter>> filters;
+  std::vector<rtff::AudioBuffer> buffers;
+  for (uint32_t stream_idx = 0; stream_idx < stream_count; stream_idx++) {
+    auto filter = std::make_shared<rtff::Filter>();
+    filter->Init(1, fft_size, fft_size / 2, err);
+    if (!err) {
+      filter->set_block_size(fft_size / 2);
+      batch.AddFilter(filter, err);
+    }
+    if (err) {
+      std::cerr << "Error when initializing the filter: " << err.message()
+                << std::endl;
+      return 0;
+    }
+    filters.push_back(filter);
+    buffers.emplace_back(fft_size / 2, 1);
+    Eigen::Map<Eigen::VectorXf>(buffers.back().data(0), fft_size / 2)
+        .setRandom();
+  }
+  std::vector<rtff::AudioBuffer*> buffer_ptrs;
+  for (auto& buffer : buffers) {
+    buffer_ptrs.push_back(&buffer);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t block_idx = 0; block_idx < block_count; block_idx++) {
+    if (batched) {
+      batch.ProcessBlocks(buffer_ptrs);
+      continue;
+    }
+    for (uint32_t stream_idx = 0; stream_idx < stream_count; stream_idx++) {
+      filters[stream_idx]->ProcessBlock(buffer_ptrs[stream_idx]);
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() /
+         (block_count * stream_count);
+}
+
+/**
+ * @brief convolve a stereo signal with a stereo impulse response
+ * @param ir_seconds: the impulse response duration at 48kHz
+ * @param max_duration: set to the longest block processing time
+ * @return the mean processing time of a block in microseconds
+ */
+double MeasureConvolver(float ir_seconds, double* max_duration) {
+  const uint32_t channel_count = 2;
+  const uint32_t ir_size = ir_seconds * 48000;
+  const uint32_t block_count = 500;
+  std::error_code err;
+  rtff::PartitionedConvolver convolver;
+  auto partition_count = (ir_size + kBlockSize - 1) / kBlockSize;
+  convolver.Init(channel_count, channel_count, kBlockSize, partition_count,
+                 err);
+  Eigen::VectorXf ir = Eigen::VectorXf::Random(ir_size);
+  // one impulse response per channel, no cross feed
+  std::vector<const float*> data = {ir.data(), nullptr, nullptr, ir.data()};
+  std::shared_ptr<const rtff::PartitionedConvolver::ImpulseResponse> prepared;
+  if (!err) {
+    convolver.set_block_size(kBlockSize);
+    prepared = convolver.Prepare(data, ir_size, err);
+  }
+  if (!err) {
+    convolver.set_impulse_response(prepared, err);
+  }
+  if (err) {
+    std::cerr << "Error when initializing the convolver: " << err.message()
+              << std::endl;
+    return 0;
+  }
+
+  rtff::AudioBuffer input(kBlockSize, channel_count);
+  rtff::AudioBuffer output(kBlockSize, channel_count);
+  for (uint32_t channel_idx = 0; channel_idx < channel_count; channel_idx++) {
+    Eigen::Map<Eigen::VectorXf>(input.data(channel_idx), kBlockSize)
+        .setRandom();
+  }
+  double total = 0;
+  *max_duration = 0;
+  for (uint32_t block_idx = 0; block_idx < block_count; block_idx++) {
+    auto start = std::chrono::steady_clock::now();
+    convolver.ProcessBlock(input, &output);
+    auto end = std::chrono::steady_clock::now();
+    auto duration =
+        std::chrono::duration<double, std::micro>(end - start).count();
+    total += duration;
+    *max_duration = std::max(*max_duration, duration);
+  }
+  return total / block_count;
+}
+
+/**
+ * @brief project the magnitudes of stereo frames onto 128 mel bands
+ * @param fft_size: the fft size of the frames
+ * @param dense_duration: set to the mean time of a dense matrix product of
+ * the magnitudes
+ * @return the mean time of a sparse projection in microseconds
+ */
+double MeasureFilterbank(uint32_t fft_size, double* dense_duration) {
+  const uint32_t channel_count = 2;
+  const uint32_t band_count = 128;
+  const uint32_t frame_count = 5000;
+  const auto bin_count = fft_size / 2 + 1;
+  std::error_code err;
+  rtff::Filterbank filterbank;
+  filterbank.InitMel(fft_size, 48000, band_count, 0, 24000, err);
+  if (err) {
+    std::cerr << "Error when initializing the filterbank: " << err.message()
+              << std::endl;
+    return 0;
+  }
+  Eigen::MatrixXf dense = Eigen::MatrixXf::Zero(band_count, bin_count);
+  for (uint32_t band_idx = 0; band_idx < band_count; band_idx++) {
+    dense.row(band_idx).segment(filterbank.band_start(band_idx),
+                                filterbank.band_size(band_idx)) =
+        Eigen::Map<const Eigen::RowVectorXf>(filterbank.band_weights(band_idx),
+                                             filterbank.band_size(band_idx));
+  }
+
+  Eigen::MatrixXcf frames = Eigen::MatrixXcf::Random(bin_count, channel_count);
+  Eigen::MatrixXf magnitudes(bin_count, channel_count);
+  Eigen::MatrixXf bands(band_count, channel_count);
+  std::vector<const std::complex<float>*> data = {frames.col(0).data(),
+                                                  frames.col(1).data()};
+  std::vector<float*> band_data = {bands.col(0).data(), bands.col(1).data()};
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t frame_idx = 0; frame_idx < frame_count; frame_idx++) {
+    magnitudes = frames.cwiseAbs();
+    bands.noalias() = dense * magnitudes;
+  }
+  auto end = std::chrono::steady_clock::now();
+  *dense_duration =
+      std::chrono::duration<double, std::micro>(end - start).count() /
+      frame_count;
+
+  start = std::chrono::steady_clock::now();
+  for (uint32_t frame_idx = 0; frame_idx < frame_count; frame_idx++) {
+    filterbank.ProjectMagnitudes(data.data(), channel_count, band_data.data());
+  }
+  end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() /
+         frame_count;
+}
+
+#if defined(RTFF_USE_FFTW)
+const std::string kBackend("fftw");
+#elif defined(RTFF_USE_MKL)
+const std::string kBackend("mkl");
+#else
+const std::string kBackend("eigen");
+#endif
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::cout << "backend: " << kBackend << ", block size: " << kBlockSize
+            << std::endl;
+  std::cout << std::setw(9) << "channels" << std::setw(10) << "fft size"
+            << std::setw(16) << "per channel us" << std::setw(10) << "pair us"
+            << std::setw(10) << "speedup" << std::endl;
+  for (uint32_t channel_count : {2, 4}) {
+    for (uint32_t fft_size : {512, 1024, 2048, 4096}) {
+      auto per_channel = MeasureFilter(channel_count, fft_size, false);
+      auto pair = MeasureFilter(channel_count, fft_size, true);
+      std::cout << std::setw(9) << static_cast<int>(channel_count)
+                << std::setw(10) << fft_size << std::setw(16) << std::fixed
+                << std::setprecision(2) << per_channel << std::setw(10) << pair
+                << std::setw(10) << per_channel / pair << std::endl;
+    }
+  }
+
+  // the cost of a channel should not depend on the channel count
+  std::cout << std::endl
+            << std::setw(9) << "channels" << std::setw(10) << "fft size"
+            << std::setw(16) << "per channel us" << std::endl;
+  const uint32_t fft_size = 1024;
+  const std::vector<uint32_t> channel_counts = {2, 8, 32, 128, 512};
+  // the channel counts are measured in turns and the fastest turn is kept, so
+  // that a slower period of the machine doesn't skew a single channel count
+  std::vector<double> per_channel(channel_counts.size(), 1e9);
+  for (uint32_t round_idx = 0; round_idx < kRoundCount; round_idx++) {
+    for (size_t count_idx = 0; count_idx < channel_counts.size();
+         count_idx++) {
+      auto channel_count = channel_counts[count_idx];
+      // keep the same amount of work for every channel count
+      auto block_count =
+          std::max<uint32_t>(kBlockCount * 2 / channel_count / kRoundCount, 4);
+      auto duration =
+          MeasureFilter(channel_count, fft_size, false, block_count);
+      per_channel[count_idx] =
+          std::min(per_channel[count_idx], duration / channel_count);
+    }
+  }
+  for (size_t count_idx = 0; count_idx < channel_counts.size(); count_idx++) {
+    std::cout << std::setw(9) << channel_counts[count_idx] << std::setw(10)
+              << fft_size << std::setw(16) << per_channel[count_idx]
+              << std::endl;
+  }
+
+  // batching the streams helps most for small fft sizes
+  std::cout << std::endl
+            << std::setw(9) << "streams" << std::setw(10) << "fft size"
+            << std::setw(16) << "per stream us" << std::setw(10) << "batch us"
+            << std::setw(10) << "speedup" << std::endl;
+  for (uint32_t fft_size : {64, 128, 256, 512}) {
+    const uint32_t stream_count = 64;
+    auto separate = MeasureBatch(stream_count, fft_size, false);
+    auto batched = MeasureBatch(stream_count, fft_size, true);
+    std::cout << std::setw(9) << stream_count << std::setw(10) << fft_size
+              << std::setw(16) << std::setprecision(2) << separate
+              << std::setw(10) << batched << std::setw(10)
+              << separate / batched << std::endl;
+  }
+
+  // the cost of a convolution block doesn't depend on its position
+  std::cout << std::endl
+            << std::setw(9) << "ir s" << std::setw(12) << "partitions"
+            << std::setw(10) << "mean us" << std::setw(10) << "max us"
+            << std::endl;
+  for (float ir_seconds : {2.f, 5.f, 10.f}) {
+    double max_duration;
+    auto mean = MeasureConvolver(ir_seconds, &max_duration);
+    std::cout << std::setw(9) << std::setprecision(0) << ir_seconds
+              << std::setw(12)
+              << static_cast<uint32_t>(ir_seconds * 48000 + kBlockSize - 1) /
+                     kBlockSize
+              << std::setw(10) << std::setprecision(1) << mean
+              << std::setw(10) << max_duration << std::endl;
+  }
+
+  // flushing denormals keeps the cost of a decayed signal flat
+  std::cout << std::endl
+            << std::setw(9) << "flush" << std::setw(10) << "loud us"
+            << std::setw(10) << "quiet us" << std::setw(10) << "ratio"
+            << std::endl;
+  for (bool denormal_flush : {false, true}) {
+    double quiet;
+    auto loud = MeasureDenormals(denormal_flush, &quiet);
+    std::cout << std::setw(9) << (denormal_flush ? "on" : "off")
+              << std::setw(10) << std::setprecision(1) << loud
+              << std::setw(10) << quiet << std::setw(10)
+              << std::setprecision(2) << quiet / loud << std::endl;
+  }
+
+  // the sparse filterbank skips the zero weights of the dense matrix
+  std::cout << std::endl
+            << std::setw(9) << "fft size" << std::setw(10) << "dense us"
+            << std::setw(10) << "sparse us" << std::setw(10) << "speedup"
+            << std::endl;
+  for (uint32_t fft_size : {1024, 2048, 4096}) {
+    double dense;
+    auto sparse = MeasureFilterbank(fft_size, &dense);
+    std::cout << std::setw(9) << fft_size << std::setw(10)
+              << std::setprecision(2) << dense << std::setw(10) << sparse
+              << std::setw(10) << dense / sparse << std::endl;
+  }
+
+  // the throughput should scale with the thread count, up to the core count
+  std::cout << std::endl
+            << std::setw(9) << "streams" << std::setw(10) << "threads"
+            << std::setw(16) << "blocks per s" << std::endl;
+  const uint32_t stream_count = 256;
+  auto core_count = std::max(std::thread::hardware_concurrency(), 1u);
+  for (uint32_t thread_count = 1; thread_count <= core_count;
+       thread_count *= 2) {
+    auto throughput = MeasureStreams(stream_count, thread_count, 50);
+    std::cout << std::setw(9) << stream_count << std::setw(10) << thread_count
+              << std::setw(16) << std::setprecision(0) << throughput
+              << std::endl;
+  }
+  return 0;
+}
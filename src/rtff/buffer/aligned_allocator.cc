@@ -0,0 +1,34 @@
+#include "rtff/buffer/aligned_allocator.h"
+
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif  // _WIN32
+
+namespace rtff {
+
+void* AlignedAlloc(std::size_t size) {
+  if (size == 0) {
+    return nullptr;
+  }
+#ifdef _WIN32
+  return _aligned_malloc(size, kBufferAlignment);
+#else
+  void* data = nullptr;
+  if (posix_memalign(&data, kBufferAlignment, size) != 0) {
+    return nullptr;
+  }
+  return data;
+#endif  // _WIN32
+}
+
+void AlignedFree(void* data) {
+#ifdef _WIN32
+  _aligned_free(data);
+#else
+  free(data);
+#endif  // _WIN32
+}
+
+}  // namespace rtff
@@ -0,0 +1,61 @@
+#ifndef RTFF_BUFFER_ALIGNED_ALLOCATOR_H_
+#define RTFF_BUFFER_ALIGNED_ALLOCATOR_H_
+
+#include <cstddef>
+#include <new>
+
+namespace rtff {
+
+/**
+ * @brief the alignment of the audio buffers in bytes: a cache line, and the
+ * width of the largest simd registers
+ */
+const std::size_t kBufferAlignment = 64;
+
+/**
+ * @brief allocate memory aligned on kBufferAlignment bytes
+ * @param size: the number of bytes
+ * @return the memory, nullptr on failure
+ */
+void* AlignedAlloc(std::size_t size);
+/**
+ * @brief release memory allocated with AlignedAlloc
+ * @param data: the memory, can be nullptr
+ */
+void AlignedFree(void* data);
+
+/**
+ * @brief a standard allocator aligning its allocations on kBufferAlignment
+ * bytes
+ */
+template <typename T>
+class AlignedAllocator {
+ public:
+  using value_type = T;
+
+  AlignedAllocator() = default;
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U>&) {}
+
+  T* allocate(std::size_t count) {
+    auto data = AlignedAlloc(count * sizeof(T));
+    if (!data && count) {
+      throw std::bad_alloc();
+    }
+    return static_cast<T*>(data);
+  }
+  void deallocate(T* data, std::size_t) { AlignedFree(data); }
+};
+
+template <typename T, typename U>
+bool operator==(const AlignedAllocator<T>&, const AlignedAllocator<U>&) {
+  return true;
+}
+template <typename T, typename U>
+bool operator!=(const AlignedAllocator<T>&, const AlignedAllocator<U>&) {
+  return false;
+}
+
+}  // namespace rtff
+
+#endif  // RTFF_BUFFER_ALIGNED_ALLOCATOR_H_
@@ -0,0 +1,76 @@
+#include "rtff/buffer/arena.h"
+
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif  // __linux__
+
+namespace rtff {
+
+namespace {
+
+#ifdef __linux__
+// the size of a transparent huge page on x86_64 and arm64
+const std::size_t kHugePageSize = 2 * 1024 * 1024;
+#endif  // __linux__
+
+}  // namespace
+
+Arena::Arena() : data_(nullptr), size_(0), used_(0), mapped_size_(0) {}
+
+Arena::~Arena() { Release(); }
+
+void Arena::Allocate(bool huge_pages, std::error_code& err) {
+  Release();
+  used_ = 0;
+  if (size_ == 0) {
+    return;
+  }
+#ifdef __linux__
+  // below a huge page, the mapping would only waste memory
+  if (huge_pages && size_ >= kHugePageSize) {
+    auto mapped_size =
+        (size_ + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+    auto data = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data != MAP_FAILED) {
+      // a hint only: the kernel falls back to regular pages. Anonymous
+      // mappings are already set to zero
+      madvise(data, mapped_size, MADV_HUGEPAGE);
+      data_ = static_cast<uint8_t*>(data);
+      mapped_size_ = mapped_size;
+      return;
+    }
+  }
+#endif  // __linux__
+  data_ = static_cast<uint8_t*>(AlignedAlloc(size_));
+  if (!data_) {
+    err = std::make_error_code(std::errc::not_enough_memory);
+    return;
+  }
+  std::memset(data_, 0, size_);
+}
+
+void Arena::Release() {
+#ifdef __linux__
+  if (mapped_size_) {
+    munmap(data_, mapped_size_);
+    data_ = nullptr;
+    mapped_size_ = 0;
+    return;
+  }
+#endif  // __linux__
+  AlignedFree(data_);
+  data_ = nullptr;
+}
+
+std::size_t Arena::size() const { return size_; }
+std::size_t Arena::used() const { return used_; }
+bool Arena::huge_pages() const { return mapped_size_ != 0; }
+
+std::size_t Arena::Align(std::size_t size) {
+  return (size + kBufferAlignment - 1) / kBufferAlignment * kBufferAlignment;
+}
+
+}  // namespace rtff
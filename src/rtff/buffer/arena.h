@@ -0,0 +1,89 @@
+#ifndef RTFF_BUFFER_ARENA_H_
+#define RTFF_BUFFER_ARENA_H_
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <system_error>
+
+#include "rtff/buffer/aligned_allocator.h"
+
+namespace rtff {
+
+/**
+ * @brief a single allocation every buffer of an instance is carved out of.
+ * The buffers are first reserved to compute the exact size of the arena, then
+ * the arena is allocated and the buffers are taken in any order. Every buffer
+ * starts on a kBufferAlignment boundary, and is released with the arena
+ */
+class Arena {
+ public:
+  Arena();
+  ~Arena();
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  /**
+   * @brief reserve room for a buffer. It must be called before Allocate
+   * @param count: the number of elements of the buffer
+   */
+  template <typename T>
+  void Reserve(std::size_t count) {
+    assert(!data_);
+    size_ += Align(count * sizeof(T));
+  }
+
+  /**
+   * @brief allocate the reserved memory, set to zero
+   * @param huge_pages: back the arena with huge pages when the system
+   * supports it. Only used on linux, through transparent huge pages
+   * @param err: an error code that gets set if the allocation fails
+   */
+  void Allocate(bool huge_pages, std::error_code& err);
+
+  /**
+   * @brief take a buffer out of the allocated arena. It doesn't allocate
+   * @param count: the number of elements of the buffer
+   * @return the buffer, aligned on kBufferAlignment bytes
+   */
+  template <typename T>
+  T* Take(std::size_t count) {
+    auto size = Align(count * sizeof(T));
+    assert(used_ + size <= size_);
+    auto result = reinterpret_cast<T*>(data_ + used_);
+    used_ += size;
+    return result;
+  }
+
+  /**
+   * @return the size of the arena in bytes
+   */
+  std::size_t size() const;
+  /**
+   * @return the number of bytes already taken
+   */
+  std::size_t used() const;
+  /**
+   * @return true if the arena is mapped with the huge pages hint
+   */
+  bool huge_pages() const;
+
+  /**
+   * @return the size rounded up to the next multiple of kBufferAlignment
+   */
+  static std::size_t Align(std::size_t size);
+
+ private:
+  void Release();
+
+  uint8_t* data_;
+  std::size_t size_;
+  std::size_t used_;
+  // the size of the memory mapping, 0 when the arena isn't mapped
+  std::size_t mapped_size_;
+};
+
+}  // namespace rtff
+
+#endif  // RTFF_BUFFER_ARENA_H_
@@ -2,44 +2,48 @@
 
 namespace rtff {
 
-AudioBuffer::AudioBuffer(uint32_t frame_count, uint8_t channel_count) {
-  for (auto channel_idx = 0; channel_idx < channel_count; channel_idx++) {
-    data_.push_back(std::vector<float>(frame_count));
-  }
-}
+namespace {
+
+// the number of samples of an aligned block
+const uint32_t kAlignmentSize = kBufferAlignment / sizeof(float);
+
+}  // namespace
+
+AudioBuffer::AudioBuffer(uint32_t frame_count, uint32_t channel_count)
+    : frame_count_(frame_count),
+      channel_count_(channel_count),
+      channel_stride_((frame_count + kAlignmentSize - 1) / kAlignmentSize *
+                      kAlignmentSize),
+      data_(static_cast<std::size_t>(channel_stride_) * channel_count) {}
 
 void AudioBuffer::fromInterleaved(const float* data) {
-  for (auto channel_idx = 0; channel_idx < channel_count(); channel_idx++) {
-    auto& channel = data_[channel_idx];
-    for (auto frame_idx = 0; frame_idx < frame_count(); frame_idx++) {
+  for (uint32_t channel_idx = 0; channel_idx < channel_count(); channel_idx++) {
+    auto channel = this->data(channel_idx);
+    for (uint32_t frame_idx = 0; frame_idx < frame_count(); frame_idx++) {
       channel[frame_idx] = data[(frame_idx * channel_count()) + channel_idx];
     }
   }
 }
 void AudioBuffer::toInterleaved(float* data) const {
-  for (auto channel_idx = 0; channel_idx < channel_count(); channel_idx++) {
-    auto& channel = data_[channel_idx];
-    for (auto frame_idx = 0; frame_idx < frame_count(); frame_idx++) {
+  for (uint32_t channel_idx = 0; channel_idx < channel_count(); channel_idx++) {
+    auto channel = this->data(channel_idx);
+    for (uint32_t frame_idx = 0; frame_idx < frame_count(); frame_idx++) {
       data[(frame_idx * channel_count()) + channel_idx] = channel[frame_idx];
     }
   }
 }
 
-float* AudioBuffer::data(uint8_t channel_idx) {
-  return data_[channel_idx].data();
+float* AudioBuffer::data(uint32_t channel_idx) {
+  return data_.data() + static_cast<std::size_t>(channel_idx) * channel_stride_;
 }
 
-const float* AudioBuffer::data(uint8_t channel_idx) const {
-  return data_[channel_idx].data();
+const float* AudioBuffer::data(uint32_t channel_idx) const {
+  return data_.data() + static_cast<std::size_t>(channel_idx) * channel_stride_;
 }
 
-uint32_t AudioBuffer::frame_count() const {
-  if (data_.size() == 0) {
-    return 0;
-  }
-  return data_[0].size();
-}
+uint32_t AudioBuffer::frame_count() const { return frame_count_; }
 
-uint8_t AudioBuffer::channel_count() const { return data_.size(); }
+uint32_t AudioBuffer::channel_count() const { return channel_count_; }
+uint32_t AudioBuffer::channel_stride() const { return channel_stride_; }
 
 }  // namespace rtff
@@ -1,13 +1,19 @@
 #ifndef RTFF_BUFFER_AUDIO_BUFFER_H_
 #define RTFF_BUFFER_AUDIO_BUFFER_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
+#include "rtff/buffer/aligned_allocator.h"
+
 namespace rtff {
 
 /**
  * @brief a fixed size buffer of raw audio signal data
+ * @note channels are stored one after the other in a single allocation. Each
+ * channel starts on a kBufferAlignment bytes boundary, so channels are
+ * channel_stride samples apart
  */
 class AudioBuffer {
  public:
@@ -16,7 +22,7 @@ class AudioBuffer {
    * @param frame_count: the number of samples of each channel
    * @param channel_count: the number of channels
    */
-  AudioBuffer(uint32_t frame_count, uint8_t channel_count);
+  AudioBuffer(uint32_t frame_count, uint32_t channel_count);
 
   /**
    * @brief fill the buffer with interleaved data
@@ -34,12 +40,12 @@ class AudioBuffer {
    * @param channel_idx: the channel index
    * @return the pointer to deinterleaved audio data
    */
-  float* data(uint8_t channel_idx);
+  float* data(uint32_t channel_idx);
   /**
    * @param channel_idx: the channel index
    * @return the pointer to deinterleaved audio data
    */
-  const float* data(uint8_t channel_idx) const;
+  const float* data(uint32_t channel_idx) const;
 
   /**
    * @return the number of samples contained in each channel
@@ -48,10 +54,18 @@ class AudioBuffer {
   /**
    * @return the number of channels
    */
-  uint8_t channel_count() const;
+  uint32_t channel_count() const;
+  /**
+   * @return the distance in samples between the start of two consecutive
+   * channels. It is the frame count rounded up to the alignment
+   */
+  uint32_t channel_stride() const;
 
  private:
-  std::vector<std::vector<float>> data_;
+  uint32_t frame_count_;
+  uint32_t channel_count_;
+  uint32_t channel_stride_;
+  std::vector<float, AlignedAllocator<float>> data_;
 };
 
 }  // namespace rtff
@@ -1,50 +1,125 @@
 #ifndef RTFF_BUFFER_BUFFER_H_
 #define RTFF_BUFFER_BUFFER_H_
 
+#include <complex>
+#include <memory>
+#include <new>
+#include <vector>
+
 #include <Eigen/Core>
 
+#include "rtff/buffer/arena.h"
+
 namespace rtff {
 
 /**
- * @brief A multichannel data storage class
+ * @brief A multichannel data storage class.
+ * Channels are stored contiguously, one after the other, in a single
+ * allocation so that operations on every channel can run as one matrix
+ * operation. The channels are not padded: batched transforms expect a channel
+ * to start right after the previous one.
+ * The data is aligned on kBufferAlignment bytes and is either owned by the
+ * buffer or taken out of an arena shared with other buffers
  */
 template <typename T>
 class Buffer {
  public:
   using Vector = Eigen::Matrix<T, Eigen::Dynamic, 1>;
+  using Matrix = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>;
+  /** a view on every channel, one per column */
+  using MatrixMap = Eigen::Map<Matrix, Eigen::Aligned64>;
+  using ConstMatrixMap = Eigen::Map<const Matrix, Eigen::Aligned64>;
+
+  /**
+   * @brief reserve the room of a buffer in an arena
+   * @param frame_count: the number of samples of each channel
+   * @param channel_count: the number of channels
+   * @param arena: the arena, not allocated yet
+   */
+  static void Reserve(uint32_t frame_count, uint32_t channel_count,
+                      Arena* arena) {
+    arena->Reserve<T>(static_cast<std::size_t>(frame_count) * channel_count);
+  }
+
   /**
    * @brief Initialize and allocate memory
    * @param frame_count: the number of samples of each channel
    * @param channel_count: the number of channels
+   * @param arena: an allocated arena the buffer was reserved in. If nullptr,
+   * the buffer allocates its own memory
    */
-  void Init(uint32_t frame_count, uint8_t channel_count) {
-    data_.clear();
-    for (uint8_t channel_idx = 0; channel_idx < channel_count; channel_idx++) {
-      data_.push_back(Vector::Zero(frame_count));
+  void Init(uint32_t frame_count, uint32_t channel_count,
+            std::shared_ptr<Arena> arena = nullptr) {
+    if (!arena) {
+      arena = std::make_shared<Arena>();
+      Reserve(frame_count, channel_count, arena.get());
+      std::error_code err;
+      arena->Allocate(false, err);
+      if (err) {
+        throw std::bad_alloc();
+      }
+    }
+    arena_ = arena;
+    data_ = arena->Take<T>(static_cast<std::size_t>(frame_count) *
+                           channel_count);
+    frame_count_ = frame_count;
+    channel_count_ = channel_count;
+  }
+
+  Buffer() : data_(nullptr), frame_count_(0), channel_count_(0) {}
+  Buffer(const Buffer& other) : Buffer() { *this = other; }
+  Buffer(Buffer&& other) noexcept : Buffer() { *this = std::move(other); }
+  Buffer& operator=(const Buffer& other) {
+    // a copy owns its data
+    if (this != &other) {
+      Init(other.frame_count_, other.channel_count_);
+      matrix() = other.matrix();
     }
+    return *this;
+  }
+  Buffer& operator=(Buffer&& other) noexcept {
+    arena_ = std::move(other.arena_);
+    data_ = other.data_;
+    frame_count_ = other.frame_count_;
+    channel_count_ = other.channel_count_;
+    other.data_ = nullptr;
+    other.frame_count_ = 0;
+    other.channel_count_ = 0;
+    return *this;
   }
 
   /**
    * @param channel_idx: the channel index
-   * @return a reference to the raw data stored in a vector
+   * @return a view on the channel data
+   */
+  Eigen::Map<Vector> channel(uint32_t channel_idx) {
+    return Eigen::Map<Vector>(data(channel_idx), frame_count_);
+  }
+  Eigen::Map<const Vector> channel(uint32_t channel_idx) const {
+    return Eigen::Map<const Vector>(data(channel_idx), frame_count_);
+  }
+
+  /**
+   * @return every channel, one per column
    */
-  Vector& channel(uint8_t channel_idx) { return data_[channel_idx]; }
-  const Vector& channel(uint8_t channel_idx) const {
-    return data_[channel_idx];
+  MatrixMap matrix() { return MatrixMap(data_, frame_count_, channel_count_); }
+  ConstMatrixMap matrix() const {
+    return ConstMatrixMap(data_, frame_count_, channel_count_);
   }
 
   /**
    * @return the number of channels
    */
-  uint8_t channel_count() const { return data_.size(); }
+  uint32_t channel_count() const { return channel_count_; }
 
   /**
    * @return a vector of pointers giving access to raw data
    */
   std::vector<T*> data_ptr() {
-    std::vector<T*> result;
-    for (auto& vector : data_) {
-      result.push_back(vector.data());
+    std::vector<T*> result(channel_count_);
+    for (uint32_t channel_idx = 0; channel_idx < channel_count_;
+         channel_idx++) {
+      result[channel_idx] = data(channel_idx);
     }
     return result;
   }
@@ -52,10 +127,17 @@ class Buffer {
   /**
    * @return the number of samples contained in each channel
    */
-  uint32_t size() const { return data_[0].size(); }
+  uint32_t size() const { return frame_count_; }
 
  private:
-  std::vector<Vector> data_;
+  T* data(uint32_t channel_idx) const {
+    return data_ + static_cast<std::size_t>(channel_idx) * frame_count_;
+  }
+
+  std::shared_ptr<Arena> arena_;
+  T* data_;
+  uint32_t frame_count_;
+  uint32_t channel_count_;
 };
 
 using TimeAmplitudeBuffer = Buffer<float>;
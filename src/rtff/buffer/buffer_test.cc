@@ -1,11 +1,16 @@
 #include <gtest/gtest.h>
 
+#include <complex>
+#include <cstdint>
+#include <limits>
 #include <random>
 
 #include <Eigen/Core>
 
+#include "rtff/buffer/arena.h"
 #include "rtff/buffer/audio_buffer.h"
 #include "rtff/buffer/overlap_ring_buffer.h"
+#include "rtff/buffer/pcm.h"
 #include "rtff/buffer/ring_buffer.h"
 
 TEST(Buffer, AudioBuffer) {
@@ -45,6 +50,51 @@ TEST(Buffer, AudioBuffer) {
   ASSERT_EQ(interleaved, read_interleaved);
 }
 
+TEST(Buffer, Arena) {
+  using namespace rtff;
+  auto aligned = [](const void* data) {
+    return reinterpret_cast<std::uintptr_t>(data) % kBufferAlignment == 0;
+  };
+
+  // every buffer taken out of the arena is aligned
+  Arena arena;
+  arena.Reserve<float>(3);
+  arena.Reserve<std::complex<float>>(100);
+  arena.Reserve<uint8_t>(1);
+  ASSERT_EQ(arena.size(), Arena::Align(3 * sizeof(float)) +
+                              Arena::Align(100 * sizeof(std::complex<float>)) +
+                              Arena::Align(1));
+  std::error_code err;
+  arena.Allocate(false, err);
+  ASSERT_FALSE(err);
+  auto floats = arena.Take<float>(3);
+  auto complexes = arena.Take<std::complex<float>>(100);
+  auto bytes = arena.Take<uint8_t>(1);
+  ASSERT_TRUE(aligned(floats));
+  ASSERT_TRUE(aligned(complexes));
+  ASSERT_TRUE(aligned(bytes));
+  ASSERT_EQ(arena.used(), arena.size());
+  ASSERT_EQ(floats[0], 0);
+  ASSERT_EQ(complexes[99], std::complex<float>(0));
+
+  // large arenas may be backed by huge pages
+  Arena large_arena;
+  large_arena.Reserve<float>(1 << 20);
+  large_arena.Allocate(true, err);
+  ASSERT_FALSE(err);
+  auto large = large_arena.Take<float>(1 << 20);
+  ASSERT_TRUE(aligned(large));
+  ASSERT_EQ(large[(1 << 20) - 1], 0);
+
+  // audio buffer channels are aligned too
+  AudioBuffer buffer(100, 3);
+  ASSERT_GE(buffer.channel_stride(), buffer.frame_count());
+  for (uint32_t channel_idx = 0; channel_idx < buffer.channel_count();
+       channel_idx++) {
+    ASSERT_TRUE(aligned(buffer.data(channel_idx)));
+  }
+}
+
 TEST(Buffer, OverlapRingBuffer) {
   using namespace rtff;
 
@@ -256,3 +306,50 @@ TEST(Buffer, MultichannelRingBuffer) {
   buffer.Write(input_buffer, 256);
   ASSERT_TRUE(buffer.Read(&output_buffer, 512));
 }
+
+TEST(Buffer, PcmConversion) {
+  using namespace rtff;
+
+  const auto frame_number = 1024;
+  const auto stride = 3;
+  Eigen::VectorXf data = Eigen::VectorXf::Random(frame_number) * 0.9f;
+  // out of range values must saturate
+  data[0] = 2.f;
+  data[1] = -2.f;
+  Eigen::VectorXf result(frame_number);
+
+  std::vector<int16_t> int16_data(frame_number * stride);
+  pcm::FromFloat(data.data(), frame_number, int16_data.data(), stride, nullptr);
+  ASSERT_EQ(int16_data[0], 32767);
+  ASSERT_EQ(int16_data[stride], -32768);
+  pcm::ToFloat(int16_data.data(), stride, frame_number, result.data());
+  ASSERT_LT((result - data).tail(frame_number - 2).cwiseAbs().maxCoeff(),
+            1.f / 32768);
+
+  std::vector<pcm::Int24> int24_data(frame_number);
+  pcm::FromFloat(data.data(), frame_number, int24_data.data(), 1, nullptr);
+  pcm::ToFloat(int24_data.data(), 1, frame_number, result.data());
+  ASSERT_FLOAT_EQ(result[1], -1.f);
+  ASSERT_LT((result - data).tail(frame_number - 2).cwiseAbs().maxCoeff(),
+            1.f / 8388608);
+
+  std::vector<int32_t> int32_data(frame_number);
+  pcm::Dither dither;
+  pcm::FromFloat(data.data(), frame_number, int32_data.data(), 1, &dither);
+  ASSERT_EQ(int32_data[1], std::numeric_limits<int32_t>::min());
+  pcm::ToFloat(int32_data.data(), 1, frame_number, result.data());
+  ASSERT_LT((result - data).tail(frame_number - 2).cwiseAbs().maxCoeff(),
+            1e-6);
+
+  // NaN is converted as silence, with or without dither
+  data[2] = std::numeric_limits<float>::quiet_NaN();
+  pcm::FromFloat(data.data(), frame_number, int16_data.data(), stride, nullptr);
+  ASSERT_EQ(int16_data[2 * stride], 0);
+  pcm::FromFloat(data.data(), frame_number, int24_data.data(), 1, nullptr);
+  pcm::ToFloat(int24_data.data(), 1, frame_number, result.data());
+  ASSERT_EQ(result[2], 0);
+  pcm::FromFloat(data.data(), frame_number, int32_data.data(), 1, nullptr);
+  ASSERT_EQ(int32_data[2], 0);
+  pcm::FromFloat(data.data(), frame_number, int32_data.data(), 1, &dither);
+  ASSERT_LE(std::abs(int32_data[2]), 1);
+}
@@ -1,7 +1,13 @@
 #include "rtff/buffer/overlap_ring_buffer.h"
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "rtff/buffer/arena.h"
 #include "rtff/buffer/audio_buffer.h"
 #include "rtff/buffer/buffer.h"
+#include "rtff/buffer/pcm.h"
 
 namespace rtff {
 
@@ -10,69 +16,126 @@ namespace rtff {
 // Overlap Ring Buffer
 //-----------------------------------
 //-----------------------------------
-OverlapRingBuffer::OverlapRingBuffer(uint32_t read_size, uint32_t step_size) {
+OverlapRingBuffer::OverlapRingBuffer(uint32_t read_size, uint32_t step_size)
+    : OverlapRingBuffer(read_size, step_size, nullptr) {
+  arena_ = std::make_shared<Arena>();
+  arena_->Reserve<float>(size_);
+  std::error_code err;
+  arena_->Allocate(false, err);
+  if (err) {
+    throw std::bad_alloc();
+  }
+  buffer_ = arena_->Take<float>(size_);
+}
+
+OverlapRingBuffer::OverlapRingBuffer(uint32_t read_size, uint32_t step_size,
+                                     float* data)
+    : read_size_(read_size),
+      step_size_(step_size),
+      silence_threshold_(-1),
+      silent_count_(0),
+      write_index_(0),
+      read_index_(0),
+      available_data_size_(0),
+      buffer_(data),
+      size_(ContainerSize(read_size)) {}
+
+uint32_t OverlapRingBuffer::ContainerSize(uint32_t read_size) {
+  // the buffer size is arbitrary.
+  // We should give a way to initialize it to a given value to
+  // avoid allocating uncessary memory
+  return read_size * 8;
+}
+
+void OverlapRingBuffer::Reset(uint32_t read_size, uint32_t step_size) {
+  assert(ContainerSize(read_size) <= size_);
   read_size_ = read_size;
   step_size_ = step_size;
+  silent_count_ = 0;
   write_index_ = 0;
   read_index_ = 0;
   available_data_size_ = 0;
-
-  // the buffer size is arbitrary.
-  // We should give a way to initialize it to a given value to
-  // avoid allocating uncessary memory
-  buffer_.resize(read_size_ * 8);
 }
 
 void OverlapRingBuffer::InitWithZeros(uint32_t count) {
-  if (write_index_ + count > buffer_.size()) {
-    auto remaining_size = buffer_.size() - write_index_;
-    std::fill(buffer_.data() + write_index_,
-              buffer_.data() + write_index_ + remaining_size, 0);
-    std::fill(buffer_.data(), buffer_.data() + (count - remaining_size), 0);
+  if (write_index_ + count > size_) {
+    auto remaining_size = size_ - write_index_;
+    std::fill(buffer_ + write_index_,
+              buffer_ + write_index_ + remaining_size, 0);
+    std::fill(buffer_, buffer_ + (count - remaining_size), 0);
     write_index_ = (count - remaining_size);
   } else {
-    std::fill(buffer_.data() + write_index_,
-              buffer_.data() + write_index_ + count, 0);
+    std::fill(buffer_ + write_index_,
+              buffer_ + write_index_ + count, 0);
     write_index_ += count;
   }
   available_data_size_ += count;
+  silent_count_ = std::min<uint32_t>(silent_count_ + count, size_);
 }
 
 void OverlapRingBuffer::Write(const float* data, uint32_t frame_count) {
+  UpdateSilence(data, frame_count);
+  auto write_size = frame_count;
+  if (write_index_ + write_size > size_) {
+    // When we reach the end of the buffer
+    auto remaining_size = size_ - write_index_;
+    std::copy(data, data + remaining_size, buffer_ + write_index_);
+    std::copy(data + remaining_size, data + write_size, buffer_);
+    write_index_ = (write_size - remaining_size);
+  } else {
+    // we have enough size remaining
+    std::copy(data, data + write_size, buffer_ + write_index_);
+    write_index_ += write_size;
+  }
+  available_data_size_ += write_size;
+}
+
+template <typename T>
+void OverlapRingBuffer::Write(const T* data, uint32_t stride,
+                              uint32_t frame_count) {
+  // convert straight into the ring to avoid a float staging buffer
   auto write_size = frame_count;
-  if (write_index_ + write_size > buffer_.size()) {
+  if (write_index_ + write_size > size_) {
     // When we reach the end of the buffer
-    auto remaining_size = buffer_.size() - write_index_;
-    std::copy(data, data + remaining_size, buffer_.data() + write_index_);
-    std::copy(data + remaining_size, data + write_size, buffer_.data());
+    auto remaining_size = size_ - write_index_;
+    pcm::ToFloat(data, stride, remaining_size, buffer_ + write_index_);
+    UpdateSilence(buffer_ + write_index_, remaining_size);
+    pcm::ToFloat(data + remaining_size * stride, stride,
+                 write_size - remaining_size, buffer_);
+    UpdateSilence(buffer_, write_size - remaining_size);
     write_index_ = (write_size - remaining_size);
   } else {
     // we have enough size remaining
-    std::copy(data, data + write_size, buffer_.data() + write_index_);
+    pcm::ToFloat(data, stride, write_size, buffer_ + write_index_);
+    UpdateSilence(buffer_ + write_index_, write_size);
     write_index_ += write_size;
   }
   available_data_size_ += write_size;
 }
 
+template void OverlapRingBuffer::Write(const int16_t*, uint32_t, uint32_t);
+template void OverlapRingBuffer::Write(const pcm::Int24*, uint32_t, uint32_t);
+template void OverlapRingBuffer::Write(const int32_t*, uint32_t, uint32_t);
+
 bool OverlapRingBuffer::Read(float* data) {
   if (available_data_size_ < read_size_) {
     return false;
   }
 
-  if (read_index_ + read_size_ > buffer_.size()) {
-    auto remaining_size = buffer_.size() - read_index_;
-    std::copy(buffer_.data() + read_index_,
-              buffer_.data() + read_index_ + remaining_size, data);
-    std::copy(buffer_.data(), buffer_.data() + (read_size_ - remaining_size),
+  if (read_index_ + read_size_ > size_) {
+    auto remaining_size = size_ - read_index_;
+    std::copy(buffer_ + read_index_,
+              buffer_ + read_index_ + remaining_size, data);
+    std::copy(buffer_, buffer_ + (read_size_ - remaining_size),
               data + remaining_size);
     read_index_ += step_size_;
-    if (read_index_ > buffer_.size()) {
-      read_index_ -= buffer_.size();
+    if (read_index_ > size_) {
+      read_index_ -= size_;
     }
   } else {
     // default read
-    std::copy(buffer_.data() + read_index_,
-              buffer_.data() + read_index_ + read_size_, data);
+    std::copy(buffer_ + read_index_,
+              buffer_ + read_index_ + read_size_, data);
     read_index_ += step_size_;
   }
   available_data_size_ -= step_size_;
@@ -80,15 +143,86 @@ bool OverlapRingBuffer::Read(float* data) {
   return true;
 }
 
+bool OverlapRingBuffer::Skip() {
+  if (available_data_size_ < read_size_) {
+    return false;
+  }
+  read_index_ += step_size_;
+  if (read_index_ > size_) {
+    read_index_ -= size_;
+  }
+  available_data_size_ -= step_size_;
+  return true;
+}
+
+void OverlapRingBuffer::set_silence_threshold(float threshold) {
+  silence_threshold_ = threshold;
+  // we don't know anything about the data already written
+  silent_count_ = 0;
+}
+
+bool OverlapRingBuffer::NextFrameSilent() const {
+  return silence_threshold_ >= 0 && available_data_size_ >= read_size_ &&
+         silent_count_ >= available_data_size_;
+}
+
+void OverlapRingBuffer::UpdateSilence(const float* data,
+                                      uint32_t frame_count) {
+  if (silence_threshold_ < 0) {
+    return;
+  }
+  // look for the last non silent sample
+  auto frame_idx = static_cast<int64_t>(frame_count) - 1;
+  while (frame_idx >= 0 && std::abs(data[frame_idx]) <= silence_threshold_) {
+    frame_idx--;
+  }
+  if (frame_idx < 0) {
+    silent_count_ =
+        std::min<uint32_t>(silent_count_ + frame_count, size_);
+  } else {
+    silent_count_ = frame_count - 1 - frame_idx;
+  }
+}
+
 //-----------------------------------
 //-----------------------------------
 // Multichannel Overlap Ring Buffer
 //-----------------------------------
 //-----------------------------------
 MultichannelOverlapRingBuffer::MultichannelOverlapRingBuffer(
-    uint32_t read_size, uint32_t step_size, uint8_t channel_count) {
+    uint32_t read_size, uint32_t step_size, uint32_t channel_count,
+    std::shared_ptr<Arena> arena)
+    : arena_(arena) {
+  if (!arena_) {
+    arena_ = std::make_shared<Arena>();
+    Reserve(read_size, channel_count, arena_.get());
+    std::error_code err;
+    arena_->Allocate(false, err);
+    if (err) {
+      throw std::bad_alloc();
+    }
+  }
+  auto container_size = OverlapRingBuffer::ContainerSize(read_size);
+  buffers_.reserve(channel_count);
   for (auto channel_idx = 0; channel_idx < channel_count; channel_idx++) {
-    buffers_.push_back(OverlapRingBuffer(read_size, step_size));
+    buffers_.emplace_back(read_size, step_size,
+                          arena_->Take<float>(container_size));
+  }
+}
+
+void MultichannelOverlapRingBuffer::Reserve(uint32_t read_size,
+                                            uint32_t channel_count,
+                                            Arena* arena) {
+  auto container_size = OverlapRingBuffer::ContainerSize(read_size);
+  for (auto channel_idx = 0; channel_idx < channel_count; channel_idx++) {
+    arena->Reserve<float>(container_size);
+  }
+}
+
+void MultichannelOverlapRingBuffer::Reset(uint32_t read_size,
+                                          uint32_t step_size) {
+  for (auto& buffer : buffers_) {
+    buffer.Reset(read_size, step_size);
   }
 }
 
@@ -99,11 +233,11 @@ void MultichannelOverlapRingBuffer::InitWithZeros(uint32_t frame_number) {
 }
 
 OverlapRingBuffer& MultichannelOverlapRingBuffer::operator[](
-    uint8_t channel_idx) {
+    uint32_t channel_idx) {
   return buffers_[channel_idx];
 }
 const OverlapRingBuffer& MultichannelOverlapRingBuffer::operator[](
-    uint8_t channel_idx) const {
+    uint32_t channel_idx) const {
   return buffers_[channel_idx];
 }
 
@@ -114,6 +248,38 @@ void MultichannelOverlapRingBuffer::Write(const AudioBuffer& buffer,
     buffers_[channel_idx].Write(buffer.data(channel_idx), frame_count);
   }
 }
+
+template <typename T>
+void MultichannelOverlapRingBuffer::WriteInterleaved(const T* data,
+                                                     uint32_t frame_count) {
+  auto channel_count = static_cast<uint32_t>(buffers_.size());
+  for (auto channel_idx = 0; channel_idx < buffers_.size(); channel_idx++) {
+    buffers_[channel_idx].Write(data + channel_idx, channel_count,
+                                frame_count);
+  }
+}
+
+template <typename T>
+void MultichannelOverlapRingBuffer::WritePlanar(const T* const* data,
+                                                uint32_t frame_count) {
+  for (auto channel_idx = 0; channel_idx < buffers_.size(); channel_idx++) {
+    buffers_[channel_idx].Write(data[channel_idx], 1, frame_count);
+  }
+}
+
+template void MultichannelOverlapRingBuffer::WriteInterleaved(const int16_t*,
+                                                              uint32_t);
+template void MultichannelOverlapRingBuffer::WriteInterleaved(
+    const pcm::Int24*, uint32_t);
+template void MultichannelOverlapRingBuffer::WriteInterleaved(const int32_t*,
+                                                              uint32_t);
+template void MultichannelOverlapRingBuffer::WritePlanar(const int16_t* const*,
+                                                         uint32_t);
+template void MultichannelOverlapRingBuffer::WritePlanar(
+    const pcm::Int24* const*, uint32_t);
+template void MultichannelOverlapRingBuffer::WritePlanar(const int32_t* const*,
+                                                         uint32_t);
+
 bool MultichannelOverlapRingBuffer::Read(AudioBuffer* buffer) {
   assert(buffer->channel_count() == buffers_.size());
   for (auto channel_idx = 0; channel_idx < buffers_.size(); channel_idx++) {
@@ -141,4 +307,26 @@ bool MultichannelOverlapRingBuffer::Read(Buffer<float>* buffer) {
   }
   return true;
 }
+
+bool MultichannelOverlapRingBuffer::Read(
+    Buffer<float>* buffer, std::vector<uint8_t>* silent_channels) {
+  assert(buffer->channel_count() == buffers_.size());
+  for (auto channel_idx = 0; channel_idx < buffers_.size(); channel_idx++) {
+    auto& ring = buffers_[channel_idx];
+    auto silent = ring.NextFrameSilent();
+    (*silent_channels)[channel_idx] = silent;
+    auto success = silent ? ring.Skip()
+                          : ring.Read(buffer->channel(channel_idx).data());
+    if (!success) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void MultichannelOverlapRingBuffer::set_silence_threshold(float threshold) {
+  for (auto& buffer : buffers_) {
+    buffer.set_silence_threshold(threshold);
+  }
+}
 }  // namespace rtff
@@ -2,12 +2,14 @@
 #define RTFF_BUFFER_OVERLAP_RING_BUFER_H_
 
 #include <cstdint>
+#include <memory>
 #include <vector>
 
 namespace rtff {
 
 template <typename T>
 class Buffer;
+class Arena;
 class AudioBuffer;
 
 /**
@@ -26,6 +28,36 @@ class OverlapRingBuffer {
    * call to the Read function
    */
   OverlapRingBuffer(uint32_t read_size, uint32_t step_size);
+  /**
+   * @brief Constructor using memory owned by the caller
+   * @param read_size: the number of frames read when calling the Read function
+   * @param step_size: the number of frames to remove from the buffer after a
+   * call to the Read function
+   * @param data: ContainerSize(read_size) samples, that must outlive the
+   * buffer
+   */
+  OverlapRingBuffer(uint32_t read_size, uint32_t step_size, float* data);
+
+  OverlapRingBuffer(const OverlapRingBuffer&) = delete;
+  OverlapRingBuffer& operator=(const OverlapRingBuffer&) = delete;
+  OverlapRingBuffer(OverlapRingBuffer&&) = default;
+  OverlapRingBuffer& operator=(OverlapRingBuffer&&) = default;
+
+  /**
+   * @param read_size: the number of frames read when calling the Read function
+   * @return the number of samples the buffer stores
+   */
+  static uint32_t ContainerSize(uint32_t read_size);
+  /**
+   * @brief empty the buffer and change its read and step sizes. It doesn't
+   * allocate
+   * @param read_size: the number of frames read when calling the Read
+   * function. ContainerSize(read_size) must not exceed the size the buffer
+   * was constructed with
+   * @param step_size: the number of frames to remove from the buffer after a
+   * call to the Read function
+   */
+  void Reset(uint32_t read_size, uint32_t step_size);
   /**
    * @brief fill the buffer with count zeros
    * @param count: the number of zeros to add into the buffer
@@ -37,21 +69,56 @@ class OverlapRingBuffer {
    * @param frame_count: the number of samples available in the data array
    */
   void Write(const float* data, uint32_t frame_count);
+  /**
+   * @brief convert integer samples and write them to the buffer
+   * @param data: pointer to the integer samples (int16_t, pcm::Int24 or
+   * int32_t)
+   * @param stride: the distance, in samples, between two consecutive frames
+   * @param frame_count: the number of frames available in the data array
+   */
+  template <typename T>
+  void Write(const T* data, uint32_t stride, uint32_t frame_count);
   /**
    * @brief read data from the buffer and remove step_size data
    * @param data: a pre-allocated array of size read_size
    * @return true is read was successful
    */
   bool Read(float* data);
+  /**
+   * @brief remove step_size data without reading it
+   * @return true if enough data was available to be read
+   */
+  bool Skip();
+
+  /**
+   * @brief enable the tracking of silent samples as they are written
+   * @param threshold: samples with an absolute value lower or equal to the
+   * threshold are silent. A negative value disables the tracking
+   */
+  void set_silence_threshold(float threshold);
+  /**
+   * @return true if the next frame to be read only contains silent samples
+   * @note the tracking is conservative: a frame is only reported silent when
+   * every available sample is silent
+   */
+  bool NextFrameSilent() const;
 
  private:
+  void UpdateSilence(const float* data, uint32_t frame_count);
+
   uint32_t read_size_;
   uint32_t step_size_;
+  float silence_threshold_;
+  // number of silent samples at the end of the written data
+  uint32_t silent_count_;
 
   uint32_t write_index_;
   uint32_t read_index_;
   uint32_t available_data_size_;
-  std::vector<float> buffer_;
+  // set when the buffer owns its memory
+  std::shared_ptr<Arena> arena_;
+  float* buffer_;
+  uint32_t size_;
 };
 
 /**
@@ -66,9 +133,28 @@ class MultichannelOverlapRingBuffer {
    * @param step_size: the number of frames to remove from the buffer after a
    * call to the Read function
    * @param channel_count: the number of channels of the original signal
+   * @param arena: an allocated arena the buffer was reserved in. If nullptr,
+   * the buffer allocates its own memory
    */
   MultichannelOverlapRingBuffer(uint32_t read_size, uint32_t step_size,
-                                uint8_t channel_count);
+                                uint32_t channel_count,
+                                std::shared_ptr<Arena> arena = nullptr);
+
+  /**
+   * @brief reserve the room of a buffer in an arena. Each channel starts on
+   * an aligned boundary
+   * @param read_size: the number of frames read when calling the Read function
+   * @param channel_count: the number of channels of the original signal
+   * @param arena: the arena, not allocated yet
+   */
+  static void Reserve(uint32_t read_size, uint32_t channel_count,
+                      Arena* arena);
+
+  /**
+   * @brief empty every channel and change the read and step sizes
+   * @see OverlapRingBuffer::Reset
+   */
+  void Reset(uint32_t read_size, uint32_t step_size);
 
   /**
    * @brief fill the buffer with count zeros
@@ -80,13 +166,13 @@ class MultichannelOverlapRingBuffer {
    * @return the OverlapRingBuffer at a given channel
    * @param channel_idx: the index of the channel to access
    */
-  OverlapRingBuffer& operator[](uint8_t channel_idx);
+  OverlapRingBuffer& operator[](uint32_t channel_idx);
 
   /**
    * @return the OverlapRingBuffer at a given channel
    * @param channel_idx: the index of the channel to access
    */
-  const OverlapRingBuffer& operator[](uint8_t channel_idx) const;
+  const OverlapRingBuffer& operator[](uint32_t channel_idx) const;
 
   /**
    * @brief write data to the buffer
@@ -95,6 +181,22 @@ class MultichannelOverlapRingBuffer {
    */
   void Write(const AudioBuffer& buffer, uint32_t frame_count);
 
+  /**
+   * @brief convert interleaved integer samples and write them to the buffer
+   * @param data: the interleaved samples (int16_t, pcm::Int24 or int32_t)
+   * @param frame_count: the number of frames available in data
+   */
+  template <typename T>
+  void WriteInterleaved(const T* data, uint32_t frame_count);
+
+  /**
+   * @brief convert planar integer samples and write them to the buffer
+   * @param data: one pointer per channel (int16_t, pcm::Int24 or int32_t)
+   * @param frame_count: the number of frames available in each channel
+   */
+  template <typename T>
+  void WritePlanar(const T* const* data, uint32_t frame_count);
+
   /**
    * @brief read data from the buffer and remove step_size data
    * @param buffer: a pre-allocated AudioBuffer of size read_size
@@ -116,7 +218,27 @@ class MultichannelOverlapRingBuffer {
    */
   bool Read(Buffer<float>* buffer);
 
+  /**
+   * @brief read data from the buffer and remove step_size data, skipping the
+   * copy of silent channels
+   * @param buffer: a pre-allocated Buffer<float> of size read_size. Silent
+   * channels are left untouched
+   * @param silent_channels: a pre-allocated vector of channel_count flags, set
+   * to 1 for the channels whose frame is silent and to 0 otherwise
+   * @return true is read was successful
+   * @see OverlapRingBuffer::NextFrameSilent
+   */
+  bool Read(Buffer<float>* buffer, std::vector<uint8_t>* silent_channels);
+
+  /**
+   * @brief enable the tracking of silent samples on every channel
+   * @param threshold: samples with an absolute value lower or equal to the
+   * threshold are silent. A negative value disables the tracking
+   */
+  void set_silence_threshold(float threshold);
+
  private:
+  std::shared_ptr<Arena> arena_;
   std::vector<OverlapRingBuffer> buffers_;
 };
 
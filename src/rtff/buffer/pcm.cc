@@ -0,0 +1,147 @@
+#include "rtff/buffer/pcm.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <Eigen/Core>
+
+namespace rtff {
+namespace pcm {
+
+namespace {
+
+template <typename T>
+using Vector = Eigen::Matrix<T, Eigen::Dynamic, 1>;
+template <typename T>
+using StridedMap = Eigen::Map<Vector<T>, 0, Eigen::InnerStride<>>;
+template <typename T>
+using ConstStridedMap = Eigen::Map<const Vector<T>, 0, Eigen::InnerStride<>>;
+
+// full scale values. Upper bounds are the largest floats that can be cast back
+// to the integer type without overflowing
+const float kInt16Scale = 32768.f;
+const float kInt16Upper = 32767.f;
+const float kInt24Scale = 8388608.f;
+const float kInt24Upper = 8388607.f;
+const float kInt32Scale = 2147483648.f;
+const float kInt32Upper = 2147483520.f;
+
+template <typename T>
+void IntegerToFloat(const T* data, uint32_t stride, uint32_t frame_count,
+                    float scale, float* result) {
+  Eigen::Map<Eigen::VectorXf> output(result, frame_count);
+  // contiguous (planar) data can be vectorized
+  if (stride == 1) {
+    output = Eigen::Map<const Vector<T>>(data, frame_count)
+                 .template cast<float>() / scale;
+    return;
+  }
+  output = ConstStridedMap<T>(data, frame_count, Eigen::InnerStride<>(stride))
+               .template cast<float>() / scale;
+}
+
+template <typename T>
+void FloatToInteger(const float* data, uint32_t frame_count, float scale,
+                    float upper, T* result, uint32_t stride, Dither* dither) {
+  // NaN goes through the clamp and casting it is undefined, so it is
+  // converted as silence
+  if (dither) {
+    for (uint32_t frame_idx = 0; frame_idx < frame_count; frame_idx++) {
+      auto sample = data[frame_idx] == data[frame_idx] ? data[frame_idx] : 0.f;
+      auto value = std::round(sample * scale + dither->Next());
+      result[frame_idx * stride] =
+          static_cast<T>(std::min(std::max(value, -scale), upper));
+    }
+    return;
+  }
+
+  auto input = Eigen::Map<const Eigen::VectorXf>(data, frame_count).array();
+  auto scaled = (input.isNaN().select(0.f, input) * scale)
+                    .round()
+                    .max(-scale)
+                    .min(upper);
+  if (stride == 1) {
+    Eigen::Map<Vector<T>>(result, frame_count) =
+        scaled.template cast<T>().matrix();
+    return;
+  }
+  StridedMap<T>(result, frame_count, Eigen::InnerStride<>(stride)) =
+      scaled.template cast<T>().matrix();
+}
+
+int32_t Unpack(const Int24& sample) {
+  // place the 24 bits in the most significant bytes and shift back to get the
+  // sign extension
+  auto value = static_cast<uint32_t>(sample.bytes[0]) << 8 |
+               static_cast<uint32_t>(sample.bytes[1]) << 16 |
+               static_cast<uint32_t>(sample.bytes[2]) << 24;
+  return static_cast<int32_t>(value) >> 8;
+}
+
+Int24 Pack(int32_t value) {
+  Int24 sample;
+  sample.bytes[0] = static_cast<uint8_t>(value);
+  sample.bytes[1] = static_cast<uint8_t>(value >> 8);
+  sample.bytes[2] = static_cast<uint8_t>(value >> 16);
+  return sample;
+}
+
+}  // namespace
+
+Dither::Dither(uint32_t seed) : state_(seed) {}
+
+float Dither::Next() {
+  // sum of two uniform variables gives a triangular distribution
+  const float scale = 1.f / (1 << 24);
+  state_ = state_ * 1664525 + 1013904223;
+  auto first = (state_ >> 8) * scale;
+  state_ = state_ * 1664525 + 1013904223;
+  auto second = (state_ >> 8) * scale;
+  return first - second;
+}
+
+void ToFloat(const int16_t* data, uint32_t stride, uint32_t frame_count,
+             float* result) {
+  IntegerToFloat(data, stride, frame_count, kInt16Scale, result);
+}
+
+void ToFloat(const Int24* data, uint32_t stride, uint32_t frame_count,
+             float* result) {
+  for (uint32_t frame_idx = 0; frame_idx < frame_count; frame_idx++) {
+    result[frame_idx] = Unpack(data[frame_idx * stride]) / kInt24Scale;
+  }
+}
+
+void ToFloat(const int32_t* data, uint32_t stride, uint32_t frame_count,
+             float* result) {
+  IntegerToFloat(data, stride, frame_count, kInt32Scale, result);
+}
+
+void FromFloat(const float* data, uint32_t frame_count, int16_t* result,
+               uint32_t stride, Dither* dither) {
+  FloatToInteger(data, frame_count, kInt16Scale, kInt16Upper, result, stride,
+                 dither);
+}
+
+void FromFloat(const float* data, uint32_t frame_count, Int24* result,
+               uint32_t stride, Dither* dither) {
+  for (uint32_t frame_idx = 0; frame_idx < frame_count; frame_idx++) {
+    // NaN is converted as silence, as in FloatToInteger
+    auto sample = data[frame_idx] == data[frame_idx] ? data[frame_idx] : 0.f;
+    auto value = sample * kInt24Scale;
+    if (dither) {
+      value += dither->Next();
+    }
+    value = std::min(std::max(std::round(value), -kInt24Scale), kInt24Upper);
+    result[frame_idx * stride] = Pack(static_cast<int32_t>(value));
+  }
+}
+
+void FromFloat(const float* data, uint32_t frame_count, int32_t* result,
+               uint32_t stride, Dither* dither) {
+  FloatToInteger(data, frame_count, kInt32Scale, kInt32Upper, result, stride,
+                 dither);
+}
+
+}  // namespace pcm
+}  // namespace rtff
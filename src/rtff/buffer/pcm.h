@@ -0,0 +1,71 @@
+#ifndef RTFF_BUFFER_PCM_H_
+#define RTFF_BUFFER_PCM_H_
+
+#include <cstdint>
+
+namespace rtff {
+namespace pcm {
+
+/**
+ * @brief a packed, little endian, 24 bits signed integer sample
+ */
+struct Int24 {
+  uint8_t bytes[3];
+};
+
+/**
+ * @brief a pseudo random generator used to add triangular (TPDF) dither noise
+ * when quantizing float samples to integers
+ * @note the generator doesn't allocate and can be used in the audio thread
+ */
+class Dither {
+ public:
+  /**
+   * @brief Constructor
+   * @param seed: the initial state of the generator
+   */
+  explicit Dither(uint32_t seed = 1);
+  /**
+   * @return a triangular distributed value in ]-1, 1[ least significant bit
+   */
+  float Next();
+
+ private:
+  uint32_t state_;
+};
+
+/**
+ * @brief convert integer samples to floats in [-1, 1[
+ * @param data: the integer samples
+ * @param stride: the distance, in samples, between two consecutive frames of
+ * data. Use the channel count for interleaved data and 1 for planar data
+ * @param frame_count: the number of frames to convert
+ * @param result: a pre-allocated contiguous array of frame_count floats
+ */
+void ToFloat(const int16_t* data, uint32_t stride, uint32_t frame_count,
+             float* result);
+void ToFloat(const Int24* data, uint32_t stride, uint32_t frame_count,
+             float* result);
+void ToFloat(const int32_t* data, uint32_t stride, uint32_t frame_count,
+             float* result);
+
+/**
+ * @brief convert floats to integer samples, saturating values out of [-1, 1[
+ * @param data: a contiguous array of frame_count floats
+ * @param frame_count: the number of frames to convert
+ * @param result: the integer samples
+ * @param stride: the distance, in samples, between two consecutive frames of
+ * result. Use the channel count for interleaved data and 1 for planar data
+ * @param dither: if not null, used to add dither noise before rounding
+ */
+void FromFloat(const float* data, uint32_t frame_count, int16_t* result,
+               uint32_t stride, Dither* dither);
+void FromFloat(const float* data, uint32_t frame_count, Int24* result,
+               uint32_t stride, Dither* dither);
+void FromFloat(const float* data, uint32_t frame_count, int32_t* result,
+               uint32_t stride, Dither* dither);
+
+}  // namespace pcm
+}  // namespace rtff
+
+#endif  // RTFF_BUFFER_PCM_H_
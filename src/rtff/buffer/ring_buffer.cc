@@ -1,7 +1,11 @@
 #include "rtff/buffer/ring_buffer.h"
 
+#include <cassert>
+
+#include "rtff/buffer/arena.h"
 #include "rtff/buffer/audio_buffer.h"
 #include "rtff/buffer/buffer.h"
+#include "rtff/buffer/pcm.h"
 
 namespace rtff {
 
@@ -10,23 +14,41 @@ namespace rtff {
 // RingBuffer
 //-----------------------------------
 //-----------------------------------
-RingBuffer::RingBuffer(uint32_t container_size) {
+RingBuffer::RingBuffer(uint32_t container_size)
+    : RingBuffer(container_size, nullptr) {
+  arena_ = std::make_shared<Arena>();
+  arena_->Reserve<float>(container_size);
+  std::error_code err;
+  arena_->Allocate(false, err);
+  if (err) {
+    throw std::bad_alloc();
+  }
+  buffer_ = arena_->Take<float>(container_size);
+}
+
+RingBuffer::RingBuffer(uint32_t container_size, float* data)
+    : write_index_(0),
+      read_index_(0),
+      available_data_size_(0),
+      buffer_(data),
+      size_(container_size) {}
+
+void RingBuffer::Reset() {
   write_index_ = 0;
   read_index_ = 0;
   available_data_size_ = 0;
-  buffer_.resize(container_size);
 }
 
 void RingBuffer::InitWithZeros(uint32_t count) {
-  if (write_index_ + count > buffer_.size()) {
-    auto remaining_size = buffer_.size() - write_index_;
-    std::fill(buffer_.data() + write_index_,
-              buffer_.data() + write_index_ + remaining_size, 0);
-    std::fill(buffer_.data(), buffer_.data() + (count - remaining_size), 0);
+  if (write_index_ + count > size_) {
+    auto remaining_size = size_ - write_index_;
+    std::fill(buffer_ + write_index_,
+              buffer_ + write_index_ + remaining_size, 0);
+    std::fill(buffer_, buffer_ + (count - remaining_size), 0);
     write_index_ = (count - remaining_size);
   } else {
-    std::fill(buffer_.data() + write_index_,
-              buffer_.data() + write_index_ + count, 0);
+    std::fill(buffer_ + write_index_,
+              buffer_ + write_index_ + count, 0);
     write_index_ += count;
   }
   available_data_size_ += count;
@@ -34,15 +56,15 @@ void RingBuffer::InitWithZeros(uint32_t count) {
 
 void RingBuffer::Write(const float* data, uint32_t frame_count) {
   auto write_size = frame_count;
-  if (write_index_ + write_size > buffer_.size()) {
+  if (write_index_ + write_size > size_) {
     // When we reach the end of the buffer
-    auto remaining_size = buffer_.size() - write_index_;
-    std::copy(data, data + remaining_size, buffer_.data() + write_index_);
-    std::copy(data + remaining_size, data + write_size, buffer_.data());
+    auto remaining_size = size_ - write_index_;
+    std::copy(data, data + remaining_size, buffer_ + write_index_);
+    std::copy(data + remaining_size, data + write_size, buffer_);
     write_index_ = (write_size - remaining_size);
   } else {
     // we have enough size remaining
-    std::copy(data, data + write_size, buffer_.data() + write_index_);
+    std::copy(data, data + write_size, buffer_ + write_index_);
     write_index_ += write_size;
   }
   available_data_size_ += write_size;
@@ -54,20 +76,50 @@ bool RingBuffer::Read(float* data, uint32_t frame_count) {
     return false;
   }
 
-  if (read_index_ + read_size > buffer_.size()) {
-    auto remaining_size = buffer_.size() - read_index_;
-    std::copy(buffer_.data() + read_index_,
-              buffer_.data() + read_index_ + remaining_size, data);
-    std::copy(buffer_.data(), buffer_.data() + (read_size - remaining_size),
+  if (read_index_ + read_size > size_) {
+    auto remaining_size = size_ - read_index_;
+    std::copy(buffer_ + read_index_,
+              buffer_ + read_index_ + remaining_size, data);
+    std::copy(buffer_, buffer_ + (read_size - remaining_size),
               data + remaining_size);
     read_index_ += read_size;
-    if (read_index_ > buffer_.size()) {
-      read_index_ -= buffer_.size();
+    if (read_index_ > size_) {
+      read_index_ -= size_;
+    }
+  } else {
+    // default read
+    std::copy(buffer_ + read_index_,
+              buffer_ + read_index_ + read_size, data);
+    read_index_ += read_size;
+  }
+  available_data_size_ -= read_size;
+
+  return true;
+}
+
+template <typename T>
+bool RingBuffer::Read(T* data, uint32_t stride, uint32_t frame_count,
+                      pcm::Dither* dither) {
+  // convert straight from the ring to avoid a float staging buffer
+  auto read_size = frame_count;
+  if (available_data_size_ < read_size) {
+    return false;
+  }
+
+  if (read_index_ + read_size > size_) {
+    auto remaining_size = size_ - read_index_;
+    pcm::FromFloat(buffer_ + read_index_, remaining_size, data, stride,
+                   dither);
+    pcm::FromFloat(buffer_, read_size - remaining_size,
+                   data + remaining_size * stride, stride, dither);
+    read_index_ += read_size;
+    if (read_index_ > size_) {
+      read_index_ -= size_;
     }
   } else {
     // default read
-    std::copy(buffer_.data() + read_index_,
-              buffer_.data() + read_index_ + read_size, data);
+    pcm::FromFloat(buffer_ + read_index_, read_size, data, stride,
+                   dither);
     read_index_ += read_size;
   }
   available_data_size_ -= read_size;
@@ -75,15 +127,45 @@ bool RingBuffer::Read(float* data, uint32_t frame_count) {
   return true;
 }
 
+template bool RingBuffer::Read(int16_t*, uint32_t, uint32_t, pcm::Dither*);
+template bool RingBuffer::Read(pcm::Int24*, uint32_t, uint32_t, pcm::Dither*);
+template bool RingBuffer::Read(int32_t*, uint32_t, uint32_t, pcm::Dither*);
+
 //-----------------------------------
 //-----------------------------------
 // Multichannel Ring Buffer
 //-----------------------------------
 //-----------------------------------
 MultichannelRingBuffer::MultichannelRingBuffer(uint32_t container_size,
-                                               uint8_t channel_count) {
+                                               uint32_t channel_count,
+                                               std::shared_ptr<Arena> arena)
+    : arena_(arena) {
+  if (!arena_) {
+    arena_ = std::make_shared<Arena>();
+    Reserve(container_size, channel_count, arena_.get());
+    std::error_code err;
+    arena_->Allocate(false, err);
+    if (err) {
+      throw std::bad_alloc();
+    }
+  }
+  buffers_.reserve(channel_count);
   for (auto channel_idx = 0; channel_idx < channel_count; channel_idx++) {
-    buffers_.push_back(RingBuffer(container_size));
+    buffers_.emplace_back(container_size,
+                          arena_->Take<float>(container_size));
+  }
+}
+
+void MultichannelRingBuffer::Reserve(uint32_t container_size,
+                                     uint32_t channel_count, Arena* arena) {
+  for (auto channel_idx = 0; channel_idx < channel_count; channel_idx++) {
+    arena->Reserve<float>(container_size);
+  }
+}
+
+void MultichannelRingBuffer::Reset() {
+  for (auto& buffer : buffers_) {
+    buffer.Reset();
   }
 }
 
@@ -93,11 +175,11 @@ void MultichannelRingBuffer::InitWithZeros(uint32_t frame_number) {
   }
 }
 
-RingBuffer& MultichannelRingBuffer::operator[](uint8_t channel_idx) {
+RingBuffer& MultichannelRingBuffer::operator[](uint32_t channel_idx) {
   return buffers_[channel_idx];
 }
 const RingBuffer& MultichannelRingBuffer::operator[](
-    uint8_t channel_idx) const {
+    uint32_t channel_idx) const {
   return buffers_[channel_idx];
 }
 
@@ -137,4 +219,42 @@ bool MultichannelRingBuffer::Read(Buffer<float>* buffer, uint32_t frame_count) {
   return true;
 }
 
+template <typename T>
+bool MultichannelRingBuffer::ReadInterleaved(T* data, uint32_t frame_count,
+                                             pcm::Dither* dither) {
+  auto channel_count = static_cast<uint32_t>(buffers_.size());
+  for (auto channel_idx = 0; channel_idx < buffers_.size(); channel_idx++) {
+    if (!buffers_[channel_idx].Read(data + channel_idx, channel_count,
+                                    frame_count, dither)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename T>
+bool MultichannelRingBuffer::ReadPlanar(T* const* data, uint32_t frame_count,
+                                        pcm::Dither* dither) {
+  for (auto channel_idx = 0; channel_idx < buffers_.size(); channel_idx++) {
+    if (!buffers_[channel_idx].Read(data[channel_idx], 1, frame_count,
+                                    dither)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template bool MultichannelRingBuffer::ReadInterleaved(int16_t*, uint32_t,
+                                                      pcm::Dither*);
+template bool MultichannelRingBuffer::ReadInterleaved(pcm::Int24*, uint32_t,
+                                                      pcm::Dither*);
+template bool MultichannelRingBuffer::ReadInterleaved(int32_t*, uint32_t,
+                                                      pcm::Dither*);
+template bool MultichannelRingBuffer::ReadPlanar(int16_t* const*, uint32_t,
+                                                 pcm::Dither*);
+template bool MultichannelRingBuffer::ReadPlanar(pcm::Int24* const*, uint32_t,
+                                                 pcm::Dither*);
+template bool MultichannelRingBuffer::ReadPlanar(int32_t* const*, uint32_t,
+                                                 pcm::Dither*);
+
 }  // namespace rtff
@@ -2,13 +2,18 @@
 #define RTFF_BUFFER_RING_BUFER_H_
 
 #include <cstdint>
+#include <memory>
 #include <vector>
 
 namespace rtff {
 
 template <typename T>
 class Buffer;
+class Arena;
 class AudioBuffer;
+namespace pcm {
+class Dither;
+}  // namespace pcm
 
 /**
  * @brief RingBuffer represent a circular buffer. It is used to store enough
@@ -22,7 +27,24 @@ class RingBuffer {
    * @param container_size: the maximum number of data a user can write without
    * reading
    */
-  RingBuffer(uint32_t container_size);
+  explicit RingBuffer(uint32_t container_size);
+  /**
+   * @brief Constructor using memory owned by the caller
+   * @param container_size: the maximum number of data a user can write without
+   * reading
+   * @param data: container_size samples, that must outlive the buffer
+   */
+  RingBuffer(uint32_t container_size, float* data);
+
+  RingBuffer(const RingBuffer&) = delete;
+  RingBuffer& operator=(const RingBuffer&) = delete;
+  RingBuffer(RingBuffer&&) = default;
+  RingBuffer& operator=(RingBuffer&&) = default;
+
+  /**
+   * @brief empty the buffer. It doesn't allocate
+   */
+  void Reset();
   /**
    * @brief fill the buffer with count zeros
    * @param count: the number of zeros to add into the buffer
@@ -41,12 +63,28 @@ class RingBuffer {
    * @return true is read was successful
    */
   bool Read(float* data, uint32_t frame_count);
+  /**
+   * @brief read data from the buffer, convert it to integer samples and remove
+   * frame_count data
+   * @param data: a pre-allocated array of integer samples (int16_t, pcm::Int24
+   * or int32_t)
+   * @param stride: the distance, in samples, between two consecutive frames
+   * @param frame_count: the number of frames to read
+   * @param dither: if not null, used to dither the samples before rounding
+   * @return true is read was successful
+   */
+  template <typename T>
+  bool Read(T* data, uint32_t stride, uint32_t frame_count,
+            pcm::Dither* dither);
 
  private:
   uint32_t write_index_;
   uint32_t read_index_;
   uint32_t available_data_size_;
-  std::vector<float> buffer_;
+  // set when the buffer owns its memory
+  std::shared_ptr<Arena> arena_;
+  float* buffer_;
+  uint32_t size_;
 };
 
 /**
@@ -59,9 +97,27 @@ class MultichannelRingBuffer {
    * @param container_size: the maximum number of data a user can write without
    * reading
    * @param channel_count: the number of channel of the original signal
+   * @param arena: an allocated arena the buffer was reserved in. If nullptr,
+   * the buffer allocates its own memory
+   */
+  MultichannelRingBuffer(uint32_t container_size, uint32_t channel_count,
+                         std::shared_ptr<Arena> arena = nullptr);
+
+  /**
+   * @brief reserve the room of a buffer in an arena. Each channel starts on
+   * an aligned boundary
+   * @param container_size: the maximum number of data a user can write without
+   * reading
+   * @param channel_count: the number of channel of the original signal
+   * @param arena: the arena, not allocated yet
    */
-  MultichannelRingBuffer(uint32_t container_size, uint8_t channel_count);
+  static void Reserve(uint32_t container_size, uint32_t channel_count,
+                      Arena* arena);
 
+  /**
+   * @brief empty every channel. It doesn't allocate
+   */
+  void Reset();
   /**
    * @brief fill the buffer with count zeros
    * @param frame_number: the number of zeros to add into the buffer
@@ -72,12 +128,12 @@ class MultichannelRingBuffer {
    * @return the RingBuffer at a given channel
    * @param channel_idx: the index of the channel to access
    */
-  RingBuffer& operator[](uint8_t channel_idx);
+  RingBuffer& operator[](uint32_t channel_idx);
   /**
    * @return the RingBuffer at a given channel
    * @param channel_idx: the index of the channel to access
    */
-  const RingBuffer& operator[](uint8_t channel_idx) const;
+  const RingBuffer& operator[](uint32_t channel_idx) const;
 
   /**
    * @brief write data to the buffer
@@ -105,8 +161,29 @@ class MultichannelRingBuffer {
    * @return true is read was successful
    */
   bool Read(Buffer<float>* buffer, uint32_t frame_count);
+  /**
+   * @brief read data from the buffer as interleaved integer samples
+   * @param data: a pre-allocated array of frame_count * channel_count samples
+   * (int16_t, pcm::Int24 or int32_t)
+   * @param frame_count: the number of frames to read
+   * @param dither: if not null, used to dither the samples before rounding
+   * @return true is read was successful
+   */
+  template <typename T>
+  bool ReadInterleaved(T* data, uint32_t frame_count, pcm::Dither* dither);
+  /**
+   * @brief read data from the buffer as planar integer samples
+   * @param data: one pre-allocated array of frame_count samples per channel
+   * (int16_t, pcm::Int24 or int32_t)
+   * @param frame_count: the number of frames to read
+   * @param dither: if not null, used to dither the samples before rounding
+   * @return true is read was successful
+   */
+  template <typename T>
+  bool ReadPlanar(T* const* data, uint32_t frame_count, pcm::Dither* dither);
 
  private:
+  std::shared_ptr<Arena> arena_;
   std::vector<RingBuffer> buffers_;
 };
 }  // namespace rtff
@@ -0,0 +1,74 @@
+#include "rtff/denormal.h"
+
+#if defined(__SSE__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define RTFF_DENORMAL_X86
+#elif defined(__aarch64__) || (defined(__arm__) && defined(__ARM_FP))
+#define RTFF_DENORMAL_ARM
+#endif
+
+namespace rtff {
+
+namespace {
+
+#if defined(RTFF_DENORMAL_X86)
+// MXCSR flush-to-zero and denormals-are-zero bits
+const uint64_t kFlushMask = 0x8040;
+
+uint64_t GetState() { return _mm_getcsr(); }
+void SetState(uint64_t state) { _mm_setcsr(static_cast<unsigned>(state)); }
+#elif defined(RTFF_DENORMAL_ARM)
+// FPCR / FPSCR flush-to-zero bit
+const uint64_t kFlushMask = 1 << 24;
+
+#if defined(__aarch64__)
+uint64_t GetState() {
+  uint64_t state;
+  asm volatile("mrs %0, fpcr" : "=r"(state));
+  return state;
+}
+void SetState(uint64_t state) { asm volatile("msr fpcr, %0" : : "r"(state)); }
+#else
+uint64_t GetState() {
+  uint32_t state;
+  asm volatile("vmrs %0, fpscr" : "=r"(state));
+  return state;
+}
+void SetState(uint64_t state) {
+  asm volatile("vmsr fpscr, %0" : : "r"(static_cast<uint32_t>(state)));
+}
+#endif
+#else
+const uint64_t kFlushMask = 0;
+
+uint64_t GetState() { return 0; }
+void SetState(uint64_t) {}
+#endif
+
+}  // namespace
+
+ScopedDenormalFlush::ScopedDenormalFlush(bool enabled)
+    : enabled_(enabled && Supported()), previous_state_(0) {
+  if (!enabled_) {
+    return;
+  }
+  previous_state_ = GetState();
+  if ((previous_state_ & kFlushMask) == kFlushMask) {
+    // already flushing, nothing to restore
+    enabled_ = false;
+    return;
+  }
+  SetState(previous_state_ | kFlushMask);
+}
+
+ScopedDenormalFlush::~ScopedDenormalFlush() {
+  if (enabled_) {
+    // only restore the flush bits, in case the scope changed other modes
+    SetState((GetState() & ~kFlushMask) | (previous_state_ & kFlushMask));
+  }
+}
+
+bool ScopedDenormalFlush::Supported() { return kFlushMask != 0; }
+
+}  // namespace rtff
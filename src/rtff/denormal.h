@@ -0,0 +1,42 @@
+#ifndef RTFF_DENORMAL_H_
+#define RTFF_DENORMAL_H_
+
+#include <cstdint>
+
+namespace rtff {
+
+/**
+ * @brief Flush denormal floats to zero on the current thread while in scope.
+ * Denormals are the tiny values a decaying signal goes through before
+ * reaching zero. Most CPUs handle them many times slower than normal values,
+ * so a quiet stream can cost more than a loud one.
+ * @note on x86 both flush-to-zero and denormals-are-zero are enabled, on ARM
+ * the flush-to-zero mode. The previous floating point state of the thread is
+ * restored when the object is destroyed, so scopes can be nested. Elsewhere
+ * it does nothing. Every processing call of the library flushes denormals
+ */
+class ScopedDenormalFlush {
+ public:
+  /**
+   * @param enabled: false to leave the floating point state unchanged
+   */
+  explicit ScopedDenormalFlush(bool enabled = true);
+  ~ScopedDenormalFlush();
+
+  ScopedDenormalFlush(const ScopedDenormalFlush&) = delete;
+  ScopedDenormalFlush& operator=(const ScopedDenormalFlush&) = delete;
+
+  /**
+   * @return true if denormals can be flushed on this platform
+   */
+  static bool Supported();
+
+ private:
+  bool enabled_;
+  // the floating point control register before the scope
+  uint64_t previous_state_;
+};
+
+}  // namespace rtff
+
+#endif  // RTFF_DENORMAL_H_
@@ -0,0 +1,43 @@
+#include "rtff/drain_thread.h"
+
+#include <chrono>
+
+namespace rtff {
+
+namespace {
+
+// the drain period
+const auto kDrainPeriod = std::chrono::milliseconds(20);
+
+}  // namespace
+
+DrainThread::DrainThread() : running_(false) {}
+
+DrainThread::~DrainThread() { Stop(); }
+
+void DrainThread::Start(std::function<void()> drain) {
+  Stop();
+  drain_ = drain;
+  running_ = true;
+  thread_ = std::thread(&DrainThread::Run, this);
+}
+
+void DrainThread::Stop() {
+  if (!running_) {
+    return;
+  }
+  running_ = false;
+  thread_.join();
+  drain_();
+}
+
+bool DrainThread::running() const { return running_; }
+
+void DrainThread::Run() {
+  while (running_) {
+    drain_();
+    std::this_thread::sleep_for(kDrainPeriod);
+  }
+}
+
+}  // namespace rtff
@@ -0,0 +1,53 @@
+#ifndef RTFF_DRAIN_THREAD_H_
+#define RTFF_DRAIN_THREAD_H_
+
+#include <atomic>
+#include <functional>
+#include <thread>
+
+namespace rtff {
+
+/**
+ * @brief A background thread periodically draining a lock free queue fed by
+ * real time threads, such as the queues of the Tracer and of the
+ * SpectrogramWriter. The real time threads never wait on it: what they queue
+ * is written out at the next period.
+ */
+class DrainThread {
+ public:
+  DrainThread();
+  /**
+   * @brief stop the thread
+   */
+  ~DrainThread();
+
+  DrainThread(const DrainThread&) = delete;
+  DrainThread& operator=(const DrainThread&) = delete;
+
+  /**
+   * @brief start calling a drain function every period, until Stop
+   * @param drain: the function, called from the background thread
+   */
+  void Start(std::function<void()> drain);
+  /**
+   * @brief stop the thread, then drain one last time from the calling thread
+   * so that nothing queued before the call is lost. It does nothing if the
+   * thread isn't running
+   */
+  void Stop();
+  /**
+   * @return true between Start and Stop
+   */
+  bool running() const;
+
+ private:
+  void Run();
+
+  std::function<void()> drain_;
+  std::atomic<bool> running_;
+  std::thread thread_;
+};
+
+}  // namespace rtff
+
+#endif  // RTFF_DRAIN_THREAD_H_
@@ -1,43 +1,98 @@
 #include "rtff/fft/eigen/eigen_fft.h"
 
+#include <vector>
+
 #include <unsupported/Eigen/FFT>
 
 namespace rtff {
 
 class EigenFft::Impl {
 public:
-  Impl() : fft() {
+  Impl() : fft(), size(0) {
     fft.SetFlag(Eigen::FFT<float>::Flag::HalfSpectrum);
   }
   Eigen::FFT<float> fft;
-  std::vector<float> timevec;
-  std::vector<std::complex<float>> freqvec;
+  uint32_t size;
+  // full complex buffers of the pair transforms. Empty until PreparePairs
+  std::vector<std::complex<float>> packed_time;
+  std::vector<std::complex<float>> packed_frequency;
 };
 
 EigenFft::EigenFft() : impl_(std::make_shared<EigenFft::Impl>()) {}
 
-void EigenFft::Init(uint32_t size, std::error_code& err) {
-  // Initialize by running the fft and ifft once
-  impl_->timevec.resize(size);
-  impl_->freqvec.resize(size / 2);
-  
-  impl_->fft.inv(impl_->timevec, impl_->freqvec);
-  impl_->fft.fwd(impl_->freqvec, impl_->timevec);
-  
+void EigenFft::Init(uint32_t size, Direction direction,
+                    std::error_code& err) {
+  impl_->size = size;
+
+  // Initialize by running the needed transforms once. Eigen caches the plans
+  // so that later calls don't allocate
+  std::vector<float> timevec(size);
+  std::vector<std::complex<float>> freqvec(size / 2 + 1);
+  if (direction != Direction::Forward) {
+    impl_->fft.inv(timevec.data(), freqvec.data(), size);
+  }
+  if (direction != Direction::Backward) {
+    impl_->fft.fwd(freqvec.data(), timevec.data(), size);
+  }
 }
 
 void EigenFft::Forward(const float* real_data,
                        std::complex<float>* complex_data) {
-  std::copy(real_data, real_data + impl_->timevec.size(), std::begin(impl_->timevec));
-  impl_->fft.fwd(impl_->freqvec, impl_->timevec);
-  std::copy(std::begin(impl_->freqvec), std::end(impl_->freqvec), complex_data);
+  impl_->fft.fwd(complex_data, real_data, impl_->size);
 }
 
 void EigenFft::Backward(const std::complex<float>* complex_data,
                         float* real_data) {
-  std::copy(complex_data, complex_data + impl_->freqvec.size(), std::begin(impl_->freqvec));
-  impl_->fft.inv(impl_->timevec, impl_->freqvec);
-  std::copy(std::begin(impl_->timevec), std::end(impl_->timevec), real_data);
+  impl_->fft.inv(real_data, complex_data, impl_->size);
+}
+
+void EigenFft::PreparePairs(std::error_code& err) {
+  impl_->packed_time.resize(impl_->size);
+  impl_->packed_frequency.resize(impl_->size);
+  // cache the complex plans
+  impl_->fft.fwd(impl_->packed_frequency.data(), impl_->packed_time.data(),
+                 impl_->size);
+  impl_->fft.inv(impl_->packed_time.data(), impl_->packed_frequency.data(),
+                 impl_->size);
+}
+
+void EigenFft::ForwardPair(const float* first_real_data,
+                           const float* second_real_data,
+                           std::complex<float>* first_complex_data,
+                           std::complex<float>* second_complex_data) {
+  if (impl_->packed_time.empty()) {
+    Fft::ForwardPair(first_real_data, second_real_data, first_complex_data,
+                     second_complex_data);
+    return;
+  }
+  auto& packed_time = impl_->packed_time;
+  for (uint32_t sample_idx = 0; sample_idx < impl_->size; sample_idx++) {
+    packed_time[sample_idx] = std::complex<float>(first_real_data[sample_idx],
+                                                  second_real_data[sample_idx]);
+  }
+  impl_->fft.fwd(impl_->packed_frequency.data(), packed_time.data(),
+                 impl_->size);
+  UnpackPair(impl_->packed_frequency.data(), impl_->size, first_complex_data,
+             second_complex_data);
+}
+
+void EigenFft::BackwardPair(const std::complex<float>* first_complex_data,
+                            const std::complex<float>* second_complex_data,
+                            float* first_real_data, float* second_real_data) {
+  if (impl_->packed_time.empty()) {
+    Fft::BackwardPair(first_complex_data, second_complex_data,
+                      first_real_data, second_real_data);
+    return;
+  }
+  PackPair(first_complex_data, second_complex_data, impl_->size,
+           impl_->packed_frequency.data());
+  impl_->fft.inv(impl_->packed_time.data(), impl_->packed_frequency.data(),
+                 impl_->size);
+  const auto& packed_time = impl_->packed_time;
+  for (uint32_t sample_idx = 0; sample_idx < impl_->size; sample_idx++) {
+    first_real_data[sample_idx] = packed_time[sample_idx].real();
+    second_real_data[sample_idx] = packed_time[sample_idx].imag();
+  }
 }
 
 }  // namespace rtff
@@ -28,9 +28,87 @@ using FFTType = rtff::EigenFft;
 namespace rtff {
 
 std::shared_ptr<Fft> Fft::Create(uint32_t size, std::error_code& err) {
+  return Create(size, Direction::Both, err);
+}
+
+std::shared_ptr<Fft> Fft::Create(uint32_t size, Direction direction,
+                                 std::error_code& err) {
   auto fft = std::make_shared<FFTType>();
-  fft->Init(size, err);
+  fft->size_ = size;
+  fft->Init(size, direction, err);
   return fft;
 }
 
+uint32_t Fft::size() const { return size_; }
+
+void Fft::PrepareBatch(uint32_t batch_size, std::error_code& err) {}
+
+void Fft::ForwardBatch(const float* real_data,
+                       std::complex<float>* complex_data, uint32_t count) {
+  for (uint32_t signal_idx = 0; signal_idx < count; signal_idx++) {
+    Forward(real_data + signal_idx * size_,
+            complex_data + signal_idx * (size_ / 2 + 1));
+  }
+}
+
+void Fft::BackwardBatch(const std::complex<float>* complex_data,
+                        float* real_data, uint32_t count) {
+  for (uint32_t signal_idx = 0; signal_idx < count; signal_idx++) {
+    Backward(complex_data + signal_idx * (size_ / 2 + 1),
+             real_data + signal_idx * size_);
+  }
+}
+
+void Fft::PreparePairs(std::error_code& err) {}
+
+void Fft::ForwardPair(const float* first_real_data,
+                      const float* second_real_data,
+                      std::complex<float>* first_complex_data,
+                      std::complex<float>* second_complex_data) {
+  Forward(first_real_data, first_complex_data);
+  Forward(second_real_data, second_complex_data);
+}
+
+void Fft::BackwardPair(const std::complex<float>* first_complex_data,
+                       const std::complex<float>* second_complex_data,
+                       float* first_real_data, float* second_real_data) {
+  Backward(first_complex_data, first_real_data);
+  Backward(second_complex_data, second_real_data);
+}
+
+void Fft::UnpackPair(const std::complex<float>* packed_data, uint32_t size,
+                     std::complex<float>* first_complex_data,
+                     std::complex<float>* second_complex_data) {
+  // X[k] = (Z[k] + conj(Z[N - k])) / 2 and Y[k] = (Z[k] - conj(Z[N - k])) / 2i
+  for (uint32_t bin_idx = 0; bin_idx <= size / 2; bin_idx++) {
+    auto value = packed_data[bin_idx];
+    auto mirror = std::conj(packed_data[(size - bin_idx) % size]);
+    auto sum = value + mirror;
+    auto difference = value - mirror;
+    first_complex_data[bin_idx] = sum * 0.5f;
+    second_complex_data[bin_idx] =
+        std::complex<float>(difference.imag(), -difference.real()) * 0.5f;
+  }
+}
+
+void Fft::PackPair(const std::complex<float>* first_complex_data,
+                   const std::complex<float>* second_complex_data,
+                   uint32_t size, std::complex<float>* packed_data) {
+  // Z[k] = X[k] + i Y[k] and Z[N - k] = conj(X[k]) + i conj(Y[k])
+  for (uint32_t bin_idx = 0; bin_idx <= size / 2; bin_idx++) {
+    auto first = first_complex_data[bin_idx];
+    auto second = second_complex_data[bin_idx];
+    if (bin_idx == 0 || 2 * bin_idx == size) {
+      first = first.real();
+      second = second.real();
+    }
+    packed_data[bin_idx] = std::complex<float>(first.real() - second.imag(),
+                                               first.imag() + second.real());
+    if (bin_idx > 0 && bin_idx < size - bin_idx) {
+      packed_data[size - bin_idx] = std::complex<float>(
+          first.real() + second.imag(), second.real() - first.imag());
+    }
+  }
+}
+
 }  // namespace rtff
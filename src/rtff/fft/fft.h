@@ -13,6 +13,11 @@ namespace rtff {
  */
 class Fft {
  public:
+  /**
+   * @brief the transforms a computer is prepared for
+   */
+  enum class Direction : uint8_t { Forward, Backward, Both };
+
   /**
    * @brief Create a default computer based on various libraries depending on
    * your system
@@ -20,6 +25,15 @@ class Fft {
    * @param err: an error code that gets set if something goes wrong
    */
   static std::shared_ptr<Fft> Create(uint32_t size, std::error_code& err);
+  /**
+   * @brief Create a default computer only prepared for the given direction
+   * @note calling a transform the computer isn't prepared for is undefined
+   * @param size: the size in samples of the fft
+   * @param direction: the transforms that will be used
+   * @param err: an error code that gets set if something goes wrong
+   */
+  static std::shared_ptr<Fft> Create(uint32_t size, Direction direction,
+                                     std::error_code& err);
 
   /**
    * @brief transform a buffer of real signal data to its time frequency
@@ -37,6 +51,98 @@ class Fft {
    */
   virtual void Backward(const std::complex<float>* complex_data,
                         float* real_data) = 0;
+
+  /**
+   * @brief prepare the computer to transform pairs of real signals with a
+   * single complex transform
+   * @note by default, and until this is called, pairs are transformed one
+   * signal after the other
+   * @param err: an error code that gets set if something goes wrong
+   */
+  virtual void PreparePairs(std::error_code& err);
+  /**
+   * @brief transform two buffers of real signal data at once
+   * @param first_real_data: the first signal data
+   * @param second_real_data: the second signal data
+   * @param first_complex_data: the fourier transform of the first signal
+   * @param second_complex_data: the fourier transform of the second signal
+   */
+  virtual void ForwardPair(const float* first_real_data,
+                           const float* second_real_data,
+                           std::complex<float>* first_complex_data,
+                           std::complex<float>* second_complex_data);
+  /**
+   * @brief transform two complex time frequency representations back to the
+   * time domain at once
+   * @param first_complex_data: the first time frequency data
+   * @param second_complex_data: the second time frequency data
+   * @param first_real_data: the inverse fourier transform of the first data
+   * @param second_real_data: the inverse fourier transform of the second data
+   */
+  virtual void BackwardPair(const std::complex<float>* first_complex_data,
+                            const std::complex<float>* second_complex_data,
+                            float* first_real_data, float* second_real_data);
+
+  /**
+   * @brief prepare the computer to transform batches of signals at once
+   * @note by default, and until this is called, batches are transformed one
+   * signal after the other
+   * @param batch_size: the number of signals transformed by one batched call
+   * @param err: an error code that gets set if something goes wrong
+   */
+  virtual void PrepareBatch(uint32_t batch_size, std::error_code& err);
+  /**
+   * @brief transform contiguous buffers of real signal data
+   * @param real_data: count signals of size samples, one after the other
+   * @param complex_data: count transforms of size / 2 + 1 values, one after
+   * the other
+   * @param count: the number of signals
+   */
+  virtual void ForwardBatch(const float* real_data,
+                            std::complex<float>* complex_data, uint32_t count);
+  /**
+   * @brief transform contiguous complex time frequency representations back
+   * to the time domain
+   * @param complex_data: count transforms of size / 2 + 1 values, one after
+   * the other
+   * @param real_data: count signals of size samples, one after the other
+   * @param count: the number of signals
+   */
+  virtual void BackwardBatch(const std::complex<float>* complex_data,
+                             float* real_data, uint32_t count);
+
+  /**
+   * @return the size in samples of the fft
+   */
+  uint32_t size() const;
+
+ protected:
+  uint32_t size_ = 0;
+
+  /**
+   * @brief separate the spectrum of x + i * y into the half spectra of the
+   * real signals x and y
+   * @param packed_data: the size complex values of the full spectrum
+   * @param size: the size in samples of the fft
+   * @param first_complex_data: size / 2 + 1 values, the spectrum of x
+   * @param second_complex_data: size / 2 + 1 values, the spectrum of y
+   */
+  static void UnpackPair(const std::complex<float>* packed_data, uint32_t size,
+                         std::complex<float>* first_complex_data,
+                         std::complex<float>* second_complex_data);
+  /**
+   * @brief combine the half spectra of two real signals x and y into the full
+   * spectrum of x + i * y
+   * @note as for a complex to real transform, the imaginary parts of the
+   * DC and Nyquist bins are ignored
+   * @param first_complex_data: size / 2 + 1 values, the spectrum of x
+   * @param second_complex_data: size / 2 + 1 values, the spectrum of y
+   * @param size: the size in samples of the fft
+   * @param packed_data: the size complex values of the full spectrum
+   */
+  static void PackPair(const std::complex<float>* first_complex_data,
+                       const std::complex<float>* second_complex_data,
+                       uint32_t size, std::complex<float>* packed_data);
 };
 
 }  // namespace rtff
@@ -10,10 +10,20 @@ namespace rtff {
 
 class FFTWFft::Impl {
  public:
-  Impl() : real_to_complex_(nullptr), complex_to_real_(nullptr) {}
+  Impl()
+      : real_to_complex_(nullptr),
+        complex_to_real_(nullptr),
+        pair_forward_(nullptr),
+        pair_backward_(nullptr),
+        batch_forward_(nullptr),
+        batch_backward_(nullptr),
+        batch_size_(0),
+        direction_(Direction::Both),
+        fftw_flags_(FFTW_ESTIMATE) {}
   ~Impl() { Cleanup(); }
 
-  void Init(uint32_t nfft) {
+  void Init(uint32_t nfft, Direction direction) {
+    direction_ = direction;
     real_data_.resize(nfft);
     complex_data_.resize(nfft / 2 + 1);
 
@@ -39,12 +49,17 @@ class FFTWFft::Impl {
       fclose(wisdom);
     }
 #endif  // RTFF_FFTW_USE_WISDOM
+    fftw_flags_ = fftw_flags;
 
-    // create the plan
-    real_to_complex_ = fftwf_plan_dft_r2c_1d(
-        nfft, real_data_ptr, fftw_complex_data_ptr, fftw_flags);
-    complex_to_real_ = fftwf_plan_dft_c2r_1d(nfft, fftw_complex_data_ptr,
-                                             real_data_ptr, fftw_flags);
+    // create the plans
+    if (direction != Direction::Backward) {
+      real_to_complex_ = fftwf_plan_dft_r2c_1d(
+          nfft, real_data_ptr, fftw_complex_data_ptr, fftw_flags);
+    }
+    if (direction != Direction::Forward) {
+      complex_to_real_ = fftwf_plan_dft_c2r_1d(nfft, fftw_complex_data_ptr,
+                                               real_data_ptr, fftw_flags);
+    }
 
 #ifdef RTFF_FFTW_USE_WISDOM
     // export the wisdom if it didn't exist
@@ -63,6 +78,114 @@ class FFTWFft::Impl {
     std::copy(complex_data_ptr, complex_data_ptr + get_nfft() / 2 + 1, out);
   }
 
+  bool PreparePairs() {
+    auto nfft = get_nfft();
+    packed_time_.resize(nfft);
+    packed_frequency_.resize(nfft);
+    auto time_ptr = reinterpret_cast<fftwf_complex*>(packed_time_.data());
+    auto frequency_ptr =
+        reinterpret_cast<fftwf_complex*>(packed_frequency_.data());
+    pair_forward_ = fftwf_plan_dft_1d(nfft, time_ptr, frequency_ptr,
+                                      FFTW_FORWARD, fftw_flags_);
+    pair_backward_ = fftwf_plan_dft_1d(nfft, frequency_ptr, time_ptr,
+                                       FFTW_BACKWARD, fftw_flags_);
+    if (!pair_forward_ || !pair_backward_) {
+      // the wisdom may not contain the complex plans
+      CleanupPairs();
+      pair_forward_ = fftwf_plan_dft_1d(nfft, time_ptr, frequency_ptr,
+                                        FFTW_FORWARD, FFTW_ESTIMATE);
+      pair_backward_ = fftwf_plan_dft_1d(nfft, frequency_ptr, time_ptr,
+                                         FFTW_BACKWARD, FFTW_ESTIMATE);
+    }
+    return pair_forward_ && pair_backward_;
+  }
+
+  bool PrepareBatch(uint32_t batch_size) {
+    CleanupBatch();
+    int nfft = get_nfft();
+    int bins = nfft / 2 + 1;
+    batch_size_ = batch_size;
+    auto forward = direction_ != Direction::Backward;
+    auto backward = direction_ != Direction::Forward;
+    // the plans are executed on the caller buffers, which may not be aligned,
+    // so these buffers are only used to plan. The complex one is kept as the
+    // scratch of the backward transforms
+    std::vector<float> real_data(nfft * batch_size);
+    batch_complex_.resize(bins * batch_size);
+    auto real_ptr = real_data.data();
+    auto complex_ptr =
+        reinterpret_cast<fftwf_complex*>(batch_complex_.data());
+    for (auto flags : {fftw_flags_, static_cast<unsigned>(FFTW_ESTIMATE)}) {
+      if (forward) {
+        batch_forward_ = fftwf_plan_many_dft_r2c(
+            1, &nfft, batch_size, real_ptr, nullptr, 1, nfft, complex_ptr,
+            nullptr, 1, bins, flags | FFTW_UNALIGNED);
+      }
+      if (backward) {
+        batch_backward_ = fftwf_plan_many_dft_c2r(
+            1, &nfft, batch_size, complex_ptr, nullptr, 1, bins, real_ptr,
+            nullptr, 1, nfft, flags | FFTW_UNALIGNED);
+      }
+      if ((!forward || batch_forward_) && (!backward || batch_backward_)) {
+        if (!backward) {
+          std::vector<std::complex<float>>().swap(batch_complex_);
+        }
+        return true;
+      }
+      // the wisdom may not contain the batched plans
+      CleanupBatch();
+    }
+    return false;
+  }
+
+  bool batch_forward_prepared() const { return batch_forward_ != nullptr; }
+  bool batch_backward_prepared() const { return batch_backward_ != nullptr; }
+  uint32_t batch_size() const { return batch_size_; }
+
+  void ForwardBatch(const float* in, std::complex<float>* out) {
+    // out of place real to complex transforms preserve their input
+    fftwf_execute_dft_r2c(batch_forward_, const_cast<float*>(in),
+                          reinterpret_cast<fftwf_complex*>(out));
+  }
+
+  void BackwardBatch(const std::complex<float>* in, float* out) {
+    // complex to real transforms destroy their input
+    auto bins = get_nfft() / 2 + 1;
+    std::copy(in, in + bins * batch_size_, batch_complex_.data());
+    fftwf_execute_dft_c2r(
+        batch_backward_,
+        reinterpret_cast<fftwf_complex*>(batch_complex_.data()), out);
+    // we need to devide the output by nfft
+    Eigen::Map<Eigen::VectorXf>(out, get_nfft() * batch_size_) /= get_nfft();
+  }
+
+  bool pairs_prepared() const { return pair_forward_ && pair_backward_; }
+
+  void ForwardPair(const float* first_in, const float* second_in,
+                   std::complex<float>* first_out,
+                   std::complex<float>* second_out) {
+    auto nfft = get_nfft();
+    for (uint32_t sample_idx = 0; sample_idx < nfft; sample_idx++) {
+      packed_time_[sample_idx] =
+          std::complex<float>(first_in[sample_idx], second_in[sample_idx]);
+    }
+    fftwf_execute(pair_forward_);
+    Fft::UnpackPair(packed_frequency_.data(), nfft, first_out, second_out);
+  }
+
+  void BackwardPair(const std::complex<float>* first_in,
+                    const std::complex<float>* second_in, float* first_out,
+                    float* second_out) {
+    auto nfft = get_nfft();
+    Fft::PackPair(first_in, second_in, nfft, packed_frequency_.data());
+    fftwf_execute(pair_backward_);
+    // we need to devide the output by nfft
+    for (uint32_t sample_idx = 0; sample_idx < nfft; sample_idx++) {
+      first_out[sample_idx] = packed_time_[sample_idx].real() / nfft;
+      second_out[sample_idx] = packed_time_[sample_idx].imag() / nfft;
+    }
+  }
+
   void Backward(const std::complex<float>* in, float* out) {
     auto complex_data_ptr = complex_data_.data();
     auto real_data_ptr = real_data_.data();
@@ -87,17 +210,56 @@ class FFTWFft::Impl {
     if (complex_to_real_) {
       fftwf_destroy_plan(complex_to_real_);
     }
+    CleanupPairs();
+    CleanupBatch();
+  }
+
+  void CleanupBatch() {
+    if (batch_forward_) {
+      fftwf_destroy_plan(batch_forward_);
+      batch_forward_ = nullptr;
+    }
+    if (batch_backward_) {
+      fftwf_destroy_plan(batch_backward_);
+      batch_backward_ = nullptr;
+    }
+  }
+
+  void CleanupPairs() {
+    if (pair_forward_) {
+      fftwf_destroy_plan(pair_forward_);
+      pair_forward_ = nullptr;
+    }
+    if (pair_backward_) {
+      fftwf_destroy_plan(pair_backward_);
+      pair_backward_ = nullptr;
+    }
   }
 
   std::vector<float> real_data_;
   std::vector<std::complex<float>> complex_data_;
   fftwf_plan real_to_complex_;
   fftwf_plan complex_to_real_;
+  // complex transforms of two real signals packed as x + i * y
+  std::vector<std::complex<float>> packed_time_;
+  std::vector<std::complex<float>> packed_frequency_;
+  fftwf_plan pair_forward_;
+  fftwf_plan pair_backward_;
+  // batches of contiguous transforms, and the scratch of the backward ones
+  std::vector<std::complex<float>> batch_complex_;
+  fftwf_plan batch_forward_;
+  fftwf_plan batch_backward_;
+  uint32_t batch_size_;
+  // the transforms the plans are created for
+  Direction direction_;
+  unsigned fftw_flags_;
 };
 
 FFTWFft::FFTWFft() : impl_(std::make_shared<FFTWFft::Impl>()) {}
 
-void FFTWFft::Init(uint32_t nfft, std::error_code& err) { impl_->Init(nfft); }
+void FFTWFft::Init(uint32_t nfft, Direction direction, std::error_code& err) {
+  impl_->Init(nfft, direction);
+}
 
 void FFTWFft::Forward(const float* in, std::complex<float>* out) {
   impl_->Forward(in, out);
@@ -107,4 +269,70 @@ void FFTWFft::Backward(const std::complex<float>* in, float* out) {
   impl_->Backward(in, out);
 }
 
+void FFTWFft::PreparePairs(std::error_code& err) {
+  if (!impl_->PreparePairs()) {
+    err = std::make_error_code(std::errc::not_enough_memory);
+  }
+}
+
+void FFTWFft::ForwardPair(const float* first_in, const float* second_in,
+                          std::complex<float>* first_out,
+                          std::complex<float>* second_out) {
+  if (!impl_->pairs_prepared()) {
+    Fft::ForwardPair(first_in, second_in, first_out, second_out);
+    return;
+  }
+  impl_->ForwardPair(first_in, second_in, first_out, second_out);
+}
+
+void FFTWFft::BackwardPair(const std::complex<float>* first_in,
+                           const std::complex<float>* second_in,
+                           float* first_out, float* second_out) {
+  if (!impl_->pairs_prepared()) {
+    Fft::BackwardPair(first_in, second_in, first_out, second_out);
+    return;
+  }
+  impl_->BackwardPair(first_in, second_in, first_out, second_out);
+}
+
+void FFTWFft::PrepareBatch(uint32_t batch_size, std::error_code& err) {
+  if (!impl_->PrepareBatch(batch_size)) {
+    err = std::make_error_code(std::errc::not_enough_memory);
+  }
+}
+
+void FFTWFft::ForwardBatch(const float* real_data,
+                           std::complex<float>* complex_data,
+                           uint32_t count) {
+  auto nfft = size();
+  auto bins = nfft / 2 + 1;
+  uint32_t signal_idx = 0;
+  if (impl_->batch_forward_prepared()) {
+    // as many full batches as possible
+    for (; signal_idx + impl_->batch_size() <= count;
+         signal_idx += impl_->batch_size()) {
+      impl_->ForwardBatch(real_data + signal_idx * nfft,
+                          complex_data + signal_idx * bins);
+    }
+  }
+  Fft::ForwardBatch(real_data + signal_idx * nfft,
+                    complex_data + signal_idx * bins, count - signal_idx);
+}
+
+void FFTWFft::BackwardBatch(const std::complex<float>* complex_data,
+                            float* real_data, uint32_t count) {
+  auto nfft = size();
+  auto bins = nfft / 2 + 1;
+  uint32_t signal_idx = 0;
+  if (impl_->batch_backward_prepared()) {
+    for (; signal_idx + impl_->batch_size() <= count;
+         signal_idx += impl_->batch_size()) {
+      impl_->BackwardBatch(complex_data + signal_idx * bins,
+                           real_data + signal_idx * nfft);
+    }
+  }
+  Fft::BackwardBatch(complex_data + signal_idx * bins,
+                     real_data + signal_idx * nfft, count - signal_idx);
+}
+
 }  // namespace rtff
@@ -16,11 +16,23 @@ namespace rtff {
 class FFTWFft : public Fft {
  public:
   FFTWFft();
-  void Init(uint32_t size, std::error_code& err);
+  void Init(uint32_t size, Direction direction, std::error_code& err);
   void Forward(const float* real_data,
                std::complex<float>* complex_data) override;
   void Backward(const std::complex<float>* complex_data,
                 float* real_data) override;
+  void PreparePairs(std::error_code& err) override;
+  void ForwardPair(const float* first_real_data, const float* second_real_data,
+                   std::complex<float>* first_complex_data,
+                   std::complex<float>* second_complex_data) override;
+  void BackwardPair(const std::complex<float>* first_complex_data,
+                    const std::complex<float>* second_complex_data,
+                    float* first_real_data, float* second_real_data) override;
+  void PrepareBatch(uint32_t batch_size, std::error_code& err) override;
+  void ForwardBatch(const float* real_data, std::complex<float>* complex_data,
+                    uint32_t count) override;
+  void BackwardBatch(const std::complex<float>* complex_data, float* real_data,
+                     uint32_t count) override;
 
  private:
    class Impl;
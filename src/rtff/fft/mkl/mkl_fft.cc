@@ -2,7 +2,8 @@
 
 namespace rtff {
 
-void MKLFft::Init(uint32_t size, std::error_code& err) {
+void MKLFft::Init(uint32_t size, Direction direction, std::error_code& err) {
+  // a single mkl descriptor handles both directions
   context_.Init(size, err);
 }
 
@@ -12,7 +12,7 @@ namespace rtff {
  */
 class MKLFft : public Fft {
  public:
-  void Init(uint32_t size, std::error_code& err);
+  void Init(uint32_t size, Direction direction, std::error_code& err);
   void Forward(const float* real_data,
                std::complex<float>* complex_data) override;
   void Backward(const std::complex<float>* complex_data,
@@ -1,5 +1,7 @@
 #include "rtff/fft/window.h"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 namespace rtff {
@@ -28,6 +30,45 @@ Eigen::VectorXf Window::Make(fft_window::Type type, uint32_t size) {
           alpha - beta * cos((2 * pi * window_idx) / (window.size() - 1))
                 + gamma * cos((4 * pi * window_idx) / (window.size() - 1));
     }
+  } else if (type == fft_window::Type::PeriodicHann ||
+             type == fft_window::Type::PeriodicHamming ||
+             type == fft_window::Type::SqrtHann) {
+    auto alpha = type == fft_window::Type::PeriodicHamming ? 0.54 : 0.5;
+    auto beta = 1 - alpha;
+    for (uint32_t window_idx = 0; window_idx < window.size(); window_idx++) {
+      window[window_idx] =
+          alpha - beta * cos((2 * pi * window_idx) / window.size());
+    }
+    if (type == fft_window::Type::SqrtHann) {
+      window = window.array().sqrt();
+    }
+  } else if (type == fft_window::Type::Kaiser) {
+    // I0(beta * sqrt(1 - x^2)) / I0(beta) with x in [-1, 1]
+    const double beta = 8;
+    auto bessel = [](double x) {
+      // power series of the zeroth order modified bessel function
+      double sum = 1, term = 1;
+      for (auto k = 1; k < 50 && term > 1e-12 * sum; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+      }
+      return sum;
+    };
+    auto denominator = bessel(beta);
+    for (uint32_t window_idx = 0; window_idx < window.size(); window_idx++) {
+      auto x = window.size() > 1
+                   ? 2.0 * window_idx / (window.size() - 1) - 1
+                   : 0.0;
+      window[window_idx] =
+          bessel(beta * std::sqrt(std::max(0.0, 1 - x * x))) / denominator;
+    }
+  } else if (type == fft_window::Type::Vorbis) {
+    for (uint32_t window_idx = 0; window_idx < window.size(); window_idx++) {
+      auto value = sin(pi * (window_idx + 0.5) / window.size());
+      window[window_idx] = sin(pi / 2 * value * value);
+    }
+  } else if (type == fft_window::Type::Rectangular) {
+    window.setOnes();
   } else {
     std::cerr << "Unkown window type" << std::endl;
     window = Eigen::VectorXf::Ones(size);
@@ -7,8 +7,23 @@ namespace rtff {
 namespace fft_window {
   /**
    * @brief enumerate representing the analysis window type.
+   * Hamming, Blackman and Hann are symmetric. The periodic windows and sqrt
+   * Hann have a period of the window size, which makes them constant
+   * overlap-add at usual hop sizes. Vorbis and sqrt Hann are power
+   * complementary at 50% overlap: used for both analysis and synthesis, they
+   * reconstruct perfectly without any normalization. Kaiser uses beta = 8.
    */
-  enum class Type : uint8_t { Hamming, Blackman, Hann };
+  enum class Type : uint8_t {
+    Hamming,
+    Blackman,
+    Hann,
+    PeriodicHann,
+    PeriodicHamming,
+    SqrtHann,
+    Kaiser,
+    Vorbis,
+    Rectangular
+  };
 } // namespace fft_window
 } // namespace rtff
 
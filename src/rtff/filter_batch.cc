@@ -0,0 +1,174 @@
+#include "rtff/filter_batch.h"
+
+#include <algorithm>
+#include <complex>
+
+#include <Eigen/Core>
+
+#include "rtff/buffer/buffer.h"
+#include "rtff/buffer/overlap_ring_buffer.h"
+#include "rtff/buffer/ring_buffer.h"
+#include "rtff/denormal.h"
+#include "rtff/fft/fft.h"
+#include "rtff/filter_impl.h"
+
+namespace rtff {
+
+namespace {
+
+// the number of signals transformed by one batched call
+const uint32_t kBatchSize = 16;
+
+}  // namespace
+
+class FilterBatch::Impl {
+ public:
+  std::shared_ptr<Fft> fft;
+  // the frame read from each filter and the hop written to it
+  std::vector<TimeAmplitudeBuffer> frames;
+  std::vector<TimeAmplitudeBuffer> hops;
+
+  // the frames of the ready filters, one column per channel
+  Eigen::MatrixXf amplitude;
+  Eigen::MatrixXcf frequential;
+  Eigen::MatrixXf post_ifft;
+  // the first column of each ready filter
+  std::vector<uint32_t> ready_offsets;
+  std::vector<uint32_t> ready_filters;
+  std::vector<std::complex<float>*> channel_data;
+};
+
+FilterBatch::FilterBatch() : impl_(std::make_shared<Impl>()) {}
+FilterBatch::~FilterBatch() {}
+
+void FilterBatch::AddFilter(std::shared_ptr<AbstractFilter> filter,
+                            std::error_code& err) {
+  auto& batch = *impl_;
+  if (!filter->impl_ || filter->lookahead() || filter->max_fft_size()) {
+    err = std::make_error_code(std::errc::invalid_argument);
+    return;
+  }
+  if (filters_.empty()) {
+    batch.fft = Fft::Create(filter->fft_size(), Fft::Direction::Both, err);
+    if (err) {
+      return;
+    }
+    batch.fft->PrepareBatch(kBatchSize, err);
+    if (err) {
+      return;
+    }
+  } else {
+    auto& first = *filters_.front();
+    if (filter->fft_size() != first.fft_size() ||
+        filter->overlap() != first.overlap() ||
+        filter->windows_type() != first.windows_type() ||
+        filter->synthesis_windows_type() != first.synthesis_windows_type() ||
+        filter->overlap_save() != first.overlap_save() ||
+        filter->block_size() != first.block_size() ||
+        filter->denormal_flush() != first.denormal_flush()) {
+      err = std::make_error_code(std::errc::invalid_argument);
+      return;
+    }
+  }
+  filters_.push_back(filter);
+  batch.frames.emplace_back();
+  batch.frames.back().Init(filter->fft_size(), filter->channel_count());
+  batch.hops.emplace_back();
+  batch.hops.back().Init(filter->hop_size(), filter->channel_count());
+
+  auto channel_count = 0;
+  for (auto& batch_filter : filters_) {
+    channel_count += batch_filter->channel_count();
+  }
+  auto fft_size = filter->fft_size();
+  batch.amplitude.resize(fft_size, channel_count);
+  batch.frequential.resize(fft_size / 2 + 1, channel_count);
+  batch.post_ifft.resize(fft_size, channel_count);
+  batch.ready_offsets.reserve(filters_.size());
+  batch.ready_filters.reserve(filters_.size());
+  batch.channel_data.reserve(channel_count);
+}
+
+void FilterBatch::ProcessBlocks(const std::vector<AudioBuffer*>& buffers) {
+  ScopedDenormalFlush denormal_flush;
+  auto& batch = *impl_;
+  for (auto filter_idx = 0; filter_idx < filters_.size(); filter_idx++) {
+    auto& buffer = *buffers[filter_idx];
+    filters_[filter_idx]->input_buffer_->Write(buffer, buffer.frame_count());
+  }
+
+  while (true) {
+    // gather the windowed frames of every ready filter
+    batch.ready_offsets.clear();
+    batch.ready_filters.clear();
+    uint32_t channel_count = 0;
+    for (auto filter_idx = 0; filter_idx < filters_.size(); filter_idx++) {
+      auto& filter = filters_[filter_idx];
+      auto& frame = batch.frames[filter_idx];
+      if (!filter->input_buffer_->Read(&frame)) {
+        continue;
+      }
+      auto& window = filter->impl_->analysis_window();
+      batch.amplitude.middleCols(channel_count, filter->channel_count()) =
+          frame.matrix().array().colwise() * window.array();
+      batch.ready_offsets.push_back(channel_count);
+      batch.ready_filters.push_back(filter_idx);
+      channel_count += filter->channel_count();
+    }
+    if (batch.ready_filters.empty()) {
+      break;
+    }
+
+    batch.fft->ForwardBatch(batch.amplitude.data(), batch.frequential.data(),
+                            channel_count);
+
+    for (auto ready_idx = 0; ready_idx < batch.ready_filters.size();
+         ready_idx++) {
+      auto& filter = filters_[batch.ready_filters[ready_idx]];
+      batch.channel_data.clear();
+      for (auto channel_idx = 0; channel_idx < filter->channel_count();
+           channel_idx++) {
+        batch.channel_data.push_back(
+            batch.frequential.col(batch.ready_offsets[ready_idx] + channel_idx)
+                .data());
+      }
+      filter->frame_history_.Push(batch.channel_data.data());
+      filter->ProcessTransformedBlock(batch.channel_data,
+                                      batch.frequential.rows());
+    }
+
+    batch.fft->BackwardBatch(batch.frequential.data(), batch.post_ifft.data(),
+                             channel_count);
+
+    for (auto ready_idx = 0; ready_idx < batch.ready_filters.size();
+         ready_idx++) {
+      auto& filter = filters_[batch.ready_filters[ready_idx]];
+      auto& output = batch.hops[batch.ready_filters[ready_idx]];
+      filter->impl_->SynthesizeTransformed(
+          batch.post_ifft.middleCols(batch.ready_offsets[ready_idx],
+                                     filter->channel_count()),
+          &output);
+      filter->output_buffer_->Write(output, output.size());
+      filter->counters_.AddHop();
+    }
+  }
+
+  for (auto filter_idx = 0; filter_idx < filters_.size(); filter_idx++) {
+    auto& filter = *filters_[filter_idx];
+    auto buffer = buffers[filter_idx];
+    auto frame_count = buffer->frame_count();
+    if (!filter.output_buffer_->Read(buffer, frame_count)) {
+      // if we don't have enough data to be read, just fill with zeros
+      for (auto channel_idx = 0; channel_idx < buffer->channel_count();
+           channel_idx++) {
+        std::fill(buffer->data(channel_idx),
+                  buffer->data(channel_idx) + frame_count, 0);
+      }
+    }
+    filter.counters_.AddBlock();
+  }
+}
+
+uint32_t FilterBatch::filter_count() const { return filters_.size(); }
+
+}  // namespace rtff
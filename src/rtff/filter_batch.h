@@ -0,0 +1,62 @@
+#ifndef RTFF_FILTER_BATCH_H_
+#define RTFF_FILTER_BATCH_H_
+
+#include <memory>
+#include <system_error>
+#include <vector>
+
+#include "rtff/abstract_filter.h"
+#include "rtff/buffer/audio_buffer.h"
+
+namespace rtff {
+
+/**
+ * @brief Process several filters sharing the same configuration with batched
+ * transforms.
+ * The frames that are ready in every filter are windowed and transformed by
+ * a single batched forward transform. Each filter then processes its own
+ * spectrum, and a single batched inverse transform precedes the overlap-add
+ * of every filter. It amortizes the transform setup over many streams, which
+ * matters for small fft sizes.
+ * @note the filters must have the same fft size, overlap, window types,
+ * block size and denormal flush setting. Silence detection, inactive channels and pair transforms are not
+ * used by the batch
+ */
+class FilterBatch {
+ public:
+  FilterBatch();
+  ~FilterBatch();
+
+  /**
+   * @brief add a filter to the batch
+   * @param filter: an initialized filter. It must only be processed through
+   * the batch from now on
+   * @param err: an error code that gets set if the filter configuration
+   * differs from the one of the filters already in the batch, if the
+   * filter has lookahead frames, or if it was prepared for Reconfigure: the
+   * batch can't switch configurations
+   */
+  void AddFilter(std::shared_ptr<AbstractFilter> filter, std::error_code& err);
+
+  /**
+   * @brief process a block of every filter
+   * @param buffers: one buffer per filter, in the order the filters were
+   * added. Each buffer holds block size frames and is processed in place
+   */
+  void ProcessBlocks(const std::vector<AudioBuffer*>& buffers);
+
+  /**
+   * @return the number of filters in the batch
+   */
+  uint32_t filter_count() const;
+
+ private:
+  std::vector<std::shared_ptr<AbstractFilter>> filters_;
+
+  class Impl;
+  std::shared_ptr<Impl> impl_;
+};
+
+}  // namespace rtff
+
+#endif  // RTFF_FILTER_BATCH_H_
@@ -0,0 +1,110 @@
+#include "rtff/filter_chain.h"
+
+namespace rtff {
+
+/**
+ * @brief a filter applying a list of filters sharing the same configuration to
+ * each time frequency frame
+ */
+class FilterChain::Segment : public AbstractFilter {
+ public:
+  bool Accepts(const AbstractFilter& filter) const {
+    return filter.fft_size() == fft_size() && filter.overlap() == overlap() &&
+           filter.windows_type() == windows_type() &&
+           filter.synthesis_windows_type() == synthesis_windows_type() &&
+           filter.overlap_save() == overlap_save() &&
+           filter.lookahead() == lookahead();
+  }
+
+  std::vector<std::shared_ptr<AbstractFilter>> filters;
+
+ protected:
+  void ProcessTransformedBlock(std::vector<std::complex<float>*> data,
+                               uint32_t size) override {
+    for (auto& filter : filters) {
+      FilterChain::ProcessTransformedBlock(filter.get(), *this, data, size);
+    }
+  }
+};
+
+FilterChain::FilterChain(bool allow_split)
+    : allow_split_(allow_split), block_size_(512) {}
+
+void FilterChain::Add(std::shared_ptr<AbstractFilter> filter,
+                      std::error_code& err) {
+  if (!segments_.empty()) {
+    auto& segment = segments_.back();
+    if (filter->channel_count() != segment->channel_count()) {
+      err = std::make_error_code(std::errc::invalid_argument);
+      return;
+    }
+    if (segment->Accepts(*filter)) {
+      segment->filters.push_back(filter);
+      return;
+    }
+    if (!allow_split_) {
+      err = std::make_error_code(std::errc::invalid_argument);
+      return;
+    }
+  }
+
+  // start a new analysis / synthesis segment
+  auto segment = std::make_shared<Segment>();
+  segment->set_lookahead(filter->lookahead());
+  if (filter->overlap_save()) {
+    segment->InitOverlapSave(filter->channel_count(), filter->fft_size(),
+                             filter->overlap() + 1, err);
+  } else {
+    segment->Init(filter->channel_count(), filter->fft_size(),
+                  filter->overlap(), filter->windows_type(),
+                  filter->synthesis_windows_type(), err);
+  }
+  if (err) {
+    return;
+  }
+  segment->set_block_size(block_size_);
+  segment->filters.push_back(filter);
+  segments_.push_back(segment);
+}
+
+void FilterChain::set_block_size(uint32_t value) {
+  block_size_ = value;
+  for (auto& segment : segments_) {
+    segment->set_block_size(value);
+  }
+}
+
+void FilterChain::ProcessBlock(AudioBuffer* buffer) {
+  for (auto& segment : segments_) {
+    segment->ProcessBlock(buffer);
+  }
+}
+
+uint32_t FilterChain::FrameLatency() const {
+  uint32_t latency = 0;
+  for (const auto& segment : segments_) {
+    latency += segment->FrameLatency();
+  }
+  return latency;
+}
+
+uint32_t FilterChain::block_size() const { return block_size_; }
+uint32_t FilterChain::channel_count() const {
+  if (segments_.empty()) {
+    return 0;
+  }
+  return segments_.front()->channel_count();
+}
+uint32_t FilterChain::segment_count() const { return segments_.size(); }
+
+void FilterChain::ProcessTransformedBlock(
+    AbstractFilter* filter, const AbstractFilter& segment,
+    std::vector<std::complex<float>*> data, uint32_t size) {
+  // each filter keeps the frames it receives, and reads the lookahead frames
+  // of its segment
+  filter->frame_history_.Push(data.data());
+  filter->lookahead_source_ = &segment;
+  filter->ProcessTransformedBlock(data, size);
+}
+
+}  // namespace rtff
@@ -0,0 +1,85 @@
+#ifndef RTFF_FILTER_CHAIN_H_
+#define RTFF_FILTER_CHAIN_H_
+
+#include <complex>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+#include "rtff/abstract_filter.h"
+
+namespace rtff {
+
+/**
+ * @brief Run several frequential filters in series.
+ * Consecutive filters sharing the same stft configuration (fft size, overlap
+ * and window) are applied to the same time frequency frame, so they only cost
+ * one analysis, one synthesis and one latency.
+ */
+class FilterChain {
+ public:
+  /**
+   * @brief Constructor
+   * @param allow_split: if true, a filter with a different stft configuration
+   * starts a new analysis / synthesis segment. Otherwise adding it is an error
+   */
+  explicit FilterChain(bool allow_split = true);
+
+  /**
+   * @brief append a filter at the end of the chain
+   * @param filter: an initialized filter. Only its ProcessTransformedBlock
+   * function is used, its own buffers are left untouched
+   * @param err: an error code that gets set if the channel count doesn't match
+   * the other filters, or if the stft configuration or the lookahead differs
+   * and the chain is not allowed to split
+   */
+  void Add(std::shared_ptr<AbstractFilter> filter, std::error_code& err);
+
+  /**
+   * @brief define the block size
+   * @param value: the block size
+   * @see AbstractFilter::set_block_size
+   */
+  void set_block_size(uint32_t value);
+
+  /**
+   * @brief Process a buffer through every filter of the chain
+   * @param buffer: the data
+   * @see AbstractFilter::ProcessBlock
+   */
+  void ProcessBlock(AudioBuffer* buffer);
+
+  /**
+   * @return The latency generated by the whole chain in frames
+   */
+  uint32_t FrameLatency() const;
+
+  /**
+   * @return the block size
+   */
+  uint32_t block_size() const;
+  /**
+   * @return the number of channel of the input signal
+   */
+  uint32_t channel_count() const;
+  /**
+   * @return the number of analysis / synthesis round trips of the chain
+   */
+  uint32_t segment_count() const;
+
+ private:
+  class Segment;
+
+  static void ProcessTransformedBlock(AbstractFilter* filter,
+                                      const AbstractFilter& segment,
+                                      std::vector<std::complex<float>*> data,
+                                      uint32_t size);
+
+  bool allow_split_;
+  uint32_t block_size_;
+  std::vector<std::shared_ptr<Segment>> segments_;
+};
+
+}  // namespace rtff
+
+#endif  // RTFF_FILTER_CHAIN_H_
@@ -1,87 +1,418 @@
 #include "rtff/filter_impl.h"
 
+#include <algorithm>
+#include <cmath>
+
+#ifdef RTFF_ENABLE_MULTITHREAD
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#endif  // RTFF_ENABLE_MULTITHREAD
+
 #include "rtff/fft/fft.h"
+#include "rtff/stft_config.h"
 
 namespace rtff {
 
+const uint32_t FilterImpl::kChannelGroupSize;
+
 void FilterImpl::Init(uint32_t fft_size, uint32_t overlap,
                       fft_window::Type windows_type,
-                      uint8_t channel_count, std::error_code& err) {
-  fft_size_ = fft_size;
-  overlap_ = overlap;
-
-  // init the window to an hamming
-  analysis_window_ = Window::Make(windows_type, fft_size);
-  synthesis_window_ = Window::Make(windows_type, fft_size);
-  unwindow_ = Window::MakeInverse(windows_type, windows_type,
-                                  fft_size, hop_size());
-
-  // init the fft
-  fft_ = Fft::Create(fft_size_, err);
+                      uint32_t channel_count, std::error_code& err) {
+  Init(fft_size, overlap, windows_type, channel_count, Mode::AnalysisSynthesis,
+       err);
+}
+
+void FilterImpl::Init(uint32_t fft_size, uint32_t overlap,
+                      fft_window::Type windows_type, uint32_t channel_count,
+                      Mode mode, std::error_code& err) {
+  auto config = StftConfig::Get(fft_size, overlap, windows_type, err);
   if (err) {
     return;
   }
+  Init(config, channel_count, mode, err);
+}
+
+void FilterImpl::Init(std::shared_ptr<const StftConfig> config,
+                      uint32_t channel_count, Mode mode,
+                      std::error_code& err) {
+  Init(config, channel_count, mode, nullptr, err);
+}
+
+void FilterImpl::ReserveBuffers(const StftConfig& config,
+                                uint32_t channel_count, Mode mode,
+                                Arena* arena) {
+  if (mode == Mode::Analysis) {
+    return;
+  }
+  // overlap-save doesn't overlap the inverse transforms
+  auto tail_rows = config.overlap_save() ? 0 : config.overlap();
+  TimeAmplitudeBuffer::Reserve(tail_rows, channel_count, arena);
+  TimeAmplitudeBuffer::Reserve(config.window_size(), channel_count, arena);
+}
+
+void FilterImpl::Init(std::shared_ptr<const StftConfig> config,
+                      uint32_t channel_count, Mode mode,
+                      std::shared_ptr<Arena> arena, std::error_code& err) {
+  config_ = config;
+  channel_count_ = channel_count;
+  mode_ = mode;
+  pair_transforms_ = false;
+  tail_flush_threshold_ = 0;
+
+  // init one fft per group of channels
+  auto direction = Fft::Direction::Both;
+  if (mode == Mode::Analysis) {
+    direction = Fft::Direction::Forward;
+  } else if (mode == Mode::Synthesis) {
+    direction = Fft::Direction::Backward;
+  }
+  auto group_count = (channel_count + kChannelGroupSize - 1) / kChannelGroupSize;
+  ffts_.clear();
+  for (uint32_t group_idx = 0; group_idx < group_count; group_idx++) {
+#ifndef RTFF_ENABLE_MULTITHREAD
+    // groups are processed one after the other, so they share the tables and
+    // scratch buffers of a single fft computer, which stay in cache
+    if (!ffts_.empty()) {
+      ffts_.push_back(ffts_.front());
+      continue;
+    }
+#endif  // RTFF_ENABLE_MULTITHREAD
+    auto fft = Fft::Create(fft_size(), direction, err);
+    if (err) {
+      return;
+    }
+    auto group_size = std::min(kChannelGroupSize,
+                               channel_count - group_idx * kChannelGroupSize);
+    if (group_size > 1) {
+      fft->PrepareBatch(group_size, err);
+      if (err) {
+        return;
+      }
+    }
+    ffts_.push_back(fft);
+  }
 
+  InitBuffers(arena, err);
+}
+
+void FilterImpl::InitBuffers(std::shared_ptr<Arena> arena,
+                             std::error_code& err) {
   // init inverse transform temp data
-  previous_buffer_.resize(channel_count);
-  result_buffer_.resize(channel_count);
-  post_ifft_buffer_.resize(channel_count);
-  for (auto channel_idx = 0; channel_idx < channel_count; channel_idx++) {
-    previous_buffer_[channel_idx] =
-        Eigen::VectorXf::Zero(window_size() - hop_size());
-    post_ifft_buffer_[channel_idx].resize(window_size());
-    result_buffer_[channel_idx].resize(window_size());
+  tail_size_.clear();
+  if (mode_ == Mode::Analysis) {
+    previous_buffer_ = TimeAmplitudeBuffer();
+    post_ifft_buffer_ = TimeAmplitudeBuffer();
+    return;
   }
+  tail_size_.resize(channel_count_, 0);
+  if (!arena) {
+    arena = std::make_shared<Arena>();
+    ReserveBuffers(*config_, channel_count_, mode_, arena.get());
+    arena->Allocate(false, err);
+    if (err) {
+      return;
+    }
+  }
+  // overlap-save doesn't overlap the inverse transforms
+  auto tail_rows = config_->overlap_save() ? 0 : window_size() - hop_size();
+  previous_buffer_.Init(tail_rows, channel_count_, arena);
+  post_ifft_buffer_.Init(window_size(), channel_count_, arena);
 }
 
-uint32_t FilterImpl::overlap() const { return overlap_; }
-uint32_t FilterImpl::fft_size() const { return fft_size_; }
-uint32_t FilterImpl::window_size() const { return analysis_window().size(); }
-uint32_t FilterImpl::hop_size() const { return fft_size_ - overlap_; }
+void FilterImpl::Reset() {
+  previous_buffer_.matrix().setZero();
+  std::fill(tail_size_.begin(), tail_size_.end(), 0);
+}
+
+void FilterImpl::set_pair_transforms(bool enabled, std::error_code& err) {
+  if (enabled && !pair_transforms_) {
+    for (uint32_t group_idx = 0; group_idx < ffts_.size(); group_idx++) {
+      if (group_idx > 0 && ffts_[group_idx] == ffts_[group_idx - 1]) {
+        // a shared fft computer is prepared once
+        continue;
+      }
+      ffts_[group_idx]->PreparePairs(err);
+      if (err) {
+        return;
+      }
+    }
+  }
+  pair_transforms_ = enabled;
+}
+void FilterImpl::set_tail_flush_threshold(float threshold) {
+  tail_flush_threshold_ = std::abs(threshold);
+}
+float FilterImpl::tail_flush_threshold() const {
+  return tail_flush_threshold_;
+}
+
+bool FilterImpl::pair_transforms() const { return pair_transforms_; }
+
+uint32_t FilterImpl::overlap() const { return config_->overlap(); }
+uint32_t FilterImpl::fft_size() const { return config_->fft_size(); }
+uint32_t FilterImpl::window_size() const { return config_->window_size(); }
+uint32_t FilterImpl::hop_size() const { return config_->hop_size(); }
+const std::shared_ptr<const StftConfig>& FilterImpl::config() const {
+  return config_;
+}
 const Eigen::VectorXf& FilterImpl::analysis_window() const {
-  return analysis_window_;
+  return config_->analysis_window();
 }
 const Eigen::VectorXf& FilterImpl::synthesis_window() const {
-  return synthesis_window_;
+  return config_->synthesis_window();
 }
 
 void FilterImpl::Analyze(TimeAmplitudeBuffer& amplitude,
                          TimeFrequencyBuffer* frequential) {
-  for (uint8_t channel_idx = 0; channel_idx < amplitude.channel_count();
-       channel_idx++) {
-    // apply the analysis window
-    amplitude.channel(channel_idx).array() *= analysis_window_.array();
-    // compute the fft and store it into the frequential buffer
-    fft_->Forward(amplitude.channel(channel_idx).data(),
-                  frequential->channel(channel_idx).data());
-  }
+  ForEachGroup([&](uint32_t group_idx) {
+    AnalyzeGroup(amplitude, frequential, nullptr, group_idx);
+  });
+}
+
+void FilterImpl::Analyze(TimeAmplitudeBuffer& amplitude,
+                         TimeFrequencyBuffer* frequential,
+                         const std::vector<uint8_t>& silent_channels) {
+  ForEachGroup([&](uint32_t group_idx) {
+    AnalyzeGroup(amplitude, frequential, &silent_channels, group_idx);
+  });
 }
 
 void FilterImpl::Synthesize(const TimeFrequencyBuffer& frequential,
                             TimeAmplitudeBuffer* amplitude) {
-  for (uint8_t channel_idx = 0; channel_idx < frequential.channel_count();
-       channel_idx++) {
-    auto& result_ = result_buffer_[channel_idx];
-    auto& previous_ = previous_buffer_[channel_idx];
-    auto& post_ifft = post_ifft_buffer_[channel_idx];
+  ForEachGroup([&](uint32_t group_idx) {
+    SynthesizeGroup(frequential, amplitude, nullptr, group_idx);
+  });
+}
 
-    // ifft
-    fft_->Backward(frequential.channel(channel_idx).data(), post_ifft.data());
-    // apply synthesis window and sum to previous data
-    // sum with previous data
-    memset(result_.data(), 0, result_.size() * sizeof(float));
+void FilterImpl::Synthesize(const TimeFrequencyBuffer& frequential,
+                            TimeAmplitudeBuffer* amplitude,
+                            const std::vector<uint8_t>& silent_channels) {
+  ForEachGroup([&](uint32_t group_idx) {
+    SynthesizeGroup(frequential, amplitude, &silent_channels, group_idx);
+  });
+}
 
-    result_.head(previous_.size()) = previous_;
-    result_.array() +=
-        post_ifft.array() * synthesis_window_.array() / unwindow_.array();
+template <typename Function>
+void FilterImpl::ForEachGroup(Function function) {
+#ifdef RTFF_ENABLE_MULTITHREAD
+  if (ffts_.size() > 1) {
+    tbb::parallel_for(tbb::blocked_range<uint32_t>(0, ffts_.size()),
+                      [&](const tbb::blocked_range<uint32_t>& range) {
+                        for (auto group_idx = range.begin();
+                             group_idx != range.end(); group_idx++) {
+                          function(group_idx);
+                        }
+                      });
+    return;
+  }
+#endif  // RTFF_ENABLE_MULTITHREAD
+  for (uint32_t group_idx = 0; group_idx < ffts_.size(); group_idx++) {
+    function(group_idx);
+  }
+}
 
-    // keep previous buffer for synthesis
-    previous_ = result_.tail(previous_.size());
+void FilterImpl::AnalyzeGroup(TimeAmplitudeBuffer& amplitude,
+                              TimeFrequencyBuffer* frequential,
+                              const std::vector<uint8_t>* silent_channels,
+                              uint32_t group_idx) {
+  auto begin = group_idx * kChannelGroupSize;
+  auto end = std::min(begin + kChannelGroupSize, channel_count_);
+  if (!silent_channels && !pair_transforms_) {
+    // window and transform the whole group at once
+    ApplyAnalysisWindow(amplitude.matrix().middleCols(begin, end - begin));
+    ffts_[group_idx]->ForwardBatch(amplitude.channel(begin).data(),
+                                   frequential->channel(begin).data(),
+                                   end - begin);
+    return;
+  }
 
-    // unwindow to get the right buffer
-    amplitude->channel(channel_idx).noalias() =
-        result_.head(hop_size()).transpose();
+  for (auto channel_idx = begin; channel_idx < end; channel_idx++) {
+    if (silent_channels && (*silent_channels)[channel_idx]) {
+      // the transform of a silent frame is a silent spectrum
+      frequential->channel(channel_idx).setZero();
+      continue;
+    }
+    if (pair_transforms_ && channel_idx + 1 < end &&
+        !(silent_channels && (*silent_channels)[channel_idx + 1])) {
+      AnalyzeChannelPair(amplitude, frequential, channel_idx);
+      channel_idx++;
+      continue;
+    }
+    AnalyzeChannel(amplitude, frequential, channel_idx);
   }
 }
 
+void FilterImpl::SynthesizeGroup(const TimeFrequencyBuffer& frequential,
+                                 TimeAmplitudeBuffer* amplitude,
+                                 const std::vector<uint8_t>* silent_channels,
+                                 uint32_t group_idx) {
+  auto begin = group_idx * kChannelGroupSize;
+  auto end = std::min(begin + kChannelGroupSize, channel_count_);
+  if (!silent_channels && !pair_transforms_) {
+    // transform and overlap-add the whole group at once
+    ffts_[group_idx]->BackwardBatch(frequential.channel(begin).data(),
+                                    post_ifft_buffer_.channel(begin).data(),
+                                    end - begin);
+    OverlapAdd(post_ifft_buffer_.matrix().middleCols(begin, end - begin),
+               amplitude, begin);
+    return;
+  }
+
+  for (auto channel_idx = begin; channel_idx < end; channel_idx++) {
+    if (silent_channels && (*silent_channels)[channel_idx]) {
+      SynthesizeSilentChannel(amplitude, channel_idx);
+      continue;
+    }
+    if (pair_transforms_ && channel_idx + 1 < end &&
+        !(silent_channels && (*silent_channels)[channel_idx + 1])) {
+      SynthesizeChannelPair(frequential, amplitude, channel_idx);
+      channel_idx++;
+      continue;
+    }
+    SynthesizeChannel(frequential, amplitude, channel_idx);
+  }
+}
+
+void FilterImpl::AnalyzeChannel(TimeAmplitudeBuffer& amplitude,
+                                TimeFrequencyBuffer* frequential,
+                                uint32_t channel_idx) {
+  // apply the analysis window
+  ApplyAnalysisWindow(amplitude.matrix().col(channel_idx));
+  // compute the fft and store it into the frequential buffer
+  fft(channel_idx).Forward(amplitude.channel(channel_idx).data(),
+                           frequential->channel(channel_idx).data());
+}
+
+void FilterImpl::AnalyzeChannelPair(TimeAmplitudeBuffer& amplitude,
+                                    TimeFrequencyBuffer* frequential,
+                                    uint32_t channel_idx) {
+  ApplyAnalysisWindow(amplitude.matrix().middleCols(channel_idx, 2));
+  fft(channel_idx).ForwardPair(amplitude.channel(channel_idx).data(),
+                               amplitude.channel(channel_idx + 1).data(),
+                               frequential->channel(channel_idx).data(),
+                               frequential->channel(channel_idx + 1).data());
+}
+
+void FilterImpl::SynthesizeChannel(const TimeFrequencyBuffer& frequential,
+                                   TimeAmplitudeBuffer* amplitude,
+                                   uint32_t channel_idx) {
+  // ifft
+  fft(channel_idx).Backward(frequential.channel(channel_idx).data(),
+                            post_ifft_buffer_.channel(channel_idx).data());
+  OverlapAdd(post_ifft_buffer_.matrix().col(channel_idx), amplitude,
+             channel_idx);
+}
+
+void FilterImpl::SynthesizeChannelPair(const TimeFrequencyBuffer& frequential,
+                                       TimeAmplitudeBuffer* amplitude,
+                                       uint32_t channel_idx) {
+  fft(channel_idx).BackwardPair(frequential.channel(channel_idx).data(),
+                                frequential.channel(channel_idx + 1).data(),
+                                post_ifft_buffer_.channel(channel_idx).data(),
+                                post_ifft_buffer_.channel(channel_idx + 1)
+                                    .data());
+  OverlapAdd(post_ifft_buffer_.matrix().middleCols(channel_idx, 2), amplitude,
+             channel_idx);
+}
+
+void FilterImpl::ApplyAnalysisWindow(
+    Eigen::Ref<Eigen::MatrixXf> amplitude) const {
+  // rectangular frames are left untouched
+  if (config_->window_type() == fft_window::Type::Rectangular) {
+    return;
+  }
+  amplitude.array().colwise() *= analysis_window().array();
+}
+
+void FilterImpl::SynthesizeTransformed(Eigen::Ref<Eigen::MatrixXf> post_ifft,
+                                       TimeAmplitudeBuffer* amplitude) {
+  OverlapAdd(post_ifft, amplitude, 0);
+}
+
+void FilterImpl::OverlapAdd(Eigen::Ref<Eigen::MatrixXf> post_ifft,
+                            TimeAmplitudeBuffer* amplitude,
+                            uint32_t channel_idx) {
+  auto count = post_ifft.cols();
+  if (config_->overlap_save()) {
+    // the head of the inverse transform is circularly aliased, the tail is
+    // the linear convolution of the newest hop
+    amplitude->matrix().middleCols(channel_idx, count) =
+        post_ifft.bottomRows(hop_size());
+    return;
+  }
+  auto previous_ = previous_buffer_.matrix().middleCols(channel_idx, count);
+
+  // apply the synthesis window and unwindow in a single gain, then sum with
+  // the previous data. The inverse transform is used as the result buffer
+  switch (config_->gain_type()) {
+    case StftConfig::GainType::Window:
+      post_ifft.array().colwise() *= config_->synthesis_gain().array();
+      break;
+    case StftConfig::GainType::Scalar:
+      post_ifft *= config_->synthesis_scale();
+      break;
+    case StftConfig::GainType::None:
+      break;
+  }
+  post_ifft.topRows(previous_.rows()) += previous_;
+
+  // keep previous buffer for synthesis
+  previous_ = post_ifft.bottomRows(previous_.rows());
+  std::fill(tail_size_.begin() + channel_idx,
+            tail_size_.begin() + channel_idx + count, previous_.rows());
+  if (tail_flush_threshold_ > 0) {
+    FlushTail(channel_idx, count);
+  }
+
+  amplitude->matrix().middleCols(channel_idx, count) =
+      post_ifft.topRows(hop_size());
+}
+
+void FilterImpl::FlushTail(uint32_t channel_idx, uint32_t count) {
+  if (previous_buffer_.size() == 0) {
+    return;
+  }
+  for (auto idx = channel_idx; idx < channel_idx + count; idx++) {
+    auto tail = previous_buffer_.channel(idx);
+    if (tail.cwiseAbs().maxCoeff() <= tail_flush_threshold_) {
+      // a decayed tail: silent channels don't need to overlap it anymore
+      tail.setZero();
+      tail_size_[idx] = 0;
+      continue;
+    }
+    tail = (tail.array().abs() <= tail_flush_threshold_)
+               .select(0.f, tail.array());
+  }
+}
+
+void FilterImpl::SynthesizeSilentChannel(TimeAmplitudeBuffer* amplitude,
+                                         uint32_t channel_idx) {
+  auto& tail_size = tail_size_[channel_idx];
+  if (tail_size == 0) {
+    // nothing left to overlap
+    amplitude->channel(channel_idx).setZero();
+    return;
+  }
+
+  // same as SynthesizeChannel with a zero inverse transform: only shift the
+  // overlap-add tail
+  auto previous_ = previous_buffer_.channel(channel_idx);
+  auto output = amplitude->channel(channel_idx);
+  auto tail_rows = static_cast<uint32_t>(previous_.size());
+  auto output_rows = std::min(hop_size(), tail_rows);
+  output.head(output_rows) = previous_.head(output_rows);
+  output.tail(hop_size() - output_rows).setZero();
+  if (tail_rows > hop_size()) {
+    // a forward copy, the destination is before the source
+    std::copy(previous_.data() + hop_size(), previous_.data() + tail_rows,
+              previous_.data());
+  }
+  previous_.tail(output_rows).setZero();
+  tail_size = tail_size > hop_size() ? tail_size - hop_size() : 0;
+}
+
+Fft& FilterImpl::fft(uint32_t channel_idx) {
+  return *ffts_[channel_idx / kChannelGroupSize];
+}
+
 }  // namespace rtff
@@ -11,11 +11,12 @@
 #include "rtff/buffer/buffer.h"
 #include "rtff/buffer/ring_buffer.h"
 
-#include "rtff/fft/window.h"
+#include "rtff/fft/window_type.h"
 
 namespace rtff {
 
 class Fft;
+class StftConfig;
 
 /**
  * @brief the Filter Implementation.
@@ -24,16 +25,113 @@ class Fft;
  */
 class FilterImpl {
  public:
+  /**
+   * @brief the stages the implementation is prepared for
+   */
+  enum class Mode : uint8_t {
+    /** analysis and synthesis */
+    AnalysisSynthesis,
+    /** analysis only. No synthesis state nor backward transform is allocated
+       and Synthesize must not be called */
+    Analysis,
+    /** synthesis only. No analysis window nor forward transform is allocated
+       and Analyze must not be called */
+    Synthesis
+  };
+
+  /**
+   * @brief Initialize for both analysis and synthesis
+   * @param fft_size: the length in samples of the fourier transform window.
+   * @param overlap: the number of samples that will be kept between each
+   * @param windows_type: type of analysis and synthesis window for FFT
+   * @param channel_count: the number of channel of the input signal
+   * @param err: an error code that gets set if something goes wrong
+   */
+  void Init(uint32_t fft_size, uint32_t overlap, fft_window::Type windows_type,
+            uint32_t channel_count, std::error_code& err);
   /**
    * @brief Initialize
    * @param fft_size: the length in samples of the fourier transform window.
    * @param overlap: the number of samples that will be kept between each
    * @param windows_type: type of analysis and synthesis window for FFT
    * @param channel_count: the number of channel of the input signal
+   * @param mode: the stages to prepare
    * @param err: an error code that gets set if something goes wrong
    */
   void Init(uint32_t fft_size, uint32_t overlap, fft_window::Type windows_type,
-            uint8_t channel_count, std::error_code& err);
+            uint32_t channel_count, Mode mode, std::error_code& err);
+  /**
+   * @brief Initialize with a shared configuration
+   * @param config: the configuration. Its windows and gain tables are shared
+   * with every implementation using it
+   * @param channel_count: the number of channel of the input signal
+   * @param mode: the stages to prepare
+   * @param err: an error code that gets set if something goes wrong
+   */
+  void Init(std::shared_ptr<const StftConfig> config, uint32_t channel_count,
+            Mode mode, std::error_code& err);
+  /**
+   * @brief Initialize with a shared configuration, taking the synthesis state
+   * out of an arena
+   * @param config: the configuration. Its windows and gain tables are shared
+   * with every implementation using it
+   * @param channel_count: the number of channel of the input signal
+   * @param mode: the stages to prepare
+   * @param arena: an allocated arena the buffers were reserved in with
+   * ReserveBuffers. If nullptr, the buffers allocate their own memory
+   * @param err: an error code that gets set if something goes wrong
+   */
+  void Init(std::shared_ptr<const StftConfig> config, uint32_t channel_count,
+            Mode mode, std::shared_ptr<Arena> arena, std::error_code& err);
+  /**
+   * @brief reserve the room of the synthesis state in an arena
+   * @param config: the configuration
+   * @param channel_count: the number of channel of the input signal
+   * @param mode: the stages to prepare
+   * @param arena: the arena, not allocated yet
+   */
+  static void ReserveBuffers(const StftConfig& config, uint32_t channel_count,
+                             Mode mode, Arena* arena);
+  /**
+   * @brief allocate the synthesis state again, which resets it
+   * @param arena: an allocated arena the buffers were reserved in with
+   * ReserveBuffers. If nullptr, the buffers allocate their own memory
+   * @param err: an error code that gets set if the allocation fails
+   */
+  void InitBuffers(std::shared_ptr<Arena> arena, std::error_code& err);
+  /**
+   * @brief clear the synthesis state, as after Init. It doesn't allocate
+   */
+  void Reset();
+
+  /**
+   * @brief transform channels two by two with a single complex fft
+   * @note two real signals x and y are packed into x + i * y and separated
+   * after the transform, which roughly halves the transform cost of even
+   * channel counts. Results only differ from the per channel transforms by
+   * rounding errors. Disabled by default
+   * @param enabled: true to transform channel pairs
+   * @param err: an error code that gets set if the fft backend fails to
+   * prepare the pair transforms
+   */
+  void set_pair_transforms(bool enabled, std::error_code& err);
+  /**
+   * @return true if channels are transformed two by two
+   */
+  bool pair_transforms() const;
+
+  /**
+   * @brief flush the tiny values of the overlap-add tail
+   * @note samples of the tail whose absolute value is lower or equal to the
+   * threshold are set to zero after each synthesis. A tail that is entirely
+   * flushed lets silent channels skip their overlap-add. Disabled by default
+   * @param threshold: the flush threshold, 0 to disable the flush
+   */
+  void set_tail_flush_threshold(float threshold);
+  /**
+   * @return the flush threshold of the overlap-add tail
+   */
+  float tail_flush_threshold() const;
 
   /**
    * @brief convert a signal to its time frequency representation
@@ -53,6 +151,45 @@ class FilterImpl {
   void Synthesize(const TimeFrequencyBuffer& frequential,
                   TimeAmplitudeBuffer* amplitude);
 
+  /**
+   * @brief convert a signal to its time frequency representation, skipping
+   * silent channels
+   * @param amplitude: the original signal buffer. Silent channels are not read
+   * @param frequential: the time frequency representation. The spectrum of
+   * silent channels is set to zero without any transform
+   * @param silent_channels: one flag per channel, non zero for silent channels
+   */
+  void Analyze(TimeAmplitudeBuffer& amplitude, TimeFrequencyBuffer* frequential,
+               const std::vector<uint8_t>& silent_channels);
+
+  /**
+   * @brief convert a time frequency representation into its signal, skipping
+   * the inverse transform of silent channels
+   * @note silent channels keep flushing their overlap-add tail, so the output
+   * is the same as synthesizing a zero spectrum
+   * @param frequential: the time frequency representation. The spectrum of
+   * silent channels is ignored
+   * @param amplitude: the signal buffer
+   * @param silent_channels: one flag per channel, non zero for silent channels
+   */
+  void Synthesize(const TimeFrequencyBuffer& frequential,
+                  TimeAmplitudeBuffer* amplitude,
+                  const std::vector<uint8_t>& silent_channels);
+
+  /**
+   * @brief overlap-add frames that were already inverse transformed, for
+   * example by a transform shared between several filters
+   * @param post_ifft: the inverse transforms, one column of window size
+   * samples per channel. It is used as scratch and gets modified
+   * @param amplitude: the signal buffer
+   */
+  void SynthesizeTransformed(Eigen::Ref<Eigen::MatrixXf> post_ifft,
+                             TimeAmplitudeBuffer* amplitude);
+
+  /**
+   * @return the shared configuration
+   */
+  const std::shared_ptr<const StftConfig>& config() const;
   /**
    * @return the window used for the analysis stage
    */
@@ -79,17 +216,56 @@ class FilterImpl {
   uint32_t hop_size() const;
 
  private:
-  uint32_t fft_size_, overlap_;
+  // channels are processed by groups, so that groups can be transformed in
+  // batches and in parallel
+  static const uint32_t kChannelGroupSize = 8;
+
+  template <typename Function>
+  void ForEachGroup(Function function);
+  void AnalyzeGroup(TimeAmplitudeBuffer& amplitude,
+                    TimeFrequencyBuffer* frequential,
+                    const std::vector<uint8_t>* silent_channels,
+                    uint32_t group_idx);
+  void SynthesizeGroup(const TimeFrequencyBuffer& frequential,
+                       TimeAmplitudeBuffer* amplitude,
+                       const std::vector<uint8_t>* silent_channels,
+                       uint32_t group_idx);
+  void AnalyzeChannel(TimeAmplitudeBuffer& amplitude,
+                      TimeFrequencyBuffer* frequential, uint32_t channel_idx);
+  void AnalyzeChannelPair(TimeAmplitudeBuffer& amplitude,
+                          TimeFrequencyBuffer* frequential,
+                          uint32_t channel_idx);
+  void SynthesizeChannel(const TimeFrequencyBuffer& frequential,
+                         TimeAmplitudeBuffer* amplitude, uint32_t channel_idx);
+  void SynthesizeChannelPair(const TimeFrequencyBuffer& frequential,
+                             TimeAmplitudeBuffer* amplitude,
+                             uint32_t channel_idx);
+  void SynthesizeSilentChannel(TimeAmplitudeBuffer* amplitude,
+                               uint32_t channel_idx);
+  void ApplyAnalysisWindow(Eigen::Ref<Eigen::MatrixXf> amplitude) const;
+  void OverlapAdd(Eigen::Ref<Eigen::MatrixXf> post_ifft,
+                  TimeAmplitudeBuffer* amplitude, uint32_t channel_idx);
+  void FlushTail(uint32_t channel_idx, uint32_t count);
+  Fft& fft(uint32_t channel_idx);
 
-  Eigen::VectorXf analysis_window_;
-  Eigen::VectorXf synthesis_window_;
-  Eigen::VectorXf unwindow_;
+  // windows and gain tables, shared with the other streams
+  std::shared_ptr<const StftConfig> config_;
+  uint32_t channel_count_;
+  Mode mode_;
+  bool pair_transforms_;
 
-  std::shared_ptr<Fft> fft_;
+  // the fft computer of each group of channels. Without
+  // RTFF_ENABLE_MULTITHREAD, every group shares the same one
+  std::vector<std::shared_ptr<Fft>> ffts_;
 
-  std::vector<Eigen::VectorXf> previous_buffer_;
-  std::vector<Eigen::VectorXf> result_buffer_;
-  std::vector<Eigen::VectorXf> post_ifft_buffer_;
+  // synthesis state, one column per channel: the overlap-add tail and the
+  // inverse transform scratch
+  TimeAmplitudeBuffer previous_buffer_;
+  TimeAmplitudeBuffer post_ifft_buffer_;
+  // number of samples of the previous buffer that may not be zero
+  std::vector<uint32_t> tail_size_;
+  // tail samples up to this absolute value are set to zero, 0 disables it
+  float tail_flush_threshold_;
 };
 
 }  // namespace rtff
@@ -0,0 +1,306 @@
+#include "rtff/filterbank.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+#include <Eigen/Core>
+#include <Eigen/QR>
+
+namespace rtff {
+
+namespace {
+
+// the number of channels projected together, sharing each band weights
+const uint32_t kChannelGroup = 8;
+// directions of the gram matrix weaker than this, relative to the strongest
+// one, are dropped from the pseudo-inverse
+const double kPseudoInverseThreshold = 1e-5;
+
+float HzToMel(float frequency) {
+  return 2595.f * std::log10(1.f + frequency / 700.f);
+}
+float MelToHz(float mel) {
+  return 700.f * (std::pow(10.f, mel / 2595.f) - 1.f);
+}
+
+}  // namespace
+
+class Filterbank::Impl {
+ public:
+  // the bins of band k are [starts[k], starts[k] + sizes[k]) and its weights
+  // start at offsets[k] in weights
+  std::vector<uint32_t> starts;
+  std::vector<uint32_t> sizes;
+  std::vector<uint32_t> offsets;
+  Eigen::VectorXf weights;
+  // the bins weighted by at least one band
+  uint32_t first_bin = 0;
+  uint32_t end_bin = 0;
+
+  // the pseudo-inverse of the band x band gram matrix of the filterbank
+  Eigen::MatrixXf gram_pseudo_inverse;
+
+  // the magnitudes of the covered bins of a channel group, one column per
+  // channel
+  Eigen::MatrixXf magnitudes;
+  // the band values of a channel group, one row per channel
+  Eigen::MatrixXf projection;
+  // the band values of a channel group and their image by the gram
+  // pseudo-inverse, one column per channel
+  Eigen::MatrixXf band_values;
+  Eigen::MatrixXf band_coefficients;
+
+  Eigen::Map<const Eigen::VectorXf> band(uint32_t band_idx) const {
+    return Eigen::Map<const Eigen::VectorXf>(weights.data() + offsets[band_idx],
+                                             sizes[band_idx]);
+  }
+};
+
+Filterbank::Filterbank()
+    : bin_count_(0), band_count_(0), impl_(std::make_shared<Impl>()) {}
+Filterbank::~Filterbank() {}
+
+void Filterbank::InitMel(uint32_t fft_size, float sample_rate,
+                         uint32_t band_count, float min_frequency,
+                         float max_frequency, std::error_code& err) {
+  if (fft_size == 0 || band_count == 0 || sample_rate <= 0 ||
+      min_frequency < 0 || min_frequency >= max_frequency ||
+      max_frequency > sample_rate / 2) {
+    err = std::make_error_code(std::errc::invalid_argument);
+    return;
+  }
+  // band_count + 2 edges evenly spaced in mel
+  auto min_mel = HzToMel(min_frequency);
+  auto max_mel = HzToMel(max_frequency);
+  std::vector<float> edges(band_count + 2);
+  for (uint32_t edge_idx = 0; edge_idx < edges.size(); edge_idx++) {
+    edges[edge_idx] = MelToHz(min_mel + (max_mel - min_mel) * edge_idx /
+                                            (band_count + 1));
+  }
+  InitTriangular(fft_size, sample_rate, edges);
+}
+
+void Filterbank::InitConstantQ(uint32_t fft_size, float sample_rate,
+                               float min_frequency, uint32_t bins_per_octave,
+                               uint32_t band_count, std::error_code& err) {
+  if (fft_size == 0 || band_count == 0 || bins_per_octave == 0 ||
+      sample_rate <= 0 || min_frequency <= 0) {
+    err = std::make_error_code(std::errc::invalid_argument);
+    return;
+  }
+  // the centers of the previous band, of every band and of the next band
+  std::vector<float> edges(band_count + 2);
+  for (uint32_t edge_idx = 0; edge_idx < edges.size(); edge_idx++) {
+    edges[edge_idx] =
+        min_frequency * std::exp2((static_cast<float>(edge_idx) - 1.f) /
+                                  bins_per_octave);
+  }
+  if (edges.back() > sample_rate / 2) {
+    err = std::make_error_code(std::errc::invalid_argument);
+    return;
+  }
+  InitTriangular(fft_size, sample_rate, edges);
+}
+
+void Filterbank::InitTriangular(uint32_t fft_size, float sample_rate,
+                                const std::vector<float>& edges) {
+  bin_count_ = fft_size / 2 + 1;
+  band_count_ = edges.size() - 2;
+  impl_ = std::make_shared<Impl>();
+  auto& bank = *impl_;
+  auto bin_width = sample_rate / fft_size;
+
+  std::vector<float> weights;
+  for (uint32_t band_idx = 0; band_idx < band_count_; band_idx++) {
+    auto lower = edges[band_idx];
+    auto center = edges[band_idx + 1];
+    auto upper = edges[band_idx + 2];
+    // the bins strictly inside the band
+    auto start = static_cast<uint32_t>(std::floor(lower / bin_width)) + 1;
+    auto end = std::min(
+        bin_count_, static_cast<uint32_t>(std::ceil(upper / bin_width)));
+    bank.starts.push_back(start);
+    bank.offsets.push_back(weights.size());
+    for (auto bin_idx = start; bin_idx < end; bin_idx++) {
+      auto frequency = bin_idx * bin_width;
+      weights.push_back(frequency <= center
+                            ? (frequency - lower) / (center - lower)
+                            : (upper - frequency) / (upper - center));
+    }
+    if (end <= start) {
+      // narrower than a bin
+      bank.starts.back() = std::min(
+          bin_count_ - 1, static_cast<uint32_t>(std::round(center / bin_width)));
+      weights.push_back(1);
+    }
+    bank.sizes.push_back(weights.size() - bank.offsets.back());
+  }
+  bank.weights = Eigen::Map<Eigen::VectorXf>(weights.data(), weights.size());
+  Prepare();
+}
+
+void Filterbank::Init(uint32_t bin_count, uint32_t band_count,
+                      const float* weights, std::error_code& err) {
+  if (bin_count == 0 || band_count == 0 || !weights) {
+    err = std::make_error_code(std::errc::invalid_argument);
+    return;
+  }
+  bin_count_ = bin_count;
+  band_count_ = band_count;
+  impl_ = std::make_shared<Impl>();
+  auto& bank = *impl_;
+
+  std::vector<float> sparse_weights;
+  for (uint32_t band_idx = 0; band_idx < band_count; band_idx++) {
+    auto row = weights + static_cast<std::size_t>(band_idx) * bin_count;
+    auto is_set = [](float weight) { return weight != 0; };
+    auto first = std::find_if(row, row + bin_count, is_set);
+    auto last = std::find_if(std::reverse_iterator<const float*>(row + bin_count),
+                             std::reverse_iterator<const float*>(row), is_set)
+                    .base();
+    if (first == row + bin_count) {
+      // an empty band
+      first = last = row;
+    }
+    bank.starts.push_back(first - row);
+    bank.sizes.push_back(last - first);
+    bank.offsets.push_back(sparse_weights.size());
+    sparse_weights.insert(sparse_weights.end(), first, last);
+  }
+  bank.weights =
+      Eigen::Map<Eigen::VectorXf>(sparse_weights.data(), sparse_weights.size());
+  Prepare();
+}
+
+void Filterbank::Prepare() {
+  auto& bank = *impl_;
+  bank.first_bin = bin_count_;
+  bank.end_bin = 0;
+  for (uint32_t band_idx = 0; band_idx < band_count_; band_idx++) {
+    if (bank.sizes[band_idx] == 0) {
+      continue;
+    }
+    bank.first_bin = std::min(bank.first_bin, bank.starts[band_idx]);
+    bank.end_bin = std::max(bank.end_bin,
+                            bank.starts[band_idx] + bank.sizes[band_idx]);
+  }
+  bank.first_bin = std::min(bank.first_bin, bank.end_bin);
+
+  // W+ = W^T (W W^T)+, so the inverse projection stays sparse. The gram
+  // matrix is singular when bands share the same bins
+  Eigen::MatrixXd dense = Eigen::MatrixXd::Zero(band_count_, bin_count_);
+  for (uint32_t band_idx = 0; band_idx < band_count_; band_idx++) {
+    dense.row(band_idx).segment(bank.starts[band_idx], bank.sizes[band_idx]) =
+        bank.band(band_idx).cast<double>().transpose();
+  }
+  Eigen::MatrixXd gram = dense * dense.transpose();
+  Eigen::CompleteOrthogonalDecomposition<Eigen::MatrixXd> decomposition;
+  decomposition.setThreshold(kPseudoInverseThreshold);
+  decomposition.compute(gram);
+  bank.gram_pseudo_inverse = decomposition.pseudoInverse().cast<float>();
+
+  bank.magnitudes.resize(bank.end_bin - bank.first_bin, kChannelGroup);
+  bank.projection.resize(kChannelGroup, band_count_);
+  bank.band_values.resize(band_count_, kChannelGroup);
+  bank.band_coefficients.resize(band_count_, kChannelGroup);
+}
+
+void Filterbank::Project(const float* const* bins, uint32_t channel_count,
+                         float* const* bands) {
+  auto& bank = *impl_;
+  for (uint32_t group_start = 0; group_start < channel_count;
+       group_start += kChannelGroup) {
+    auto group_size = std::min(kChannelGroup, channel_count - group_start);
+    // each band weights are applied to the whole group
+    for (uint32_t band_idx = 0; band_idx < band_count_; band_idx++) {
+      auto weights = bank.band(band_idx);
+      for (uint32_t channel_idx = 0; channel_idx < group_size; channel_idx++) {
+        bands[group_start + channel_idx][band_idx] =
+            weights.dot(Eigen::Map<const Eigen::VectorXf>(
+                bins[group_start + channel_idx] + bank.starts[band_idx],
+                bank.sizes[band_idx]));
+      }
+    }
+  }
+}
+
+void Filterbank::ProjectMagnitudes(const std::complex<float>* const* data,
+                                   uint32_t channel_count, float* const* bands,
+                                   bool power) {
+  auto& bank = *impl_;
+  auto covered = bank.end_bin - bank.first_bin;
+  for (uint32_t group_start = 0; group_start < channel_count;
+       group_start += kChannelGroup) {
+    auto group_size = std::min(kChannelGroup, channel_count - group_start);
+    // the magnitudes of the covered bins only
+    for (uint32_t channel_idx = 0; channel_idx < group_size; channel_idx++) {
+      auto bins = Eigen::Map<const Eigen::VectorXcf>(
+          data[group_start + channel_idx] + bank.first_bin, covered);
+      if (power) {
+        bank.magnitudes.col(channel_idx) = bins.cwiseAbs2();
+      } else {
+        bank.magnitudes.col(channel_idx) = bins.cwiseAbs();
+      }
+    }
+    // one matrix vector product per band for the whole group
+    auto magnitudes = bank.magnitudes.leftCols(group_size);
+    for (uint32_t band_idx = 0; band_idx < band_count_; band_idx++) {
+      if (bank.sizes[band_idx] == 0) {
+        bank.projection.col(band_idx).setZero();
+        continue;
+      }
+      bank.projection.col(band_idx).head(group_size).noalias() =
+          magnitudes
+              .middleRows(bank.starts[band_idx] - bank.first_bin,
+                          bank.sizes[band_idx])
+              .transpose() *
+          bank.band(band_idx);
+    }
+    for (uint32_t channel_idx = 0; channel_idx < group_size; channel_idx++) {
+      Eigen::Map<Eigen::RowVectorXf>(bands[group_start + channel_idx],
+                                     band_count_) =
+          bank.projection.row(channel_idx);
+    }
+  }
+}
+
+void Filterbank::Unproject(const float* const* bands, uint32_t channel_count,
+                           float* const* bins) {
+  auto& bank = *impl_;
+  for (uint32_t group_start = 0; group_start < channel_count;
+       group_start += kChannelGroup) {
+    auto group_size = std::min(kChannelGroup, channel_count - group_start);
+    for (uint32_t channel_idx = 0; channel_idx < group_size; channel_idx++) {
+      bank.band_values.col(channel_idx) = Eigen::Map<const Eigen::VectorXf>(
+          bands[group_start + channel_idx], band_count_);
+    }
+    bank.band_coefficients.leftCols(group_size).noalias() =
+        bank.gram_pseudo_inverse * bank.band_values.leftCols(group_size);
+
+    for (uint32_t channel_idx = 0; channel_idx < group_size; channel_idx++) {
+      auto output = Eigen::Map<Eigen::VectorXf>(
+          bins[group_start + channel_idx], bin_count_);
+      output.setZero();
+      for (uint32_t band_idx = 0; band_idx < band_count_; band_idx++) {
+        output.segment(bank.starts[band_idx], bank.sizes[band_idx]) +=
+            bank.band_coefficients(band_idx, channel_idx) *
+            bank.band(band_idx);
+      }
+    }
+  }
+}
+
+uint32_t Filterbank::bin_count() const { return bin_count_; }
+uint32_t Filterbank::band_count() const { return band_count_; }
+uint32_t Filterbank::band_start(uint32_t band_idx) const {
+  return impl_->starts[band_idx];
+}
+uint32_t Filterbank::band_size(uint32_t band_idx) const {
+  return impl_->sizes[band_idx];
+}
+const float* Filterbank::band_weights(uint32_t band_idx) const {
+  return impl_->weights.data() + impl_->offsets[band_idx];
+}
+
+}  // namespace rtff
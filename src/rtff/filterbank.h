@@ -0,0 +1,155 @@
+#ifndef RTFF_FILTERBANK_H_
+#define RTFF_FILTERBANK_H_
+
+#include <complex>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+namespace rtff {
+
+/**
+ * @brief Project spectral frames onto a bank of bands, such as mel or
+ * constant-Q bands.
+ * Each band weights a contiguous range of bins, so only the non zero weights
+ * are stored and applied: a mel filterbank typically keeps a few percent of
+ * the dense band x bin matrix. Channels are projected in groups that share
+ * each band weights while they are in cache.
+ * @note the projections don't allocate and can run in
+ * ProcessTransformedBlock, but they use scratch buffers of the filterbank, so
+ * a filterbank must not be used by several threads at once
+ */
+class Filterbank {
+ public:
+  Filterbank();
+  ~Filterbank();
+
+  /**
+   * @brief Initialize triangular bands evenly spaced on the mel scale
+   * @note bands have a peak weight of 1. A band narrower than a bin takes the
+   * nearest bin
+   * @param fft_size: the fft size of the projected frames, which have
+   * fft_size / 2 + 1 bins
+   * @param sample_rate: the sample rate in Hz
+   * @param band_count: the number of bands
+   * @param min_frequency: the lower edge of the first band in Hz
+   * @param max_frequency: the upper edge of the last band in Hz, up to half
+   * the sample rate
+   * @param err: an error code that gets set if something goes wrong
+   */
+  void InitMel(uint32_t fft_size, float sample_rate, uint32_t band_count,
+               float min_frequency, float max_frequency,
+               std::error_code& err);
+
+  /**
+   * @brief Initialize triangular bands with a constant quality factor: their
+   * centers are geometrically spaced and each band spans from the center of
+   * the previous one to the center of the next one
+   * @note bands have a peak weight of 1. A band narrower than a bin takes the
+   * nearest bin
+   * @param fft_size: the fft size of the projected frames
+   * @param sample_rate: the sample rate in Hz
+   * @param min_frequency: the center of the first band in Hz
+   * @param bins_per_octave: the number of bands per octave
+   * @param band_count: the number of bands. The upper edge of the last band
+   * must not exceed half the sample rate
+   * @param err: an error code that gets set if something goes wrong
+   */
+  void InitConstantQ(uint32_t fft_size, float sample_rate, float min_frequency,
+                     uint32_t bins_per_octave, uint32_t band_count,
+                     std::error_code& err);
+
+  /**
+   * @brief Initialize any filterbank from its dense weights
+   * @note the weights of each band are kept from its first to its last non
+   * zero weight
+   * @param bin_count: the number of bins of the projected frames
+   * @param band_count: the number of bands
+   * @param weights: band_count rows of bin_count weights
+   * @param err: an error code that gets set if something goes wrong
+   */
+  void Init(uint32_t bin_count, uint32_t band_count, const float* weights,
+            std::error_code& err);
+
+  /**
+   * @brief project real frames, such as magnitude or power spectra
+   * @param bins: channel_count pointers to bin_count values
+   * @param channel_count: the number of channels
+   * @param bands: channel_count pointers to band_count values
+   */
+  void Project(const float* const* bins, uint32_t channel_count,
+               float* const* bands);
+  /**
+   * @brief project the magnitudes of complex frames, computed on the fly
+   * @param data: channel_count pointers to bin_count bins, as received by
+   * ProcessTransformedBlock
+   * @param channel_count: the number of channels
+   * @param bands: channel_count pointers to band_count values
+   * @param power: true to project the squared magnitudes
+   */
+  void ProjectMagnitudes(const std::complex<float>* const* data,
+                         uint32_t channel_count, float* const* bands,
+                         bool power = false);
+  /**
+   * @brief map band values back to the bins with the pseudo-inverse of the
+   * filterbank, for instance to apply a mask estimated on the bands
+   * @note the result is the minimum norm set of bins whose projection is the
+   * closest to the band values. Bands too similar to be told apart in
+   * single precision, such as low constant-Q bands sharing the same bins, are
+   * solved together. It may overshoot between bands, so masks should be
+   * clamped. Bins outside every band are set to zero
+   * @param bands: channel_count pointers to band_count values
+   * @param channel_count: the number of channels
+   * @param bins: channel_count pointers to bin_count values
+   */
+  void Unproject(const float* const* bands, uint32_t channel_count,
+                 float* const* bins);
+
+  /**
+   * @return the number of bins of the projected frames
+   */
+  uint32_t bin_count() const;
+  /**
+   * @return the number of bands
+   */
+  uint32_t band_count() const;
+  /**
+   * @param band_idx: the band index
+   * @return the first bin weighted by a band
+   */
+  uint32_t band_start(uint32_t band_idx) const;
+  /**
+   * @param band_idx: the band index
+   * @return the number of bins weighted by a band
+   */
+  uint32_t band_size(uint32_t band_idx) const;
+  /**
+   * @param band_idx: the band index
+   * @return the band_size weights of a band
+   */
+  const float* band_weights(uint32_t band_idx) const;
+
+ private:
+  /**
+   * @brief initialize triangular bands
+   * @param edges: band_count + 2 increasing frequencies. Band k rises from
+   * edge k to edge k + 1 and falls to edge k + 2
+   */
+  void InitTriangular(uint32_t fft_size, float sample_rate,
+                      const std::vector<float>& edges);
+  /**
+   * @brief precompute the pseudo-inverse and the scratch buffers once the
+   * bands are set
+   */
+  void Prepare();
+
+  uint32_t bin_count_;
+  uint32_t band_count_;
+
+  class Impl;
+  std::shared_ptr<Impl> impl_;
+};
+
+}  // namespace rtff
+
+#endif  // RTFF_FILTERBANK_H_
@@ -0,0 +1,200 @@
+#include "rtff/frame_history.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace rtff {
+
+FrameHistory::FrameHistory()
+    : capacity_(0),
+      bin_count_(0),
+      channel_count_(0),
+      storage_(Storage::Complex),
+      head_(0),
+      size_(0) {}
+
+void FrameHistory::Init(uint32_t frame_count, uint32_t max_bin_count,
+                        uint32_t channel_count, Storage storage) {
+  capacity_ = frame_count;
+  channel_count_ = channel_count;
+  storage_ = storage;
+  // each frame is stored twice
+  data_.assign(static_cast<std::size_t>(BinSize()) * max_bin_count * 2 *
+                   frame_count * channel_count,
+               0);
+  Reset(max_bin_count);
+}
+
+void FrameHistory::Reset(uint32_t bin_count) {
+  assert(static_cast<std::size_t>(BinSize()) * bin_count * 2 * capacity_ *
+             channel_count_ <=
+         data_.size());
+  bin_count_ = bin_count;
+  head_ = 0;
+  size_ = 0;
+}
+
+void FrameHistory::Push(const std::complex<float>* const* data) {
+  if (capacity_ == 0) {
+    return;
+  }
+  for (uint32_t channel_idx = 0; channel_idx < channel_count_;
+       channel_idx++) {
+    auto input = data[channel_idx];
+    auto slot = Slot(channel_idx, head_);
+    switch (storage_) {
+      case Storage::Complex:
+        std::copy(input, input + bin_count_,
+                  reinterpret_cast<std::complex<float>*>(slot));
+        break;
+      case Storage::Magnitude: {
+        auto output = reinterpret_cast<float*>(slot);
+        for (uint32_t bin_idx = 0; bin_idx < bin_count_; bin_idx++) {
+          output[bin_idx] = std::abs(input[bin_idx]);
+        }
+        break;
+      }
+      case Storage::Half: {
+        auto output = reinterpret_cast<uint16_t*>(slot);
+        for (uint32_t bin_idx = 0; bin_idx < bin_count_; bin_idx++) {
+          output[2 * bin_idx] = FloatToHalf(input[bin_idx].real());
+          output[2 * bin_idx + 1] = FloatToHalf(input[bin_idx].imag());
+        }
+        break;
+      }
+    }
+    // the copy one history length later keeps the frames contiguous
+    std::memcpy(Slot(channel_idx, head_ + capacity_), slot,
+                BinSize() * bin_count_);
+  }
+  head_ = (head_ + 1) % capacity_;
+  size_ = std::min(size_ + 1, capacity_);
+}
+
+uint32_t FrameHistory::size() const { return size_; }
+uint32_t FrameHistory::capacity() const { return capacity_; }
+uint32_t FrameHistory::bin_count() const { return bin_count_; }
+uint32_t FrameHistory::channel_count() const { return channel_count_; }
+FrameHistory::Storage FrameHistory::storage() const { return storage_; }
+
+const std::complex<float>* FrameHistory::frames(uint32_t channel_idx) const {
+  assert(storage_ == Storage::Complex);
+  return reinterpret_cast<const std::complex<float>*>(Oldest(channel_idx));
+}
+const float* FrameHistory::magnitudes(uint32_t channel_idx) const {
+  assert(storage_ == Storage::Magnitude);
+  return reinterpret_cast<const float*>(Oldest(channel_idx));
+}
+const uint16_t* FrameHistory::half_frames(uint32_t channel_idx) const {
+  assert(storage_ == Storage::Half);
+  return reinterpret_cast<const uint16_t*>(Oldest(channel_idx));
+}
+
+void FrameHistory::ReadFrame(uint32_t age, uint32_t channel_idx,
+                             std::complex<float>* result) const {
+  assert(age < size_ && storage_ != Storage::Magnitude);
+  auto frame_idx = static_cast<std::size_t>(size_ - 1 - age) * bin_count_;
+  if (storage_ == Storage::Complex) {
+    auto frame = frames(channel_idx) + frame_idx;
+    std::copy(frame, frame + bin_count_, result);
+    return;
+  }
+  auto frame = half_frames(channel_idx) + 2 * frame_idx;
+  for (uint32_t bin_idx = 0; bin_idx < bin_count_; bin_idx++) {
+    result[bin_idx] = std::complex<float>(HalfToFloat(frame[2 * bin_idx]),
+                                          HalfToFloat(frame[2 * bin_idx + 1]));
+  }
+}
+
+uint16_t FrameHistory::FloatToHalf(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  uint16_t sign = (bits >> 16) & 0x8000;
+  int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xff) - 127 + 15;
+  uint32_t mantissa = bits & 0x7fffff;
+
+  if (((bits >> 23) & 0xff) == 0xff) {
+    // infinity and nan
+    return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+  }
+  if (exponent >= 31) {
+    // too large, saturate to infinity
+    return sign | 0x7c00;
+  }
+  if (exponent <= 0) {
+    if (exponent < -10) {
+      // too small, even for a subnormal half
+      return sign;
+    }
+    // subnormal half: shift the mantissa with its implicit leading one
+    mantissa |= 0x800000;
+    auto shift = static_cast<uint32_t>(14 - exponent);
+    uint32_t half_mantissa = mantissa >> shift;
+    auto remainder = mantissa & ((1u << shift) - 1);
+    auto halfway = 1u << (shift - 1);
+    if (remainder > halfway ||
+        (remainder == halfway && (half_mantissa & 1))) {
+      half_mantissa++;
+    }
+    return sign | static_cast<uint16_t>(half_mantissa);
+  }
+  uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+  auto remainder = mantissa & 0x1fff;
+  if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+    // a carry into the exponent gives the next power of two, or infinity
+    half++;
+  }
+  return sign | static_cast<uint16_t>(half);
+}
+
+float FrameHistory::HalfToFloat(uint16_t value) {
+  uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+  uint32_t exponent = (value >> 10) & 0x1f;
+  uint32_t mantissa = value & 0x3ff;
+  uint32_t bits;
+  if (exponent == 0x1f) {
+    // infinity and nan
+    bits = sign | 0x7f800000 | (mantissa << 13);
+  } else if (exponent != 0) {
+    bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+  } else if (mantissa == 0) {
+    bits = sign;
+  } else {
+    // subnormal half, a normal float
+    return (sign ? -1.f : 1.f) * std::ldexp(static_cast<float>(mantissa), -24);
+  }
+  float result;
+  std::memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+uint32_t FrameHistory::BinSize() const {
+  switch (storage_) {
+    case Storage::Complex:
+      return sizeof(std::complex<float>);
+    case Storage::Magnitude:
+      return sizeof(float);
+    case Storage::Half:
+      return 2 * sizeof(uint16_t);
+  }
+  return 0;
+}
+
+uint8_t* FrameHistory::Slot(uint32_t channel_idx, uint32_t slot_idx) {
+  auto frame_size = static_cast<std::size_t>(BinSize()) * bin_count_;
+  return data_.data() +
+         frame_size * (2 * static_cast<std::size_t>(capacity_) * channel_idx +
+                       slot_idx);
+}
+
+const uint8_t* FrameHistory::Oldest(uint32_t channel_idx) const {
+  auto frame_size = static_cast<std::size_t>(BinSize()) * bin_count_;
+  auto oldest_slot = (head_ + capacity_ - size_) % std::max(capacity_, 1u);
+  return data_.data() +
+         frame_size * (2 * static_cast<std::size_t>(capacity_) * channel_idx +
+                       oldest_slot);
+}
+
+}  // namespace rtff
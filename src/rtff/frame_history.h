@@ -0,0 +1,138 @@
+#ifndef RTFF_FRAME_HISTORY_H_
+#define RTFF_FRAME_HISTORY_H_
+
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+#include "rtff/buffer/aligned_allocator.h"
+
+namespace rtff {
+
+/**
+ * @brief A circular history of the last analyzed spectral frames.
+ * Every frame is written twice, at its slot and one history length later, so
+ * the frames of a channel can always be read as one contiguous block ordered
+ * by time: a bin_count x size column major matrix whose last column is the
+ * newest frame. A row of that matrix is the recent history of a bin.
+ * @note the storage is allocated by Init. Push and Reset don't allocate
+ */
+class FrameHistory {
+ public:
+  /**
+   * @brief how the frames are stored
+   */
+  enum class Storage : uint8_t {
+    /** the complex spectrum, as analyzed */
+    Complex,
+    /** the magnitude of each bin, as floats */
+    Magnitude,
+    /** the complex spectrum as half precision floats: the real and the
+       imaginary parts of each bin are two consecutive uint16_t */
+    Half
+  };
+
+  FrameHistory();
+
+  /**
+   * @brief allocate the history
+   * @param frame_count: the number of frames kept. 0 disables the history
+   * @param max_bin_count: the largest number of bins of a frame
+   * @param channel_count: the number of channels of a frame
+   * @param storage: how the frames are stored
+   */
+  void Init(uint32_t frame_count, uint32_t max_bin_count,
+            uint32_t channel_count, Storage storage);
+
+  /**
+   * @brief forget every frame and change the number of bins of a frame
+   * @param bin_count: the number of bins, up to the max bin count given to
+   * Init
+   */
+  void Reset(uint32_t bin_count);
+
+  /**
+   * @brief add a frame, which replaces the oldest one once the history is
+   * full. Nothing is stored when the history is disabled
+   * @param data: one pointer per channel to bin_count bins
+   */
+  void Push(const std::complex<float>* const* data);
+
+  /**
+   * @return the number of frames available, up to capacity
+   */
+  uint32_t size() const;
+  /**
+   * @return the number of frames kept, 0 when the history is disabled
+   */
+  uint32_t capacity() const;
+  /**
+   * @return the number of bins of a frame
+   */
+  uint32_t bin_count() const;
+  /**
+   * @return the number of channels of a frame
+   */
+  uint32_t channel_count() const;
+  /**
+   * @return how the frames are stored
+   */
+  Storage storage() const;
+
+  /**
+   * @brief the frames of a channel with the Complex storage
+   * @param channel_idx: the channel index
+   * @return size frames of bin_count bins, from the oldest to the newest.
+   * Frame t starts at t * bin_count
+   */
+  const std::complex<float>* frames(uint32_t channel_idx) const;
+  /**
+   * @brief the frames of a channel with the Magnitude storage
+   * @see frames
+   */
+  const float* magnitudes(uint32_t channel_idx) const;
+  /**
+   * @brief the frames of a channel with the Half storage, two values per bin
+   * @see frames
+   */
+  const uint16_t* half_frames(uint32_t channel_idx) const;
+
+  /**
+   * @brief decode a frame of the Complex or Half storage
+   * @param age: 0 for the newest frame, size - 1 for the oldest one
+   * @param channel_idx: the channel index
+   * @param result: bin_count bins
+   */
+  void ReadFrame(uint32_t age, uint32_t channel_idx,
+                 std::complex<float>* result) const;
+
+  /**
+   * @brief convert a float to half precision, rounding to nearest even
+   */
+  static uint16_t FloatToHalf(float value);
+  /**
+   * @brief convert a half precision float to a float
+   */
+  static float HalfToFloat(uint16_t value);
+
+ private:
+  // the size in bytes of a bin
+  uint32_t BinSize() const;
+  // the first stored byte of a frame slot of a channel
+  uint8_t* Slot(uint32_t channel_idx, uint32_t slot_idx);
+  // the first byte of the oldest frame of a channel
+  const uint8_t* Oldest(uint32_t channel_idx) const;
+
+  uint32_t capacity_;
+  uint32_t bin_count_;
+  uint32_t channel_count_;
+  Storage storage_;
+  // the slot the next frame is written to
+  uint32_t head_;
+  uint32_t size_;
+  std::vector<uint8_t, AlignedAllocator<uint8_t>> data_;
+};
+
+}  // namespace rtff
+
+#endif  // RTFF_FRAME_HISTORY_H_
@@ -0,0 +1,24 @@
+#ifndef RTFF_INSTRUMENTATION_COUNTER_H_
+#define RTFF_INSTRUMENTATION_COUNTER_H_
+
+#include <atomic>
+#include <cstdint>
+
+namespace rtff {
+
+/**
+ * @brief add a value to a counter updated by a single thread and read by any
+ * other one
+ * @note with a single writer, a relaxed load and store is enough: it stays
+ * cheap and lock free, without a read-modify-write atomic operation
+ * @param counter: the counter
+ * @param value: the value to add
+ */
+inline void AddSingleWriter(std::atomic<uint64_t>* counter, uint64_t value) {
+  counter->store(counter->load(std::memory_order_relaxed) + value,
+                 std::memory_order_relaxed);
+}
+
+}  // namespace rtff
+
+#endif  // RTFF_INSTRUMENTATION_COUNTER_H_
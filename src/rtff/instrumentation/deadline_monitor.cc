@@ -0,0 +1,110 @@
+#include "rtff/instrumentation/deadline_monitor.h"
+
+#include <algorithm>
+
+#include "rtff/instrumentation/counter.h"
+#include "rtff/instrumentation/tracer.h"
+
+namespace rtff {
+
+const uint8_t DeadlineMonitor::kBinCount;
+constexpr float DeadlineMonitor::kBinWidth;
+
+DeadlineMonitor::DeadlineMonitor() : sample_rate_(0) { Reset(); }
+
+DeadlineMonitor::DeadlineMonitor(const DeadlineMonitor& other)
+    : sample_rate_(0) {
+  *this = other;
+}
+
+DeadlineMonitor& DeadlineMonitor::operator=(const DeadlineMonitor& other) {
+  auto values = other.values();
+  sample_rate_.store(other.sample_rate());
+  for (auto bin_idx = 0; bin_idx < kBinCount; bin_idx++) {
+    histogram_[bin_idx].store(values.histogram[bin_idx]);
+  }
+  block_count_.store(values.block_count);
+  miss_count_.store(values.miss_count);
+  worst_sequence_.store(0);
+  worst_load_.store(values.worst.load);
+  worst_frame_count_.store(values.worst.frame_count);
+  worst_hop_count_.store(values.worst.hop_count);
+  return *this;
+}
+
+void DeadlineMonitor::set_sample_rate(double value) {
+  sample_rate_.store(value);
+}
+double DeadlineMonitor::sample_rate() const { return sample_rate_.load(); }
+
+uint64_t DeadlineMonitor::Start() const {
+  if (sample_rate_.load(std::memory_order_relaxed) <= 0) {
+    return 0;
+  }
+  return Tracer::Now();
+}
+
+void DeadlineMonitor::Stop(uint64_t start, uint32_t frame_count,
+                           uint32_t hop_count) {
+  auto sample_rate = sample_rate_.load(std::memory_order_relaxed);
+  if (sample_rate <= 0 || start == 0 || frame_count == 0) {
+    return;
+  }
+  auto now = Tracer::Now();
+  auto budget = frame_count * 1e9 / sample_rate;
+  auto load = static_cast<float>((now - start) / budget);
+
+  auto bin_idx = std::min<uint32_t>(static_cast<uint32_t>(load / kBinWidth),
+                                    kBinCount - 1);
+  AddSingleWriter(&histogram_[bin_idx], 1);
+  AddSingleWriter(&block_count_, 1);
+  if (load > 1) {
+    AddSingleWriter(&miss_count_, 1);
+  }
+  if (load > worst_load_.load(std::memory_order_relaxed)) {
+    auto sequence = worst_sequence_.load(std::memory_order_relaxed);
+    worst_sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    worst_load_.store(load, std::memory_order_relaxed);
+    worst_frame_count_.store(frame_count, std::memory_order_relaxed);
+    worst_hop_count_.store(hop_count, std::memory_order_relaxed);
+    worst_sequence_.store(sequence + 2, std::memory_order_release);
+  }
+}
+
+DeadlineMonitor::Values DeadlineMonitor::values() const {
+  Values values;
+  for (auto bin_idx = 0; bin_idx < kBinCount; bin_idx++) {
+    values.histogram[bin_idx] =
+        histogram_[bin_idx].load(std::memory_order_relaxed);
+  }
+  values.block_count = block_count_.load(std::memory_order_relaxed);
+  values.miss_count = miss_count_.load(std::memory_order_relaxed);
+
+  // retry until the worst block wasn't modified while being read
+  uint32_t sequence;
+  do {
+    sequence = worst_sequence_.load(std::memory_order_acquire);
+    values.worst.load = worst_load_.load(std::memory_order_relaxed);
+    values.worst.frame_count =
+        worst_frame_count_.load(std::memory_order_relaxed);
+    values.worst.hop_count = worst_hop_count_.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while ((sequence & 1) ||
+           sequence != worst_sequence_.load(std::memory_order_relaxed));
+  return values;
+}
+
+void DeadlineMonitor::Reset() {
+  for (auto& bin : histogram_) {
+    bin.store(0);
+  }
+  block_count_.store(0);
+  miss_count_.store(0);
+  worst_sequence_.store(0);
+  worst_load_.store(0);
+  worst_frame_count_.store(0);
+  worst_hop_count_.store(0);
+}
+
+}  // namespace rtff
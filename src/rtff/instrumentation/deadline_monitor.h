@@ -0,0 +1,101 @@
+#ifndef RTFF_INSTRUMENTATION_DEADLINE_MONITOR_H_
+#define RTFF_INSTRUMENTATION_DEADLINE_MONITOR_H_
+
+#include <atomic>
+#include <cstdint>
+
+namespace rtff {
+
+/**
+ * @brief Measure how much of the real time budget each processed block uses.
+ * The budget of a block is its duration at the monitored sample rate. The
+ * monitor keeps a histogram of the load (processing time / budget), counts
+ * deadline misses (load > 1) and keeps the worst block.
+ * @note a single real time thread records the blocks while any other thread
+ * can read the values. Recording doesn't lock nor allocate.
+ */
+class DeadlineMonitor {
+ public:
+  /** number of histogram bins */
+  static const uint8_t kBinCount = 20;
+  /** load range covered by a bin. The last bin holds every larger load */
+  static constexpr float kBinWidth = 0.1f;
+
+  /**
+   * @brief the block that took the largest part of its budget
+   */
+  struct Worst {
+    /** processing time / budget */
+    float load;
+    /** the number of frames of the block */
+    uint32_t frame_count;
+    /** the number of stft hops processed during the block */
+    uint32_t hop_count;
+  };
+
+  /**
+   * @brief a copy of the monitor values
+   */
+  struct Values {
+    /** number of blocks per load bin */
+    uint64_t histogram[kBinCount];
+    /** number of recorded blocks */
+    uint64_t block_count;
+    /** number of blocks that took longer than their budget */
+    uint64_t miss_count;
+    /** the worst block */
+    Worst worst;
+  };
+
+  DeadlineMonitor();
+  DeadlineMonitor(const DeadlineMonitor& other);
+  DeadlineMonitor& operator=(const DeadlineMonitor& other);
+
+  /**
+   * @brief enable the monitor. Disabled by default
+   * @param value: the sample rate of the processed signal. 0 disables the
+   * monitor
+   */
+  void set_sample_rate(double value);
+  /**
+   * @return the monitored sample rate, 0 when disabled
+   */
+  double sample_rate() const;
+
+  /**
+   * @return the start time of a block, to be given to Stop
+   */
+  uint64_t Start() const;
+  /**
+   * @brief record a processed block
+   * @param start: the value returned by Start
+   * @param frame_count: the number of frames of the block
+   * @param hop_count: the number of stft hops processed during the block
+   */
+  void Stop(uint64_t start, uint32_t frame_count, uint32_t hop_count);
+
+  /**
+   * @return the current values. It can be called from any thread
+   */
+  Values values() const;
+  /**
+   * @brief clear the histogram, the counters and the worst block
+   * @note it must not be called while the filter is processing
+   */
+  void Reset();
+
+ private:
+  std::atomic<double> sample_rate_;
+  std::atomic<uint64_t> histogram_[kBinCount];
+  std::atomic<uint64_t> block_count_;
+  std::atomic<uint64_t> miss_count_;
+  // the worst block is written under a sequence lock: odd while writing
+  std::atomic<uint32_t> worst_sequence_;
+  std::atomic<float> worst_load_;
+  std::atomic<uint32_t> worst_frame_count_;
+  std::atomic<uint32_t> worst_hop_count_;
+};
+
+}  // namespace rtff
+
+#endif  // RTFF_INSTRUMENTATION_DEADLINE_MONITOR_H_
@@ -0,0 +1,42 @@
+#include "rtff/instrumentation/stage_counters.h"
+
+namespace rtff {
+
+StageCounters::StageCounters() { Reset(); }
+
+StageCounters::StageCounters(const StageCounters& other) { *this = other; }
+
+StageCounters& StageCounters::operator=(const StageCounters& other) {
+  auto values = other.values();
+  for (auto stage_idx = 0; stage_idx < kStageCount; stage_idx++) {
+    stage_nanoseconds_[stage_idx].store(values.stage_nanoseconds[stage_idx],
+                                        std::memory_order_relaxed);
+  }
+  block_count_.store(values.block_count, std::memory_order_relaxed);
+  hop_count_.store(values.hop_count, std::memory_order_relaxed);
+  copied_bytes_.store(values.copied_bytes, std::memory_order_relaxed);
+  return *this;
+}
+
+StageCounters::Values StageCounters::values() const {
+  Values values;
+  for (auto stage_idx = 0; stage_idx < kStageCount; stage_idx++) {
+    values.stage_nanoseconds[stage_idx] =
+        stage_nanoseconds_[stage_idx].load(std::memory_order_relaxed);
+  }
+  values.block_count = block_count_.load(std::memory_order_relaxed);
+  values.hop_count = hop_count_.load(std::memory_order_relaxed);
+  values.copied_bytes = copied_bytes_.load(std::memory_order_relaxed);
+  return values;
+}
+
+void StageCounters::Reset() {
+  for (auto& counter : stage_nanoseconds_) {
+    counter.store(0, std::memory_order_relaxed);
+  }
+  block_count_.store(0, std::memory_order_relaxed);
+  hop_count_.store(0, std::memory_order_relaxed);
+  copied_bytes_.store(0, std::memory_order_relaxed);
+}
+
+}  // namespace rtff
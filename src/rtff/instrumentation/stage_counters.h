@@ -0,0 +1,127 @@
+#ifndef RTFF_INSTRUMENTATION_STAGE_COUNTERS_H_
+#define RTFF_INSTRUMENTATION_STAGE_COUNTERS_H_
+
+#include <atomic>
+#include <cstdint>
+
+#include "rtff/instrumentation/counter.h"
+
+namespace rtff {
+
+/**
+ * @brief Per stage time, hop and copy counters of a filter.
+ * Counters are only updated when the library is compiled with
+ * RTFF_ENABLE_INSTRUMENTATION (rtff_enable_instrumentation cmake option).
+ * Otherwise every update is an empty inline function.
+ * @note a single real time thread updates the counters while any other thread
+ * can read them. Updates don't use read-modify-write atomic operations, so
+ * they stay cheap and lock free.
+ */
+class StageCounters {
+ public:
+  /**
+   * @brief the stages of a ProcessBlock call
+   */
+  enum class Stage : uint8_t {
+    /** write of the input block and read of the frames in the input ring */
+    InputCopy,
+    /** analysis window and forward transforms */
+    Analyze,
+    /** the user ProcessTransformedBlock function */
+    Process,
+    /** backward transforms and overlap-add */
+    Synthesize,
+    /** write of the frames and read of the output block in the output ring */
+    OutputCopy,
+    /** number of stages */
+    Count
+  };
+  static const uint8_t kStageCount = static_cast<uint8_t>(Stage::Count);
+
+  /**
+   * @brief a copy of the counters values
+   */
+  struct Values {
+    /** time spent in each stage, in nanoseconds */
+    uint64_t stage_nanoseconds[kStageCount];
+    /** number of processed blocks */
+    uint64_t block_count;
+    /** number of processed frames */
+    uint64_t hop_count;
+    /** number of bytes copied in and out of the ring buffers */
+    uint64_t copied_bytes;
+  };
+
+  StageCounters();
+  StageCounters(const StageCounters& other);
+  StageCounters& operator=(const StageCounters& other);
+
+  /**
+   * @return true if the library has been compiled with the instrumentation
+   */
+  static constexpr bool enabled() {
+#ifdef RTFF_ENABLE_INSTRUMENTATION
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  /**
+   * @brief add a duration to a stage
+   * @param stage: the stage
+   * @param nanoseconds: the duration
+   */
+  void Add(Stage stage, uint64_t nanoseconds) {
+#ifdef RTFF_ENABLE_INSTRUMENTATION
+    AddSingleWriter(&stage_nanoseconds_[static_cast<uint8_t>(stage)],
+                    nanoseconds);
+#endif
+  }
+  /**
+   * @brief count a processed block
+   */
+  void AddBlock() {
+#ifdef RTFF_ENABLE_INSTRUMENTATION
+    AddSingleWriter(&block_count_, 1);
+#endif
+  }
+  /**
+   * @brief count a processed frame
+   */
+  void AddHop() {
+#ifdef RTFF_ENABLE_INSTRUMENTATION
+    AddSingleWriter(&hop_count_, 1);
+#endif
+  }
+  /**
+   * @brief count copied bytes
+   * @param byte_count: the number of bytes
+   */
+  void AddCopiedBytes(uint64_t byte_count) {
+#ifdef RTFF_ENABLE_INSTRUMENTATION
+    AddSingleWriter(&copied_bytes_, byte_count);
+#endif
+  }
+
+  /**
+   * @return the current values. It can be called from any thread
+   * @note each counter is read atomically but they are not read all at once
+   */
+  Values values() const;
+  /**
+   * @brief set every counter to 0
+   * @note it must not be called while the filter is processing
+   */
+  void Reset();
+
+ private:
+  std::atomic<uint64_t> stage_nanoseconds_[kStageCount];
+  std::atomic<uint64_t> block_count_;
+  std::atomic<uint64_t> hop_count_;
+  std::atomic<uint64_t> copied_bytes_;
+};
+
+}  // namespace rtff
+
+#endif  // RTFF_INSTRUMENTATION_STAGE_COUNTERS_H_
@@ -0,0 +1,132 @@
+#include "rtff/instrumentation/tracer.h"
+
+#include <chrono>
+#include <iomanip>
+
+namespace rtff {
+
+namespace {
+
+uint32_t NextPowerOfTwo(uint32_t value) {
+  // the queue needs at least two slots to tell a full slot from an empty one
+  uint32_t result = 2;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+}  // namespace
+
+Tracer::Tracer(uint32_t capacity)
+    : events_(NextPowerOfTwo(capacity)),
+      mask_(events_.size() - 1),
+      enqueue_position_(0),
+      dequeue_position_(0),
+      dropped_count_(0),
+      origin_(Now()),
+      first_event_(true) {
+  for (auto event_idx = 0; event_idx < events_.size(); event_idx++) {
+    events_[event_idx].sequence.store(event_idx, std::memory_order_relaxed);
+  }
+}
+
+Tracer::~Tracer() { Stop(); }
+
+void Tracer::Start(const std::string& path, std::error_code& err) {
+  Stop();
+  file_.open(path, std::ios::out | std::ios::trunc);
+  if (!file_.is_open()) {
+    err = std::make_error_code(std::errc::io_error);
+    return;
+  }
+  file_ << std::fixed << std::setprecision(3);
+  file_ << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  first_event_ = true;
+  drain_thread_.Start([this] { Drain(); });
+}
+
+void Tracer::Stop() {
+  if (!drain_thread_.running()) {
+    return;
+  }
+  drain_thread_.Stop();
+  file_ << "\n]}\n";
+  file_.close();
+}
+
+uint64_t Tracer::Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void Tracer::Record(const char* name, uint64_t start, uint64_t end,
+                    uint32_t frame_count, uint32_t hop_count) {
+  // bounded multi producer queue: claim a slot whose sequence matches the
+  // position, then publish it by moving its sequence forward
+  auto position = enqueue_position_.load(std::memory_order_relaxed);
+  Event* event;
+  while (true) {
+    event = &events_[position & mask_];
+    auto sequence = event->sequence.load(std::memory_order_acquire);
+    auto difference =
+        static_cast<int64_t>(sequence) - static_cast<int64_t>(position);
+    if (difference == 0) {
+      if (enqueue_position_.compare_exchange_weak(position, position + 1,
+                                                  std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (difference < 0) {
+      // the queue is full
+      dropped_count_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    } else {
+      position = enqueue_position_.load(std::memory_order_relaxed);
+    }
+  }
+  event->name = name;
+  event->start = start;
+  event->end = end;
+  event->thread_id = ThreadId();
+  event->frame_count = frame_count;
+  event->hop_count = hop_count;
+  event->sequence.store(position + 1, std::memory_order_release);
+}
+
+uint64_t Tracer::dropped_count() const {
+  return dropped_count_.load(std::memory_order_relaxed);
+}
+
+uint32_t Tracer::ThreadId() {
+  static std::atomic<uint32_t> next_id(1);
+  thread_local uint32_t id = next_id.fetch_add(1);
+  return id;
+}
+
+void Tracer::Drain() {
+  while (true) {
+    auto& event = events_[dequeue_position_ & mask_];
+    auto sequence = event.sequence.load(std::memory_order_acquire);
+    if (sequence != dequeue_position_ + 1) {
+      // not published yet
+      return;
+    }
+    // complete events, timestamps in microseconds
+    file_ << (first_event_ ? "\n" : ",\n") << "{\"name\":\"" << event.name
+          << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread_id
+          << ",\"ts\":" << (event.start - origin_) / 1000.
+          << ",\"dur\":" << (event.end - event.start) / 1000.;
+    if (event.frame_count || event.hop_count) {
+      file_ << ",\"args\":{\"frames\":" << event.frame_count
+            << ",\"hops\":" << event.hop_count << "}";
+    }
+    file_ << "}";
+    first_event_ = false;
+    event.sequence.store(dequeue_position_ + events_.size(),
+                         std::memory_order_release);
+    dequeue_position_++;
+  }
+}
+
+}  // namespace rtff
@@ -0,0 +1,95 @@
+#ifndef RTFF_INSTRUMENTATION_TRACER_H_
+#define RTFF_INSTRUMENTATION_TRACER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "rtff/drain_thread.h"
+
+namespace rtff {
+
+/**
+ * @brief Write timed spans as a Chrome trace event JSON file, readable by
+ * chrome://tracing and Perfetto.
+ * Spans are pushed into a preallocated lock free queue from any number of
+ * real time threads. A background thread drains the queue into the file.
+ * When the queue is full, new spans are dropped and counted.
+ */
+class Tracer {
+ public:
+  /**
+   * @brief Constructor
+   * @param capacity: the number of spans the queue can hold. It is rounded up
+   * to a power of two, at least 2
+   */
+  explicit Tracer(uint32_t capacity = 1 << 16);
+  ~Tracer();
+
+  /**
+   * @brief open the trace file and start the background writer
+   * @param path: the path of the JSON file
+   * @param err: an error code that gets set if the file can't be opened
+   */
+  void Start(const std::string& path, std::error_code& err);
+  /**
+   * @brief stop the background writer, write the remaining spans and close
+   * the file. Called by the destructor
+   */
+  void Stop();
+
+  /**
+   * @return the current time in nanoseconds
+   */
+  static uint64_t Now();
+
+  /**
+   * @brief push a span. It doesn't lock nor allocate
+   * @param name: the name of the span. It must be a string literal, or
+   * outlive the tracer
+   * @param start: the start time, as returned by Now
+   * @param end: the end time, as returned by Now
+   * @param frame_count: optional number of frames, written in the span args
+   * @param hop_count: optional number of stft hops, written in the span args
+   */
+  void Record(const char* name, uint64_t start, uint64_t end,
+              uint32_t frame_count = 0, uint32_t hop_count = 0);
+
+  /**
+   * @return the number of spans dropped because the queue was full
+   */
+  uint64_t dropped_count() const;
+
+ private:
+  struct Event {
+    std::atomic<uint64_t> sequence;
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+    uint32_t thread_id;
+    uint32_t frame_count;
+    uint32_t hop_count;
+  };
+
+  static uint32_t ThreadId();
+  void Drain();
+
+  std::vector<Event> events_;
+  uint64_t mask_;
+  std::atomic<uint64_t> enqueue_position_;
+  uint64_t dequeue_position_;
+  std::atomic<uint64_t> dropped_count_;
+
+  uint64_t origin_;
+  bool first_event_;
+  std::ofstream file_;
+  DrainThread drain_thread_;
+};
+
+}  // namespace rtff
+
+#endif  // RTFF_INSTRUMENTATION_TRACER_H_
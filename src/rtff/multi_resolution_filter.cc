@@ -0,0 +1,210 @@
+#include "rtff/multi_resolution_filter.h"
+
+#include <algorithm>
+
+#include "rtff/buffer/buffer.h"
+#include "rtff/buffer/overlap_ring_buffer.h"
+#include "rtff/buffer/ring_buffer.h"
+#include "rtff/denormal.h"
+#include "rtff/filter_impl.h"
+
+namespace rtff {
+
+class MultiResolutionFilter::Impl {
+ public:
+  class Analysis {
+   public:
+    FilterImpl filter;
+    // number of steps between two frames
+    uint32_t period;
+    // position of the frame in the shared input frame
+    uint32_t offset;
+    TimeAmplitudeBuffer amplitude_block;
+    TimeFrequencyBuffer frequential_block;
+  };
+
+  // the largest frame, shared by every resolution
+  TimeAmplitudeBuffer input_block;
+  TimeAmplitudeBuffer output_amplitude_block;
+  std::vector<Analysis> analyses;
+};
+
+MultiResolutionFilter::MultiResolutionFilter()
+    : execute([](std::vector<Frame>&) {}),
+      synthesis_resolution_(-1),
+      step_size_(0),
+      block_size_(512),
+      channel_count_(0),
+      step_count_(0) {}
+
+MultiResolutionFilter::~MultiResolutionFilter() {}
+
+void MultiResolutionFilter::Init(uint32_t channel_count,
+                                 const std::vector<Resolution>& resolutions,
+                                 int32_t synthesis_resolution,
+                                 fft_window::Type windows_type,
+                                 std::error_code& err) {
+  if (resolutions.empty() ||
+      synthesis_resolution >= static_cast<int32_t>(resolutions.size())) {
+    err = std::make_error_code(std::errc::invalid_argument);
+    return;
+  }
+  auto step_size = std::min_element(resolutions.begin(), resolutions.end(),
+                                    [](const Resolution& lhs,
+                                       const Resolution& rhs) {
+                                      return lhs.hop_size < rhs.hop_size;
+                                    })->hop_size;
+  for (const auto& resolution : resolutions) {
+    // frames are centered on the same sample so the difference between two
+    // fft sizes has to be even
+    if (resolution.hop_size == 0 || resolution.hop_size > resolution.fft_size ||
+        resolution.hop_size % step_size != 0 ||
+        (resolution.fft_size - resolutions[0].fft_size) % 2 != 0) {
+      err = std::make_error_code(std::errc::invalid_argument);
+      return;
+    }
+  }
+
+  resolutions_ = resolutions;
+  synthesis_resolution_ = synthesis_resolution;
+  step_size_ = step_size;
+  channel_count_ = channel_count;
+
+  impl_ = std::make_shared<Impl>();
+  impl_->input_block.Init(max_fft_size(), channel_count);
+  impl_->analyses.resize(resolutions_.size());
+  frames_.resize(resolutions_.size());
+  for (auto resolution_idx = 0; resolution_idx < resolutions_.size();
+       resolution_idx++) {
+    const auto& resolution = resolutions_[resolution_idx];
+    auto& analysis = impl_->analyses[resolution_idx];
+    analysis.filter.Init(resolution.fft_size,
+                         resolution.fft_size - resolution.hop_size,
+                         windows_type, channel_count, err);
+    if (err) {
+      return;
+    }
+    analysis.period = resolution.hop_size / step_size_;
+    analysis.offset = (max_fft_size() - resolution.fft_size) / 2;
+    analysis.amplitude_block.Init(resolution.fft_size, channel_count);
+    analysis.frequential_block.Init(resolution.fft_size / 2 + 1,
+                                    channel_count);
+
+    frames_[resolution_idx].data = analysis.frequential_block.data_ptr();
+    frames_[resolution_idx].size = analysis.frequential_block.size();
+    frames_[resolution_idx].updated = false;
+  }
+  if (synthesis_resolution_ >= 0) {
+    impl_->output_amplitude_block.Init(
+        resolutions_[synthesis_resolution_].hop_size, channel_count);
+  }
+  InitBuffers();
+}
+
+void MultiResolutionFilter::InitBuffers() {
+  // a single history, large enough for the biggest fft, feeds every resolution
+  input_buffer_ = std::make_shared<MultichannelOverlapRingBuffer>(
+      max_fft_size(), step_size(), channel_count());
+  step_count_ = 0;
+
+  if (synthesis_resolution_ < 0) {
+    output_buffer_.reset();
+    return;
+  }
+  // Frames are produced by bursts of hop size. Priming the output with
+  // max_fft_size - 1 zeros guarantees we can always read a block, whatever
+  // the block size is
+  auto hop_size = resolutions_[synthesis_resolution_].hop_size;
+  output_buffer_ = std::make_shared<MultichannelRingBuffer>(
+      (max_fft_size() + hop_size + block_size()) * 2, channel_count());
+  output_buffer_->InitWithZeros(max_fft_size() - 1);
+}
+
+void MultiResolutionFilter::set_block_size(uint32_t value) {
+  block_size_ = value;
+  // the buffers are created by Init
+  if (resolutions_.empty()) {
+    return;
+  }
+  InitBuffers();
+}
+
+uint32_t MultiResolutionFilter::FrameLatency() const {
+  if (synthesis_resolution_ < 0) {
+    return 0;
+  }
+  // the output priming plus the synthesis frame offset in the shared frame
+  return (max_fft_size() + resolutions_[synthesis_resolution_].fft_size) / 2 -
+         1;
+}
+
+const std::vector<MultiResolutionFilter::Resolution>&
+MultiResolutionFilter::resolutions() const {
+  return resolutions_;
+}
+uint32_t MultiResolutionFilter::step_size() const { return step_size_; }
+uint32_t MultiResolutionFilter::block_size() const { return block_size_; }
+uint32_t MultiResolutionFilter::channel_count() const { return channel_count_; }
+
+uint32_t MultiResolutionFilter::max_fft_size() const {
+  return std::max_element(resolutions_.begin(), resolutions_.end(),
+                          [](const Resolution& lhs, const Resolution& rhs) {
+                            return lhs.fft_size < rhs.fft_size;
+                          })->fft_size;
+}
+
+void MultiResolutionFilter::ProcessBlock(AudioBuffer* buffer) {
+  ScopedDenormalFlush denormal_flush;
+  auto frame_count = buffer->frame_count();
+  input_buffer_->Write(*buffer, frame_count);
+
+  // process as many steps as possible
+  while (input_buffer_->Read(&(impl_->input_block))) {
+    for (auto resolution_idx = 0; resolution_idx < frames_.size();
+         resolution_idx++) {
+      auto& analysis = impl_->analyses[resolution_idx];
+      auto& frame = frames_[resolution_idx];
+      frame.updated = (step_count_ % analysis.period) == 0;
+      if (!frame.updated) {
+        continue;
+      }
+      auto fft_size = analysis.amplitude_block.size();
+      for (uint32_t channel_idx = 0; channel_idx < channel_count();
+           channel_idx++) {
+        analysis.amplitude_block.channel(channel_idx) =
+            impl_->input_block.channel(channel_idx)
+                .segment(analysis.offset, fft_size);
+      }
+      analysis.filter.Analyze(analysis.amplitude_block,
+                              &analysis.frequential_block);
+    }
+
+    ProcessTransformedFrames(frames_);
+
+    if (synthesis_resolution_ >= 0 && frames_[synthesis_resolution_].updated) {
+      auto& analysis = impl_->analyses[synthesis_resolution_];
+      analysis.filter.Synthesize(analysis.frequential_block,
+                                 &(impl_->output_amplitude_block));
+      output_buffer_->Write(impl_->output_amplitude_block,
+                            impl_->output_amplitude_block.size());
+    }
+    step_count_++;
+  }
+
+  if (synthesis_resolution_ < 0 || output_buffer_->Read(buffer, frame_count)) {
+    return;
+  }
+  // if we don't have enough data to be read, just fill with zeros
+  for (auto channel_idx = 0; channel_idx < buffer->channel_count();
+       channel_idx++) {
+    std::fill(buffer->data(channel_idx),
+              buffer->data(channel_idx) + frame_count, 0);
+  }
+}
+
+void MultiResolutionFilter::ProcessTransformedFrames(
+    std::vector<Frame>& frames) {
+  execute(frames);
+}
+
+}  // namespace rtff
@@ -0,0 +1,144 @@
+#ifndef RTFF_MULTI_RESOLUTION_FILTER_H_
+#define RTFF_MULTI_RESOLUTION_FILTER_H_
+
+#include <complex>
+#include <functional>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+#include "rtff/buffer/audio_buffer.h"
+
+#include "rtff/fft/window_type.h"
+
+namespace rtff {
+
+class MultichannelOverlapRingBuffer;
+class MultichannelRingBuffer;
+
+/**
+ * @brief Frequential filter analyzing the same signal with several fft sizes
+ * and hop sizes.
+ * All the resolutions read their frames from a single input history. Frames
+ * are centered on the same sample so that every resolution sees the same
+ * instant at a given step. Optionally, one of the resolutions is synthesized
+ * back to the time domain.
+ */
+class MultiResolutionFilter {
+ public:
+  /**
+   * @brief the stft parameters of a resolution
+   */
+  struct Resolution {
+    /** the length in samples of the fourier transform window */
+    uint32_t fft_size;
+    /** the number of samples between two frames */
+    uint32_t hop_size;
+  };
+
+  /**
+   * @brief the last time frequency frame of a resolution
+   */
+  struct Frame {
+    /** one pointer per channel to size complex values */
+    std::vector<std::complex<float>*> data;
+    /** the number of frequency bins of each channel */
+    uint32_t size;
+    /** true if the frame has been computed during the current step */
+    bool updated;
+  };
+
+  MultiResolutionFilter();
+  virtual ~MultiResolutionFilter();
+
+  /**
+   * @brief Initialize the filter
+   * @param channel_count: the number of channel of the input signal
+   * @param resolutions: the analysis resolutions. Each hop size must be a
+   * multiple of the smallest one and fft sizes must all be even or all be odd
+   * @param synthesis_resolution: the index of the resolution converted back
+   * into the output signal. A negative value disables the synthesis and
+   * ProcessBlock leaves its buffer untouched
+   * @param windows_type: type of analysis and synthesis window for FFT
+   * @param err: an error code that gets set if something goes wrong
+   */
+  void Init(uint32_t channel_count, const std::vector<Resolution>& resolutions,
+            int32_t synthesis_resolution, fft_window::Type windows_type,
+            std::error_code& err);
+
+  /**
+   * @brief define the block size
+   * @param value: the block size
+   * @see AbstractFilter::set_block_size
+   */
+  void set_block_size(uint32_t value);
+
+  /**
+   * @brief Process a buffer
+   * @note the buffer should have the same channel_count and its frame_number
+   * should be equal to the filter block_size
+   * @param buffer: the data
+   */
+  virtual void ProcessBlock(AudioBuffer* buffer);
+
+  /**
+   * @return The latency generated by the synthesis in frames. It doesn't
+   * depend on the block size.
+   */
+  uint32_t FrameLatency() const;
+
+  /**
+   * @return the analysis resolutions
+   */
+  const std::vector<Resolution>& resolutions() const;
+  /**
+   * @return the number of samples between two steps. It is the smallest hop
+   * size
+   */
+  uint32_t step_size() const;
+  /**
+   * @return the block size
+   */
+  uint32_t block_size() const;
+  /**
+   * @return the number of channel of the input signal
+   */
+  uint32_t channel_count() const;
+
+  /**
+   * @brief the function executed at each step, with one frame per resolution
+   * in the order given to Init.
+   * @note only frames flagged as updated contain a new analysis. Modifying the
+   * synthesis resolution frame modifies the output signal
+   */
+  std::function<void(std::vector<Frame>&)> execute;
+
+ protected:
+  /**
+   * @brief Process the frames of a step. Calls execute by default
+   * @param frames: one frame per resolution
+   */
+  virtual void ProcessTransformedFrames(std::vector<Frame>& frames);
+
+ private:
+  void InitBuffers();
+  uint32_t max_fft_size() const;
+
+  std::vector<Resolution> resolutions_;
+  int32_t synthesis_resolution_;
+  uint32_t step_size_;
+  uint32_t block_size_;
+  uint32_t channel_count_;
+  uint64_t step_count_;
+
+  std::shared_ptr<MultichannelOverlapRingBuffer> input_buffer_;
+  std::shared_ptr<MultichannelRingBuffer> output_buffer_;
+
+  class Impl;
+  std::shared_ptr<Impl> impl_;
+  std::vector<Frame> frames_;
+};
+
+}  // namespace rtff
+
+#endif  // RTFF_MULTI_RESOLUTION_FILTER_H_
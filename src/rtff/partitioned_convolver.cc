@@ -0,0 +1,296 @@
+#include "rtff/partitioned_convolver.h"
+
+#include <algorithm>
+#include <complex>
+
+#include <Eigen/Core>
+
+#include "rtff/buffer/buffer.h"
+#include "rtff/buffer/ring_buffer.h"
+#include "rtff/denormal.h"
+#include "rtff/fft/fft.h"
+
+namespace rtff {
+
+class PartitionedConvolver::ImpulseResponse {
+ public:
+  uint32_t input_count;
+  uint32_t output_count;
+  uint32_t partition_size;
+  // one matrix per output / input pair, one column per partition spectrum.
+  // Empty when the input doesn't contribute to the output
+  std::vector<Eigen::MatrixXcf> partitions;
+};
+
+class PartitionedConvolver::Impl {
+ public:
+  std::shared_ptr<Fft> fft;
+  std::shared_ptr<MultichannelRingBuffer> input_buffer;
+  std::shared_ptr<MultichannelRingBuffer> output_buffer;
+  TimeAmplitudeBuffer input_block;
+  TimeAmplitudeBuffer output_block;
+
+  // the last two partitions of each input, one column per channel
+  Eigen::MatrixXf input_frames;
+  // frequency domain delay line: one matrix per input, one column per
+  // partition spectrum, written circularly
+  std::vector<Eigen::MatrixXcf> delay_line;
+  uint32_t delay_line_position;
+  Eigen::VectorXcf accumulator;
+  Eigen::VectorXf output_frame;
+};
+
+PartitionedConvolver::PartitionedConvolver()
+    : input_count_(0),
+      output_count_(0),
+      partition_size_(0),
+      max_partition_count_(0),
+      block_size_(512),
+      pending_(nullptr),
+      active_(nullptr),
+      epoch_(0) {}
+
+PartitionedConvolver::~PartitionedConvolver() {}
+
+void PartitionedConvolver::Init(uint32_t input_count, uint32_t output_count,
+                                uint32_t partition_size,
+                                uint32_t max_partition_count,
+                                std::error_code& err) {
+  if (input_count == 0 || output_count == 0 || partition_size == 0 ||
+      max_partition_count == 0) {
+    err = std::make_error_code(std::errc::invalid_argument);
+    return;
+  }
+  input_count_ = input_count;
+  output_count_ = output_count;
+  partition_size_ = partition_size;
+  max_partition_count_ = max_partition_count;
+
+  impl_ = std::make_shared<Impl>();
+  impl_->fft = Fft::Create(2 * partition_size, err);
+  if (err) {
+    return;
+  }
+  auto bin_count = partition_size + 1;
+  impl_->input_block.Init(partition_size, input_count);
+  impl_->output_block.Init(partition_size, output_count);
+  impl_->input_frames = Eigen::MatrixXf::Zero(2 * partition_size, input_count);
+  impl_->delay_line.assign(
+      input_count, Eigen::MatrixXcf::Zero(bin_count, max_partition_count));
+  impl_->delay_line_position = 0;
+  impl_->accumulator.resize(bin_count);
+  impl_->output_frame.resize(2 * partition_size);
+  InitBuffers();
+
+  // previous impulse responses may not fit anymore
+  std::lock_guard<std::mutex> lock(owned_mutex_);
+  pending_.store(nullptr);
+  active_.store(nullptr);
+  owned_.clear();
+}
+
+void PartitionedConvolver::InitBuffers() {
+  auto container_size = 2 * (block_size_ + partition_size_);
+  impl_->input_buffer = std::make_shared<MultichannelRingBuffer>(
+      container_size, input_count_);
+  impl_->output_buffer = std::make_shared<MultichannelRingBuffer>(
+      container_size, output_count_);
+  // when blocks don't line up with partitions, a partition of delay makes sure
+  // there is always enough output
+  if (FrameLatency() > 0) {
+    impl_->output_buffer->InitWithZeros(FrameLatency());
+  }
+}
+
+void PartitionedConvolver::set_block_size(uint32_t value) {
+  block_size_ = value;
+  if (impl_) {
+    InitBuffers();
+  }
+}
+uint32_t PartitionedConvolver::block_size() const { return block_size_; }
+
+uint32_t PartitionedConvolver::FrameLatency() const {
+  return block_size_ % partition_size_ == 0 ? 0 : partition_size_;
+}
+
+uint32_t PartitionedConvolver::input_count() const { return input_count_; }
+uint32_t PartitionedConvolver::output_count() const { return output_count_; }
+uint32_t PartitionedConvolver::partition_size() const {
+  return partition_size_;
+}
+
+std::shared_ptr<const PartitionedConvolver::ImpulseResponse>
+PartitionedConvolver::Prepare(const std::vector<const float*>& data,
+                              uint32_t size, std::error_code& err) const {
+  auto partition_count = (size + partition_size_ - 1) / partition_size_;
+  if (data.size() != input_count_ * output_count_ || size == 0 ||
+      partition_count > max_partition_count_) {
+    err = std::make_error_code(std::errc::invalid_argument);
+    return nullptr;
+  }
+  // the audio thread uses the convolver transform
+  auto fft = Fft::Create(2 * partition_size_, Fft::Direction::Forward, err);
+  if (err) {
+    return nullptr;
+  }
+
+  auto impulse_response = std::make_shared<ImpulseResponse>();
+  impulse_response->input_count = input_count_;
+  impulse_response->output_count = output_count_;
+  impulse_response->partition_size = partition_size_;
+  impulse_response->partitions.resize(data.size());
+  Eigen::VectorXf frame(2 * partition_size_);
+  for (auto pair_idx = 0; pair_idx < data.size(); pair_idx++) {
+    if (!data[pair_idx]) {
+      continue;
+    }
+    auto& partitions = impulse_response->partitions[pair_idx];
+    partitions.resize(partition_size_ + 1, partition_count);
+    for (uint32_t partition_idx = 0; partition_idx < partition_count;
+         partition_idx++) {
+      // each partition is zero padded to the transform size
+      auto offset = partition_idx * partition_size_;
+      auto count = std::min(partition_size_, size - offset);
+      frame.setZero();
+      frame.head(count) =
+          Eigen::Map<const Eigen::VectorXf>(data[pair_idx] + offset, count);
+      fft->Forward(frame.data(), partitions.col(partition_idx).data());
+    }
+  }
+  return impulse_response;
+}
+
+bool PartitionedConvolver::Accepts(
+    const ImpulseResponse& impulse_response) const {
+  if (impulse_response.input_count != input_count_ ||
+      impulse_response.output_count != output_count_ ||
+      impulse_response.partition_size != partition_size_) {
+    return false;
+  }
+  for (auto& partitions : impulse_response.partitions) {
+    if (partitions.cols() > max_partition_count_) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void PartitionedConvolver::set_impulse_response(
+    std::shared_ptr<const ImpulseResponse> impulse_response,
+    std::error_code& err) {
+  if (!impl_ || (impulse_response && !Accepts(*impulse_response))) {
+    err = std::make_error_code(std::errc::invalid_argument);
+    return;
+  }
+  std::lock_guard<std::mutex> lock(owned_mutex_);
+  owned_.push_back(impulse_response);
+  pending_.store(impulse_response.get());
+  ReleaseImpulseResponses();
+}
+
+void PartitionedConvolver::ReleaseUnused() {
+  std::lock_guard<std::mutex> lock(owned_mutex_);
+  ReleaseImpulseResponses();
+}
+
+void PartitionedConvolver::ReleaseImpulseResponses() {
+  // only release when the audio thread isn't switching, so that the active
+  // impulse response is known. Otherwise the next call releases them
+  auto epoch = epoch_.load();
+  if (epoch & 1) {
+    return;
+  }
+  auto active = active_.load();
+  auto pending = pending_.load();
+  if (epoch_.load() != epoch) {
+    return;
+  }
+  owned_.erase(std::remove_if(owned_.begin(), owned_.end(),
+                              [&](const std::shared_ptr<const ImpulseResponse>&
+                                      impulse_response) {
+                                return impulse_response.get() != active &&
+                                       impulse_response.get() != pending;
+                              }),
+               owned_.end());
+}
+
+void PartitionedConvolver::ProcessBlock(const AudioBuffer& input,
+                                        AudioBuffer* output) {
+  ScopedDenormalFlush denormal_flush;
+  // pick up the latest impulse response
+  epoch_.fetch_add(1);
+  auto impulse_response = pending_.load();
+  active_.store(impulse_response);
+  epoch_.fetch_add(1);
+
+  auto& impl = *impl_;
+  auto frame_count = input.frame_count();
+  impl.input_buffer->Write(input, frame_count);
+  while (impl.input_buffer->Read(&impl.input_block, partition_size_)) {
+    ProcessPartition(impulse_response);
+    impl.output_buffer->Write(impl.output_block, partition_size_);
+  }
+
+  if (!impl.output_buffer->Read(output, frame_count)) {
+    // if we don't have enough data to be read, just fill with zeros
+    for (auto channel_idx = 0; channel_idx < output->channel_count();
+         channel_idx++) {
+      std::fill(output->data(channel_idx),
+                output->data(channel_idx) + frame_count, 0);
+    }
+  }
+}
+
+void PartitionedConvolver::ProcessPartition(
+    const ImpulseResponse* impulse_response) {
+  auto& impl = *impl_;
+  auto partition_size = partition_size_;
+
+  // slide the input frames and add the spectrum of the newest one to the
+  // delay line
+  impl.input_frames.topRows(partition_size) =
+      impl.input_frames.bottomRows(partition_size);
+  impl.input_frames.bottomRows(partition_size) = impl.input_block.matrix();
+  auto position = impl.delay_line_position;
+  for (uint32_t input_idx = 0; input_idx < input_count_; input_idx++) {
+    impl.fft->Forward(impl.input_frames.col(input_idx).data(),
+                      impl.delay_line[input_idx].col(position).data());
+  }
+  impl.delay_line_position = (position + 1) % max_partition_count_;
+
+  for (uint32_t output_idx = 0; output_idx < output_count_; output_idx++) {
+    auto output = impl.output_block.channel(output_idx);
+    // multiply accumulate every partition with the matching delayed input
+    // spectrum. Eigen vectorizes the complex products
+    auto accumulated = false;
+    impl.accumulator.setZero();
+    for (uint32_t input_idx = 0; impulse_response && input_idx < input_count_;
+         input_idx++) {
+      auto& partitions =
+          impulse_response->partitions[output_idx * input_count_ + input_idx];
+      auto& delay_line = impl.delay_line[input_idx];
+      for (uint32_t partition_idx = 0; partition_idx < partitions.cols();
+           partition_idx++) {
+        auto delayed_position =
+            (position + max_partition_count_ - partition_idx) %
+            max_partition_count_;
+        impl.accumulator.array() +=
+            delay_line.col(delayed_position).array() *
+            partitions.col(partition_idx).array();
+        accumulated = true;
+      }
+    }
+    if (!accumulated) {
+      output.setZero();
+      continue;
+    }
+
+    // overlap-save: the last partition of the inverse transform is the
+    // linear convolution of the newest input partition
+    impl.fft->Backward(impl.accumulator.data(), impl.output_frame.data());
+    output = impl.output_frame.tail(partition_size);
+  }
+}
+
+}  // namespace rtff
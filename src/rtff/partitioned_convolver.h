@@ -0,0 +1,156 @@
+#ifndef RTFF_PARTITIONED_CONVOLVER_H_
+#define RTFF_PARTITIONED_CONVOLVER_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <vector>
+
+#include "rtff/buffer/audio_buffer.h"
+
+namespace rtff {
+
+/**
+ * @brief Convolve a multichannel signal with long impulse responses using
+ * uniformly partitioned overlap-save convolution.
+ * Impulse responses are split into partitions of partition size samples,
+ * transformed once, and multiplied with a frequency domain delay line of the
+ * input spectra. Every partition is processed on every block, so the cost of a
+ * block doesn't depend on its position, and the processing latency is a
+ * single partition.
+ * Each output channel is the sum of every input channel convolved with its
+ * own impulse response, so any input / output matrix is supported.
+ */
+class PartitionedConvolver {
+ public:
+  /**
+   * @brief a set of impulse responses, already partitioned and transformed.
+   * It is prepared outside of the audio thread and can be shared by several
+   * convolvers with the same partition size and channel counts
+   */
+  class ImpulseResponse;
+
+  PartitionedConvolver();
+  ~PartitionedConvolver();
+
+  /**
+   * @brief Initialize the convolver
+   * @param input_count: the number of input channels
+   * @param output_count: the number of output channels
+   * @param partition_size: the number of samples of each partition. The
+   * transforms are twice that size
+   * @param max_partition_count: the number of partitions of the longest
+   * impulse response the convolver will run
+   * @param err: an error code that gets set if something goes wrong
+   */
+  void Init(uint32_t input_count, uint32_t output_count,
+            uint32_t partition_size, uint32_t max_partition_count,
+            std::error_code& err);
+
+  /**
+   * @brief partition and transform impulse responses. It allocates, and must
+   * not be called from the audio thread
+   * @param data: output count * input count impulse responses, the one
+   * convolving input i into output o at index o * input count + i. A nullptr
+   * means the input doesn't contribute to the output
+   * @param size: the number of samples of each impulse response
+   * @param err: an error code that gets set if the impulse responses don't
+   * fit the convolver
+   * @return the prepared impulse responses
+   */
+  std::shared_ptr<const ImpulseResponse> Prepare(
+      const std::vector<const float*>& data, uint32_t size,
+      std::error_code& err) const;
+
+  /**
+   * @brief use new impulse responses. It doesn't block the audio thread,
+   * which picks them up at the start of its next block. The convolver keeps
+   * the previous impulse responses alive until the audio thread is done with
+   * them: they are released by ReleaseUnused or the next
+   * set_impulse_response call, never from the audio thread
+   * @param impulse_response: impulse responses prepared by a convolver with
+   * the same configuration, or nullptr to output silence
+   * @param err: an error code that gets set if the impulse responses don't
+   * fit the convolver
+   */
+  void set_impulse_response(
+      std::shared_ptr<const ImpulseResponse> impulse_response,
+      std::error_code& err);
+  /**
+   * @brief release the impulse responses the audio thread no longer uses. It
+   * must not be called from the audio thread
+   * @note the audio thread stops using the previous impulse responses at the
+   * start of the block following set_impulse_response, so a call after that
+   * block frees their memory, unless the caller still holds them. If the
+   * audio thread is picking up impulse responses at that moment, nothing is
+   * released until the next call
+   */
+  void ReleaseUnused();
+
+  /**
+   * @brief define the block size
+   * @param value: the number of frames of each processed buffer
+   */
+  void set_block_size(uint32_t value);
+  /**
+   * @return the block size
+   */
+  uint32_t block_size() const;
+
+  /**
+   * @brief convolve a block. It doesn't lock nor allocate
+   * @param input: block size frames of input count channels
+   * @param output: block size frames of output count channels
+   */
+  void ProcessBlock(const AudioBuffer& input, AudioBuffer* output);
+
+  /**
+   * @return the latency in frames added to the convolution. It is 0 when the
+   * block size is a multiple of the partition size, the partition size
+   * otherwise
+   */
+  uint32_t FrameLatency() const;
+
+  /**
+   * @return the number of input channels
+   */
+  uint32_t input_count() const;
+  /**
+   * @return the number of output channels
+   */
+  uint32_t output_count() const;
+  /**
+   * @return the partition size in samples
+   */
+  uint32_t partition_size() const;
+
+ private:
+  void InitBuffers();
+  void ProcessPartition(const ImpulseResponse* impulse_response);
+  void ReleaseImpulseResponses();
+  bool Accepts(const ImpulseResponse& impulse_response) const;
+
+  uint32_t input_count_;
+  uint32_t output_count_;
+  uint32_t partition_size_;
+  uint32_t max_partition_count_;
+  uint32_t block_size_;
+
+  class Impl;
+  std::shared_ptr<Impl> impl_;
+
+  // the impulse responses handed to the audio thread, and the one it uses.
+  // The epoch is odd while the audio thread moves from one to the other
+  std::atomic<const ImpulseResponse*> pending_;
+  std::atomic<const ImpulseResponse*> active_;
+  std::atomic<uint64_t> epoch_;
+  // keeps the published impulse responses alive until the audio thread is
+  // done with them
+  std::mutex owned_mutex_;
+  std::vector<std::shared_ptr<const ImpulseResponse>> owned_;
+};
+
+}  // namespace rtff
+
+#endif  // RTFF_PARTITIONED_CONVOLVER_H_
@@ -0,0 +1,574 @@
+// Offline rendering of a wave file through a filter.
+// Both the input and the output files are memory mapped, so that samples are
+// converted straight from and to the page cache without any intermediate
+// copy of the whole file.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "rtff/buffer/pcm.h"
+#include "rtff/filter.h"
+#include "rtff/stream_processor.h"
+
+namespace {
+
+// the number of blocks of each stream submitted before waiting for them
+const uint32_t kQueueDepth = 32;
+
+const uint16_t kFormatPcm = 1;
+const uint16_t kFormatFloat = 3;
+const uint16_t kFormatExtensible = 0xFFFE;
+const uint32_t kHeaderSize = 44;
+
+std::error_code LastError() {
+  return std::error_code(errno, std::generic_category());
+}
+
+/**
+ * @brief a memory mapping of a whole file
+ */
+class MappedFile {
+ public:
+  MappedFile() : fd_(-1), data_(nullptr), size_(0) {}
+  ~MappedFile() { Close(); }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  /**
+   * @brief map an existing file for reading
+   * @param path: the file path
+   * @param err: an error code that gets set if the file can't be mapped
+   */
+  void Open(const std::string& path, std::error_code& err) {
+    fd_ = open(path.c_str(), O_RDONLY);
+    struct stat status;
+    if (fd_ < 0 || fstat(fd_, &status) != 0) {
+      err = LastError();
+      return;
+    }
+    Map(status.st_size, PROT_READ, err);
+    if (!err) {
+      // the file is read once, from start to end
+      madvise(data_, size_, MADV_SEQUENTIAL);
+    }
+  }
+
+  /**
+   * @brief create, or truncate, a file and map it for writing
+   * @param path: the file path
+   * @param size: the size of the file in bytes
+   * @param err: an error code that gets set if the file can't be mapped
+   */
+  void Create(const std::string& path, size_t size, std::error_code& err) {
+    fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0 || ftruncate(fd_, size) != 0) {
+      err = LastError();
+      return;
+    }
+    Map(size, PROT_READ | PROT_WRITE, err);
+  }
+
+  void Close() {
+    if (data_) {
+      munmap(data_, size_);
+      data_ = nullptr;
+    }
+    if (fd_ >= 0) {
+      close(fd_);
+      fd_ = -1;
+    }
+  }
+
+  uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  void Map(size_t size, int protection, std::error_code& err) {
+    if (size == 0) {
+      err = std::make_error_code(std::errc::invalid_argument);
+      return;
+    }
+    auto data = mmap(nullptr, size, protection, MAP_SHARED, fd_, 0);
+    if (data == MAP_FAILED) {
+      err = LastError();
+      return;
+    }
+    data_ = static_cast<uint8_t*>(data);
+    size_ = size;
+  }
+
+  int fd_;
+  uint8_t* data_;
+  size_t size_;
+};
+
+enum class SampleFormat { Int16, Int24, Int32, Float32 };
+
+/**
+ * @brief the layout of the samples of a wave file
+ * @note samples are little endian, like the host
+ */
+struct WaveFormat {
+  SampleFormat sample_format;
+  uint16_t channel_count;
+  uint32_t sample_rate;
+  // the position and size in bytes of the interleaved samples
+  size_t data_offset;
+  size_t data_size;
+
+  uint32_t bytes_per_sample() const {
+    switch (sample_format) {
+      case SampleFormat::Int16:
+        return 2;
+      case SampleFormat::Int24:
+        return 3;
+      default:
+        return 4;
+    }
+  }
+  uint32_t frame_size() const { return bytes_per_sample() * channel_count; }
+  uint32_t frame_count() const { return data_size / frame_size(); }
+};
+
+uint16_t ReadUint16(const uint8_t* data) { return data[0] | data[1] << 8; }
+uint32_t ReadUint32(const uint8_t* data) {
+  return ReadUint16(data) | static_cast<uint32_t>(ReadUint16(data + 2)) << 16;
+}
+void WriteUint16(uint16_t value, uint8_t* data) {
+  data[0] = value & 0xFF;
+  data[1] = value >> 8;
+}
+void WriteUint32(uint32_t value, uint8_t* data) {
+  WriteUint16(value & 0xFFFF, data);
+  WriteUint16(value >> 16, data + 2);
+}
+
+/**
+ * @brief read the format and locate the samples of a mapped wave file
+ * @param file: the mapped file
+ * @param format: the parsed format
+ * @param err: an error code that gets set if the file isn't a supported wave
+ * file
+ */
+void ParseHeader(const MappedFile& file, WaveFormat* format,
+                 std::error_code& err) {
+  auto data = file.data();
+  auto size = file.size();
+  if (size < 12 || std::memcmp(data, "RIFF", 4) != 0 ||
+      std::memcmp(data + 8, "WAVE", 4) != 0) {
+    err = std::make_error_code(std::errc::invalid_argument);
+    return;
+  }
+
+  auto found_format = false;
+  size_t offset = 12;
+  while (offset + 8 <= size) {
+    auto chunk = data + offset;
+    size_t chunk_size = ReadUint32(chunk + 4);
+    auto body = offset + 8;
+    if (std::memcmp(chunk, "fmt ", 4) == 0 && chunk_size >= 16 &&
+        body + chunk_size <= size) {
+      auto tag = ReadUint16(chunk + 8);
+      format->channel_count = ReadUint16(chunk + 10);
+      format->sample_rate = ReadUint32(chunk + 12);
+      auto bits = ReadUint16(chunk + 22);
+      if (tag == kFormatExtensible && chunk_size >= 26) {
+        // the sub format guid starts with the format tag
+        tag = ReadUint16(chunk + 32);
+      }
+      if (tag == kFormatPcm && bits == 16) {
+        format->sample_format = SampleFormat::Int16;
+      } else if (tag == kFormatPcm && bits == 24) {
+        format->sample_format = SampleFormat::Int24;
+      } else if (tag == kFormatPcm && bits == 32) {
+        format->sample_format = SampleFormat::Int32;
+      } else if (tag == kFormatFloat && bits == 32) {
+        format->sample_format = SampleFormat::Float32;
+      } else {
+        err = std::make_error_code(std::errc::not_supported);
+        return;
+      }
+      found_format = format->channel_count > 0;
+    } else if (std::memcmp(chunk, "data", 4) == 0 && found_format) {
+      // some writers leave the size of streamed files unset
+      format->data_offset = body;
+      format->data_size = std::min(chunk_size, size - body);
+      // the samples are accessed in place
+      if (body % std::min(format->bytes_per_sample(), 4u) != 0 &&
+          format->sample_format != SampleFormat::Int24) {
+        err = std::make_error_code(std::errc::not_supported);
+      }
+      return;
+    }
+    // chunks are padded to an even size
+    offset = body + chunk_size + (chunk_size & 1);
+  }
+  err = std::make_error_code(std::errc::invalid_argument);
+}
+
+/**
+ * @brief write a canonical wave header
+ * @param format: the format of the samples, whose data offset is the header
+ * size
+ * @param data: the start of the file
+ */
+void WriteHeader(const WaveFormat& format, uint8_t* data) {
+  auto is_float = format.sample_format == SampleFormat::Float32;
+  std::memcpy(data, "RIFF", 4);
+  WriteUint32(kHeaderSize - 8 + format.data_size, data + 4);
+  std::memcpy(data + 8, "WAVE", 4);
+  std::memcpy(data + 12, "fmt ", 4);
+  WriteUint32(16, data + 16);
+  WriteUint16(is_float ? kFormatFloat : kFormatPcm, data + 20);
+  WriteUint16(format.channel_count, data + 22);
+  WriteUint32(format.sample_rate, data + 24);
+  WriteUint32(format.sample_rate * format.frame_size(), data + 28);
+  WriteUint16(format.frame_size(), data + 32);
+  WriteUint16(format.bytes_per_sample() * 8, data + 34);
+  std::memcpy(data + 36, "data", 4);
+  WriteUint32(format.data_size, data + 40);
+}
+
+/**
+ * @brief convert the samples of a channel to floats
+ * @param format: the sample format
+ * @param frames: the first interleaved frame
+ * @param channel_idx: the channel index
+ * @param frame_count: the number of frames to convert
+ * @param result: frame_count floats
+ */
+void ReadChannel(const WaveFormat& format, const uint8_t* frames,
+                 uint32_t channel_idx, uint32_t frame_count, float* result) {
+  auto stride = format.channel_count;
+  switch (format.sample_format) {
+    case SampleFormat::Int16:
+      rtff::pcm::ToFloat(reinterpret_cast<const int16_t*>(frames) + channel_idx,
+                         stride, frame_count, result);
+      break;
+    case SampleFormat::Int24:
+      rtff::pcm::ToFloat(
+          reinterpret_cast<const rtff::pcm::Int24*>(frames) + channel_idx,
+          stride, frame_count, result);
+      break;
+    case SampleFormat::Int32:
+      rtff::pcm::ToFloat(reinterpret_cast<const int32_t*>(frames) + channel_idx,
+                         stride, frame_count, result);
+      break;
+    case SampleFormat::Float32: {
+      auto samples = reinterpret_cast<const float*>(frames) + channel_idx;
+      for (uint32_t frame_idx = 0; frame_idx < frame_count; frame_idx++) {
+        result[frame_idx] = samples[frame_idx * stride];
+      }
+      break;
+    }
+  }
+}
+
+/**
+ * @brief convert floats to the samples of a channel
+ * @param format: the sample format
+ * @param data: frame_count floats
+ * @param frame_count: the number of frames to convert
+ * @param channel_idx: the channel index
+ * @param frames: the first interleaved frame
+ */
+void WriteChannel(const WaveFormat& format, const float* data,
+                  uint32_t frame_count, uint32_t channel_idx,
+                  uint8_t* frames) {
+  auto stride = format.channel_count;
+  switch (format.sample_format) {
+    case SampleFormat::Int16:
+      rtff::pcm::FromFloat(data, frame_count,
+                           reinterpret_cast<int16_t*>(frames) + channel_idx,
+                           stride, nullptr);
+      break;
+    case SampleFormat::Int24:
+      rtff::pcm::FromFloat(
+          data, frame_count,
+          reinterpret_cast<rtff::pcm::Int24*>(frames) + channel_idx, stride,
+          nullptr);
+      break;
+    case SampleFormat::Int32:
+      rtff::pcm::FromFloat(data, frame_count,
+                           reinterpret_cast<int32_t*>(frames) + channel_idx,
+                           stride, nullptr);
+      break;
+    case SampleFormat::Float32: {
+      auto samples = reinterpret_cast<float*>(frames) + channel_idx;
+      for (uint32_t frame_idx = 0; frame_idx < frame_count; frame_idx++) {
+        samples[frame_idx * stride] = data[frame_idx];
+      }
+      break;
+    }
+  }
+}
+
+struct Options {
+  std::string input_path;
+  std::string output_path;
+  uint32_t fft_size = 2048;
+  // negative for half the fft size
+  int64_t overlap = -1;
+  rtff::fft_window::Type window_type = rtff::fft_window::Type::Hamming;
+  uint32_t block_size = 512;
+  uint32_t thread_count = 1;
+  // 0 to pass the signal through
+  float lowpass = 0;
+};
+
+const std::map<std::string, rtff::fft_window::Type> kWindowTypes = {
+    {"hamming", rtff::fft_window::Type::Hamming},
+    {"blackman", rtff::fft_window::Type::Blackman},
+    {"hann", rtff::fft_window::Type::Hann},
+    {"periodic_hann", rtff::fft_window::Type::PeriodicHann},
+    {"periodic_hamming", rtff::fft_window::Type::PeriodicHamming},
+    {"sqrt_hann", rtff::fft_window::Type::SqrtHann},
+    {"kaiser", rtff::fft_window::Type::Kaiser},
+    {"vorbis", rtff::fft_window::Type::Vorbis},
+    {"rectangular", rtff::fft_window::Type::Rectangular}};
+
+void PrintUsage() {
+  std::cerr
+      << "usage: rtff_process [options] input.wav output.wav\n"
+         "  --fft-size N     the fft size (2048)\n"
+         "  --overlap N      the overlap in samples (fft size / 2)\n"
+         "  --window NAME    hamming, blackman, hann, periodic_hann,\n"
+         "                   periodic_hamming, sqrt_hann, kaiser, vorbis or\n"
+         "                   rectangular (hamming)\n"
+         "  --block-size N   the number of frames of each block (512)\n"
+         "  --threads N      the number of worker threads. The channels are\n"
+         "                   split between them (1)\n"
+         "  --lowpass HZ     remove the bins above a frequency. The signal\n"
+         "                   goes through unchanged otherwise\n";
+}
+
+/**
+ * @return false if the command line is invalid
+ */
+bool ParseOptions(int argc, char** argv, Options* options) {
+  std::vector<std::string> paths;
+  try {
+    for (auto arg_idx = 1; arg_idx < argc; arg_idx++) {
+      std::string arg = argv[arg_idx];
+      if (arg.compare(0, 2, "--") != 0) {
+        paths.push_back(arg);
+        continue;
+      }
+      if (arg_idx + 1 >= argc) {
+        return false;
+      }
+      std::string value = argv[++arg_idx];
+      if (arg == "--fft-size") {
+        options->fft_size = std::stoul(value);
+      } else if (arg == "--overlap") {
+        options->overlap = std::stoul(value);
+      } else if (arg == "--window") {
+        auto it = kWindowTypes.find(value);
+        if (it == kWindowTypes.end()) {
+          return false;
+        }
+        options->window_type = it->second;
+      } else if (arg == "--block-size") {
+        options->block_size = std::stoul(value);
+      } else if (arg == "--threads") {
+        options->thread_count = std::stoul(value);
+      } else if (arg == "--lowpass") {
+        options->lowpass = std::stof(value);
+      } else {
+        return false;
+      }
+    }
+  } catch (const std::logic_error&) {
+    return false;
+  }
+  if (paths.size() != 2 || options->block_size == 0 ||
+      options->thread_count == 0) {
+    return false;
+  }
+  if (options->overlap < 0) {
+    options->overlap = options->fft_size / 2;
+  }
+  options->input_path = paths[0];
+  options->output_path = paths[1];
+  return true;
+}
+
+/**
+ * @brief the filter of a contiguous range of channels, and its blocks
+ */
+struct ChannelGroup {
+  uint32_t first_channel;
+  uint32_t channel_count;
+  std::shared_ptr<rtff::Filter> filter;
+  std::vector<std::unique_ptr<rtff::AudioBuffer>> blocks;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    PrintUsage();
+    return 1;
+  }
+
+  std::error_code err;
+  MappedFile input;
+  input.Open(options.input_path, err);
+  WaveFormat format;
+  if (!err) {
+    ParseHeader(input, &format, err);
+  }
+  if (err) {
+    std::cerr << "Error when reading " << options.input_path << ": "
+              << err.message() << std::endl;
+    return 1;
+  }
+  auto frame_count = format.frame_count();
+  auto frame_size = format.frame_size();
+  auto input_frames = input.data() + format.data_offset;
+
+  auto output_format = format;
+  output_format.data_offset = kHeaderSize;
+  output_format.data_size = static_cast<size_t>(frame_count) * frame_size;
+  MappedFile output;
+  output.Create(options.output_path, kHeaderSize + output_format.data_size,
+                err);
+  if (err) {
+    std::cerr << "Error when creating " << options.output_path << ": "
+              << err.message() << std::endl;
+    return 1;
+  }
+  WriteHeader(output_format, output.data());
+  auto output_frames = output.data() + kHeaderSize;
+
+  // split the channels between the workers, one filter each
+  auto block_size = options.block_size;
+  auto group_count =
+      std::min<uint32_t>(options.thread_count, format.channel_count);
+  rtff::StreamProcessor processor(group_count);
+  std::vector<ChannelGroup> groups(group_count);
+  for (uint32_t group_idx = 0; group_idx < group_count; group_idx++) {
+    auto& group = groups[group_idx];
+    group.first_channel = group_idx * format.channel_count / group_count;
+    group.channel_count =
+        (group_idx + 1) * format.channel_count / group_count -
+        group.first_channel;
+    group.filter = std::make_shared<rtff::Filter>();
+    group.filter->Init(group.channel_count, options.fft_size, options.overlap,
+                       options.window_type, err);
+    if (err) {
+      std::cerr << "Error when initializing the filter: " << err.message()
+                << std::endl;
+      return 1;
+    }
+    group.filter->set_block_size(block_size);
+    if (options.lowpass > 0) {
+      auto cutoff_bin = static_cast<uint32_t>(
+          options.lowpass * options.fft_size / format.sample_rate);
+      group.filter->execute = [cutoff_bin](
+                                  std::vector<std::complex<float>*> data,
+                                  uint32_t size) {
+        if (cutoff_bin + 1 >= size) {
+          return;
+        }
+        for (auto channel : data) {
+          std::fill(channel + cutoff_bin + 1, channel + size, 0);
+        }
+      };
+    }
+    for (uint32_t block_idx = 0; block_idx < kQueueDepth; block_idx++) {
+      group.blocks.emplace_back(
+          new rtff::AudioBuffer(block_size, group.channel_count));
+    }
+    processor.AddStream(group.filter);
+  }
+
+  // the input is preceded by a frame of silence, so that its first samples
+  // are covered by as many frames as the others. The output is shifted by
+  // that frame and the latency, so that it lines up with the input
+  const uint64_t lead = options.fft_size;
+  const auto delay = lead + groups.front().filter->FrameLatency();
+  const auto total_frame_count = frame_count + delay;
+  const auto block_count = (total_frame_count + block_size - 1) / block_size;
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t chunk_start = 0; chunk_start < block_count;
+       chunk_start += kQueueDepth) {
+    auto chunk_end = std::min<uint64_t>(chunk_start + kQueueDepth, block_count);
+    for (auto block_idx = chunk_start; block_idx < chunk_end; block_idx++) {
+      auto block_frame = block_idx * block_size;
+      auto read_begin = std::max(block_frame, lead);
+      auto read_end = std::min(block_frame + block_size, lead + frame_count);
+      auto read_count = static_cast<uint32_t>(
+          read_end > read_begin ? read_end - read_begin : 0);
+      auto head_count = static_cast<uint32_t>(
+          std::min<uint64_t>(read_begin - block_frame, block_size - read_count));
+      for (uint32_t group_idx = 0; group_idx < group_count; group_idx++) {
+        auto& group = groups[group_idx];
+        auto block = group.blocks[block_idx - chunk_start].get();
+        for (uint32_t channel_idx = 0; channel_idx < group.channel_count;
+             channel_idx++) {
+          auto data = block->data(channel_idx);
+          std::fill(data, data + head_count, 0);
+          ReadChannel(format, input_frames + (read_begin - lead) * frame_size,
+                      group.first_channel + channel_idx, read_count,
+                      data + head_count);
+          std::fill(data + head_count + read_count, data + block_size, 0);
+        }
+
+        processor.Submit(
+            group_idx, block,
+            [&output_format, &group, output_frames, block_frame, block_size,
+             delay, frame_count](rtff::AudioBuffer* buffer) {
+              // drop the delayed frames and the tail
+              auto skip = block_frame < delay ? delay - block_frame : 0;
+              if (skip >= block_size) {
+                return;
+              }
+              auto output_frame = block_frame + skip - delay;
+              if (output_frame >= frame_count) {
+                return;
+              }
+              auto count = static_cast<uint32_t>(std::min<uint64_t>(
+                  block_size - skip, frame_count - output_frame));
+              for (uint32_t channel_idx = 0;
+                   channel_idx < group.channel_count; channel_idx++) {
+                WriteChannel(output_format, buffer->data(channel_idx) + skip,
+                             count, group.first_channel + channel_idx,
+                             output_frames +
+                                 output_frame * output_format.frame_size());
+              }
+            });
+      }
+    }
+    processor.Wait();
+  }
+  auto end = std::chrono::steady_clock::now();
+  output.Close();
+
+  auto elapsed = std::chrono::duration<double>(end - start).count();
+  auto duration = static_cast<double>(frame_count) / format.sample_rate;
+  auto megabytes = static_cast<double>(format.data_size) / 1e6;
+  std::cout << "rendered " << frame_count << " frames of "
+            << format.channel_count << " channels (" << duration << " s) in "
+            << elapsed << " s" << std::endl;
+  std::cout << "real-time factor: " << duration / elapsed
+            << "x, throughput: " << megabytes / elapsed << " MB/s"
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,350 @@
+#include "rtff/spectrogram_file.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define RTFF_HAS_MMAP
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+namespace rtff {
+
+namespace {
+
+// the header and the frames are aligned on cache lines
+const uint32_t kAlignment = 64;
+const uint32_t kHeaderSize = 64;
+const char kMagic[4] = {'R', 'T', 'F', 'S'};
+const uint32_t kVersion = 1;
+const uint8_t kLastWindowType =
+    static_cast<uint8_t>(fft_window::Type::Rectangular);
+
+// the header fields, at fixed offsets
+enum HeaderOffset : uint32_t {
+  kMagicOffset = 0,
+  kVersionOffset = 4,
+  kFftSizeOffset = 8,
+  kHopSizeOffset = 12,
+  kSampleRateOffset = 16,
+  kChannelCountOffset = 20,
+  kBinCountOffset = 24,
+  kFrameStrideOffset = 28,
+  kWindowTypeOffset = 32,
+  kSynthesisWindowTypeOffset = 33,
+  kStorageOffset = 34
+};
+
+uint32_t BinSize(FrameHistory::Storage storage) {
+  switch (storage) {
+    case FrameHistory::Storage::Complex:
+      return sizeof(std::complex<float>);
+    case FrameHistory::Storage::Magnitude:
+      return sizeof(float);
+    case FrameHistory::Storage::Half:
+      return 2 * sizeof(uint16_t);
+  }
+  return 0;
+}
+
+// the header fields are written byte by byte, so that they are little endian
+// whatever the host
+void Store(uint8_t* header, uint32_t offset, uint32_t value) {
+  for (uint32_t byte_idx = 0; byte_idx < sizeof(value); byte_idx++) {
+    header[offset + byte_idx] = (value >> (8 * byte_idx)) & 0xFF;
+  }
+}
+uint32_t Load(const uint8_t* header, uint32_t offset) {
+  uint32_t value = 0;
+  for (uint32_t byte_idx = 0; byte_idx < sizeof(value); byte_idx++) {
+    value |= static_cast<uint32_t>(header[offset + byte_idx])
+             << (8 * byte_idx);
+  }
+  return value;
+}
+
+// frames are written and mapped as they are in memory, which is only the file
+// layout on little endian hosts
+bool IsLittleEndianHost() {
+  const uint16_t value = 1;
+  uint8_t first_byte;
+  std::memcpy(&first_byte, &value, sizeof(first_byte));
+  return first_byte == 1;
+}
+
+bool IsValid(const SpectrogramFormat& format) {
+  return format.fft_size > 0 && format.hop_size > 0 &&
+         format.hop_size <= format.fft_size && format.sample_rate > 0 &&
+         format.channel_count > 0;
+}
+
+}  // namespace
+
+uint32_t SpectrogramFormat::bin_count() const { return fft_size / 2 + 1; }
+
+uint32_t SpectrogramFormat::frame_stride() const {
+  auto size = BinSize(storage) * bin_count() * channel_count;
+  return (size + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+SpectrogramWriter::SpectrogramWriter(uint32_t capacity)
+    : capacity_(std::max(capacity, 1u)),
+      write_position_(0),
+      read_position_(0),
+      dropped_count_(0) {}
+
+SpectrogramWriter::~SpectrogramWriter() {
+  std::error_code err;
+  Close(err);
+}
+
+void SpectrogramWriter::Open(const std::string& path,
+                             const SpectrogramFormat& format,
+                             std::error_code& err) {
+  Close(err);
+  if (err) {
+    return;
+  }
+  if (!IsLittleEndianHost()) {
+    err = std::make_error_code(std::errc::not_supported);
+    return;
+  }
+  if (!IsValid(format)) {
+    err = std::make_error_code(std::errc::invalid_argument);
+    return;
+  }
+  file_.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file_.is_open()) {
+    err = std::make_error_code(std::errc::io_error);
+    return;
+  }
+  format_ = format;
+
+  uint8_t header[kHeaderSize] = {};
+  std::memcpy(header + kMagicOffset, kMagic, sizeof(kMagic));
+  Store(header, kVersionOffset, kVersion);
+  Store(header, kFftSizeOffset, format.fft_size);
+  Store(header, kHopSizeOffset, format.hop_size);
+  Store(header, kSampleRateOffset, format.sample_rate);
+  Store(header, kChannelCountOffset, format.channel_count);
+  Store(header, kBinCountOffset, format.bin_count());
+  Store(header, kFrameStrideOffset, format.frame_stride());
+  header[kWindowTypeOffset] = static_cast<uint8_t>(format.window_type);
+  header[kSynthesisWindowTypeOffset] =
+      static_cast<uint8_t>(format.synthesis_window_type);
+  header[kStorageOffset] = static_cast<uint8_t>(format.storage);
+  file_.write(reinterpret_cast<const char*>(header), kHeaderSize);
+
+  frames_.assign(static_cast<std::size_t>(capacity_) * format.channel_count *
+                     format.bin_count(),
+                 0);
+  encoded_frame_.assign(format.frame_stride(), 0);
+  write_position_ = 0;
+  read_position_ = 0;
+  dropped_count_ = 0;
+  drain_thread_.Start([this] { Drain(); });
+}
+
+void SpectrogramWriter::Close(std::error_code& err) {
+  if (!drain_thread_.running()) {
+    return;
+  }
+  drain_thread_.Stop();
+  if (!file_.good()) {
+    err = std::make_error_code(std::errc::io_error);
+  }
+  file_.close();
+}
+
+bool SpectrogramWriter::Push(const std::complex<float>* const* data) {
+  if (frames_.empty()) {
+    return false;
+  }
+  // single producer queue: the slot is free once the writer has read it
+  auto position = write_position_.load(std::memory_order_relaxed);
+  if (position - read_position_.load(std::memory_order_acquire) ==
+      capacity_) {
+    dropped_count_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  auto bin_count = format_.bin_count();
+  auto frame = frames_.data() + (position % capacity_) *
+                                    format_.channel_count * bin_count;
+  for (uint32_t channel_idx = 0; channel_idx < format_.channel_count;
+       channel_idx++) {
+    std::copy(data[channel_idx], data[channel_idx] + bin_count,
+              frame + channel_idx * bin_count);
+  }
+  write_position_.store(position + 1, std::memory_order_release);
+  return true;
+}
+
+uint64_t SpectrogramWriter::dropped_count() const {
+  return dropped_count_.load(std::memory_order_relaxed);
+}
+const SpectrogramFormat& SpectrogramWriter::format() const { return format_; }
+
+void SpectrogramWriter::Drain() {
+  auto bin_count = format_.bin_count();
+  auto value_count = format_.channel_count * bin_count;
+  auto position = read_position_.load(std::memory_order_relaxed);
+  while (position != write_position_.load(std::memory_order_acquire)) {
+    auto frame = frames_.data() + (position % capacity_) * value_count;
+    // the frames are encoded here, off the audio thread
+    switch (format_.storage) {
+      case FrameHistory::Storage::Complex:
+        std::memcpy(encoded_frame_.data(), frame,
+                    value_count * sizeof(std::complex<float>));
+        break;
+      case FrameHistory::Storage::Magnitude: {
+        auto output = reinterpret_cast<float*>(encoded_frame_.data());
+        for (uint32_t value_idx = 0; value_idx < value_count; value_idx++) {
+          output[value_idx] = std::abs(frame[value_idx]);
+        }
+        break;
+      }
+      case FrameHistory::Storage::Half: {
+        auto output = reinterpret_cast<uint16_t*>(encoded_frame_.data());
+        for (uint32_t value_idx = 0; value_idx < value_count; value_idx++) {
+          output[2 * value_idx] =
+              FrameHistory::FloatToHalf(frame[value_idx].real());
+          output[2 * value_idx + 1] =
+              FrameHistory::FloatToHalf(frame[value_idx].imag());
+        }
+        break;
+      }
+    }
+    position++;
+    read_position_.store(position, std::memory_order_release);
+    file_.write(reinterpret_cast<const char*>(encoded_frame_.data()),
+                encoded_frame_.size());
+  }
+}
+
+SpectrogramReader::SpectrogramReader()
+    : frame_count_(0), data_(nullptr), size_(0) {}
+
+SpectrogramReader::~SpectrogramReader() { Close(); }
+
+void SpectrogramReader::Open(const std::string& path, std::error_code& err) {
+  Close();
+#if defined(RTFF_HAS_MMAP)
+  if (!IsLittleEndianHost()) {
+    err = std::make_error_code(std::errc::not_supported);
+    return;
+  }
+  auto fd = open(path.c_str(), O_RDONLY);
+  struct stat status;
+  if (fd < 0 || fstat(fd, &status) != 0) {
+    err = std::error_code(errno, std::generic_category());
+    if (fd >= 0) {
+      close(fd);
+    }
+    return;
+  }
+  if (static_cast<std::size_t>(status.st_size) < kHeaderSize) {
+    close(fd);
+    err = std::make_error_code(std::errc::invalid_argument);
+    return;
+  }
+  auto data = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  // the mapping keeps the file open
+  close(fd);
+  if (data == MAP_FAILED) {
+    err = std::error_code(errno, std::generic_category());
+    return;
+  }
+  data_ = static_cast<const uint8_t*>(data);
+  size_ = status.st_size;
+
+  SpectrogramFormat format;
+  format.fft_size = Load(data_, kFftSizeOffset);
+  format.hop_size = Load(data_, kHopSizeOffset);
+  format.sample_rate = Load(data_, kSampleRateOffset);
+  format.channel_count = Load(data_, kChannelCountOffset);
+  format.window_type =
+      static_cast<fft_window::Type>(data_[kWindowTypeOffset]);
+  format.synthesis_window_type =
+      static_cast<fft_window::Type>(data_[kSynthesisWindowTypeOffset]);
+  format.storage = static_cast<FrameHistory::Storage>(data_[kStorageOffset]);
+  if (std::memcmp(data_ + kMagicOffset, kMagic, sizeof(kMagic)) != 0 ||
+      Load(data_, kVersionOffset) != kVersion || !IsValid(format) ||
+      data_[kStorageOffset] >
+          static_cast<uint8_t>(FrameHistory::Storage::Half) ||
+      data_[kWindowTypeOffset] > kLastWindowType ||
+      data_[kSynthesisWindowTypeOffset] > kLastWindowType ||
+      Load(data_, kBinCountOffset) != format.bin_count() ||
+      Load(data_, kFrameStrideOffset) != format.frame_stride()) {
+    Close();
+    err = std::make_error_code(std::errc::invalid_argument);
+    return;
+  }
+  format_ = format;
+  frame_count_ = (size_ - kHeaderSize) / format.frame_stride();
+#else
+  err = std::make_error_code(std::errc::not_supported);
+#endif
+}
+
+void SpectrogramReader::Close() {
+#if defined(RTFF_HAS_MMAP)
+  if (data_) {
+    munmap(const_cast<uint8_t*>(data_), size_);
+  }
+#endif
+  data_ = nullptr;
+  size_ = 0;
+  frame_count_ = 0;
+}
+
+const SpectrogramFormat& SpectrogramReader::format() const { return format_; }
+uint64_t SpectrogramReader::frame_count() const { return frame_count_; }
+
+const std::complex<float>* SpectrogramReader::frame(
+    uint64_t frame_idx, uint32_t channel_idx) const {
+  assert(format_.storage == FrameHistory::Storage::Complex);
+  return reinterpret_cast<const std::complex<float>*>(
+      Channel(frame_idx, channel_idx));
+}
+const float* SpectrogramReader::magnitudes(uint64_t frame_idx,
+                                           uint32_t channel_idx) const {
+  assert(format_.storage == FrameHistory::Storage::Magnitude);
+  return reinterpret_cast<const float*>(Channel(frame_idx, channel_idx));
+}
+const uint16_t* SpectrogramReader::half_frame(uint64_t frame_idx,
+                                              uint32_t channel_idx) const {
+  assert(format_.storage == FrameHistory::Storage::Half);
+  return reinterpret_cast<const uint16_t*>(Channel(frame_idx, channel_idx));
+}
+
+void SpectrogramReader::ReadFrame(uint64_t frame_idx, uint32_t channel_idx,
+                                  std::complex<float>* result) const {
+  assert(format_.storage != FrameHistory::Storage::Magnitude);
+  auto bin_count = format_.bin_count();
+  if (format_.storage == FrameHistory::Storage::Complex) {
+    auto bins = frame(frame_idx, channel_idx);
+    std::copy(bins, bins + bin_count, result);
+    return;
+  }
+  auto bins = half_frame(frame_idx, channel_idx);
+  for (uint32_t bin_idx = 0; bin_idx < bin_count; bin_idx++) {
+    result[bin_idx] =
+        std::complex<float>(FrameHistory::HalfToFloat(bins[2 * bin_idx]),
+                            FrameHistory::HalfToFloat(bins[2 * bin_idx + 1]));
+  }
+}
+
+const uint8_t* SpectrogramReader::Channel(uint64_t frame_idx,
+                                          uint32_t channel_idx) const {
+  assert(frame_idx < frame_count_);
+  return data_ + kHeaderSize + frame_idx * format_.frame_stride() +
+         static_cast<std::size_t>(channel_idx) * format_.bin_count() *
+             BinSize(format_.storage);
+}
+
+}  // namespace rtff
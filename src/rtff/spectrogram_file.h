@@ -0,0 +1,192 @@
+#ifndef RTFF_SPECTROGRAM_FILE_H_
+#define RTFF_SPECTROGRAM_FILE_H_
+
+#include <atomic>
+#include <complex>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "rtff/buffer/aligned_allocator.h"
+#include "rtff/drain_thread.h"
+#include "rtff/fft/window_type.h"
+#include "rtff/frame_history.h"
+
+namespace rtff {
+
+/**
+ * @brief the stft parameters and the frame storage of a spectrogram file.
+ * A spectrogram file starts with a 64 bytes header describing them, followed
+ * by frames of a fixed stride, a multiple of 64 bytes. Each frame holds the
+ * fft_size / 2 + 1 bins of every channel, one channel after the other.
+ * Values are little endian, and frames are stored as FrameHistory stores
+ * them: complex floats, float magnitudes or complex half floats. Frames are
+ * written and mapped as they are in memory, so spectrogram files are only
+ * supported on little endian hosts
+ */
+struct SpectrogramFormat {
+  uint32_t fft_size = 2048;
+  uint32_t hop_size = 1024;
+  fft_window::Type window_type = fft_window::Type::Hamming;
+  fft_window::Type synthesis_window_type = fft_window::Type::Hamming;
+  uint32_t sample_rate = 44100;
+  uint32_t channel_count = 1;
+  FrameHistory::Storage storage = FrameHistory::Storage::Complex;
+
+  /**
+   * @return the number of bins of each channel of a frame
+   */
+  uint32_t bin_count() const;
+  /**
+   * @return the number of bytes between two frames
+   */
+  uint32_t frame_stride() const;
+};
+
+/**
+ * @brief Write spectral frames to a spectrogram file.
+ * Frames are pushed into a preallocated lock free queue from the audio
+ * thread, for instance from ProcessTransformedBlock. A background thread
+ * encodes them and appends them to the file. When the queue is full, new
+ * frames are dropped and counted.
+ * @see SpectrogramFormat
+ */
+class SpectrogramWriter {
+ public:
+  /**
+   * @brief Constructor
+   * @param capacity: the number of frames the queue can hold, at least 1
+   */
+  explicit SpectrogramWriter(uint32_t capacity = 256);
+  ~SpectrogramWriter();
+
+  /**
+   * @brief create the file, write its header and start the background
+   * writer. It allocates the queue
+   * @param path: the path of the file
+   * @param format: the format of the frames
+   * @param err: an error code that gets set if the format is invalid, the
+   * file can't be created or the host is big endian
+   */
+  void Open(const std::string& path, const SpectrogramFormat& format,
+            std::error_code& err);
+  /**
+   * @brief stop the background writer, write the remaining frames and close
+   * the file. Called by the destructor
+   * @param err: an error code that gets set if a frame couldn't be written
+   */
+  void Close(std::error_code& err);
+
+  /**
+   * @brief push a frame. It doesn't lock nor allocate
+   * @param data: one pointer per channel to bin_count bins
+   * @return false if the frame was dropped because the queue was full
+   */
+  bool Push(const std::complex<float>* const* data);
+
+  /**
+   * @return the number of frames dropped because the queue was full
+   */
+  uint64_t dropped_count() const;
+  /**
+   * @return the format of the frames
+   */
+  const SpectrogramFormat& format() const;
+
+ private:
+  void Drain();
+
+  SpectrogramFormat format_;
+  uint32_t capacity_;
+  // the queued frames, capacity frames of channel_count * bin_count bins
+  std::vector<std::complex<float>, AlignedAllocator<std::complex<float>>>
+      frames_;
+  // single producer single consumer positions
+  std::atomic<uint64_t> write_position_;
+  std::atomic<uint64_t> read_position_;
+  std::atomic<uint64_t> dropped_count_;
+
+  // a frame encoded as stored in the file
+  std::vector<uint8_t> encoded_frame_;
+  std::ofstream file_;
+  DrainThread drain_thread_;
+};
+
+/**
+ * @brief Read a spectrogram file with random access to its frames.
+ * The file is memory mapped: opening it only reads its header, and frames
+ * are accessed in place. The frame count is given by the file size, so a file
+ * still being written, or cut short, exposes every complete frame. Only
+ * supported on posix platforms
+ * @see SpectrogramFormat
+ */
+class SpectrogramReader {
+ public:
+  SpectrogramReader();
+  ~SpectrogramReader();
+
+  /**
+   * @brief map a spectrogram file
+   * @param path: the path of the file
+   * @param err: an error code that gets set if the file can't be mapped,
+   * isn't a spectrogram file or the host is big endian
+   */
+  void Open(const std::string& path, std::error_code& err);
+  /**
+   * @brief unmap the file. Called by the destructor
+   */
+  void Close();
+
+  /**
+   * @return the format of the frames
+   */
+  const SpectrogramFormat& format() const;
+  /**
+   * @return the number of complete frames of the file
+   */
+  uint64_t frame_count() const;
+
+  /**
+   * @brief the bins of a channel of a frame with the Complex storage
+   * @param frame_idx: the frame index
+   * @param channel_idx: the channel index
+   * @return bin_count bins, in the mapped file
+   */
+  const std::complex<float>* frame(uint64_t frame_idx,
+                                   uint32_t channel_idx) const;
+  /**
+   * @brief the bins of a channel of a frame with the Magnitude storage
+   * @see frame
+   */
+  const float* magnitudes(uint64_t frame_idx, uint32_t channel_idx) const;
+  /**
+   * @brief the bins of a channel of a frame with the Half storage, two values
+   * per bin
+   * @see frame
+   */
+  const uint16_t* half_frame(uint64_t frame_idx, uint32_t channel_idx) const;
+
+  /**
+   * @brief decode a channel of a frame of the Complex or Half storage
+   * @param frame_idx: the frame index
+   * @param channel_idx: the channel index
+   * @param result: bin_count bins
+   */
+  void ReadFrame(uint64_t frame_idx, uint32_t channel_idx,
+                 std::complex<float>* result) const;
+
+ private:
+  // the first byte of a channel of a frame
+  const uint8_t* Channel(uint64_t frame_idx, uint32_t channel_idx) const;
+
+  SpectrogramFormat format_;
+  uint64_t frame_count_;
+  const uint8_t* data_;
+  std::size_t size_;
+};
+
+}  // namespace rtff
+
+#endif  // RTFF_SPECTROGRAM_FILE_H_
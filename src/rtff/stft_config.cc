@@ -0,0 +1,147 @@
+#include "rtff/stft_config.h"
+
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+#include "rtff/fft/window.h"
+
+namespace rtff {
+
+namespace {
+
+// relative tolerance of the constant overlap-add detection
+const float kColaTolerance = 1e-5f;
+
+}  // namespace
+
+std::shared_ptr<const StftConfig> StftConfig::Get(uint32_t fft_size,
+                                                  uint32_t overlap,
+                                                  fft_window::Type window_type,
+                                                  std::error_code& err) {
+  return Get(fft_size, overlap, window_type, window_type, err);
+}
+
+std::shared_ptr<const StftConfig> StftConfig::Get(
+    uint32_t fft_size, uint32_t overlap, fft_window::Type analysis_window_type,
+    fft_window::Type synthesis_window_type, std::error_code& err) {
+  return Get(fft_size, overlap, analysis_window_type, synthesis_window_type,
+             false, err);
+}
+
+std::shared_ptr<const StftConfig> StftConfig::GetOverlapSave(
+    uint32_t fft_size, uint32_t filter_length, std::error_code& err) {
+  if (filter_length == 0) {
+    err = std::make_error_code(std::errc::invalid_argument);
+    return nullptr;
+  }
+  return Get(fft_size, filter_length - 1, fft_window::Type::Rectangular,
+             fft_window::Type::Rectangular, true, err);
+}
+
+std::shared_ptr<const StftConfig> StftConfig::Get(
+    uint32_t fft_size, uint32_t overlap, fft_window::Type analysis_window_type,
+    fft_window::Type synthesis_window_type, bool overlap_save,
+    std::error_code& err) {
+  if (fft_size == 0 || overlap >= fft_size) {
+    err = std::make_error_code(std::errc::invalid_argument);
+    return nullptr;
+  }
+
+  // the configurations are kept alive by their users only
+  using Key = std::tuple<uint32_t, uint32_t, fft_window::Type,
+                         fft_window::Type, bool>;
+  static std::mutex mutex;
+  static std::map<Key, std::weak_ptr<const StftConfig>> configs;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  auto& cached = configs[Key(fft_size, overlap, analysis_window_type,
+                             synthesis_window_type, overlap_save)];
+  auto config = cached.lock();
+  if (!config) {
+    config.reset(new StftConfig(fft_size, overlap, analysis_window_type,
+                                synthesis_window_type, overlap_save));
+    cached = config;
+  }
+
+  // forget the configurations nobody uses anymore
+  for (auto it = configs.begin(); it != configs.end();) {
+    if (it->second.expired()) {
+      it = configs.erase(it);
+    } else {
+      it++;
+    }
+  }
+  return config;
+}
+
+StftConfig::StftConfig(uint32_t fft_size, uint32_t overlap,
+                       fft_window::Type analysis_window_type,
+                       fft_window::Type synthesis_window_type,
+                       bool overlap_save)
+    : fft_size_(fft_size),
+      overlap_(overlap),
+      overlap_save_(overlap_save),
+      window_type_(analysis_window_type),
+      synthesis_window_type_(synthesis_window_type) {
+  window_ = Window::Make(analysis_window_type, fft_size);
+  if (synthesis_window_type != analysis_window_type) {
+    synthesis_window_ = Window::Make(synthesis_window_type, fft_size);
+  }
+  if (overlap_save) {
+    // the inverse transforms are not overlapped, only their tail is kept
+    cola_ = false;
+    gain_type_ = GainType::None;
+    synthesis_scale_ = 1;
+    synthesis_gain_ = Eigen::VectorXf::Ones(fft_size);
+    return;
+  }
+  auto unwindow = Window::MakeInverse(analysis_window_type,
+                                      synthesis_window_type, fft_size,
+                                      hop_size());
+
+  // with constant overlap-add windows, the division by the unwindow is a
+  // scale that can be folded into the synthesis window, or skipped
+  auto mean = unwindow.mean();
+  cola_ = mean > 0 &&
+          (unwindow.array() - mean).abs().maxCoeff() <= kColaTolerance * mean;
+  if (!cola_) {
+    gain_type_ = GainType::Window;
+    synthesis_scale_ = 1;
+    synthesis_gain_ = synthesis_window().array() / unwindow.array();
+    return;
+  }
+  synthesis_scale_ = 1 / mean;
+  synthesis_gain_ = synthesis_window() * synthesis_scale_;
+  if (synthesis_window_type != fft_window::Type::Rectangular) {
+    gain_type_ = GainType::Window;
+  } else if (std::abs(synthesis_scale_ - 1) <= kColaTolerance) {
+    gain_type_ = GainType::None;
+  } else {
+    gain_type_ = GainType::Scalar;
+  }
+}
+
+uint32_t StftConfig::fft_size() const { return fft_size_; }
+uint32_t StftConfig::overlap() const { return overlap_; }
+uint32_t StftConfig::hop_size() const { return fft_size_ - overlap_; }
+uint32_t StftConfig::window_size() const { return fft_size_; }
+bool StftConfig::overlap_save() const { return overlap_save_; }
+fft_window::Type StftConfig::window_type() const { return window_type_; }
+fft_window::Type StftConfig::synthesis_window_type() const {
+  return synthesis_window_type_;
+}
+
+const Eigen::VectorXf& StftConfig::analysis_window() const { return window_; }
+const Eigen::VectorXf& StftConfig::synthesis_window() const {
+  return synthesis_window_.size() ? synthesis_window_ : window_;
+}
+bool StftConfig::cola() const { return cola_; }
+StftConfig::GainType StftConfig::gain_type() const { return gain_type_; }
+float StftConfig::synthesis_scale() const { return synthesis_scale_; }
+const Eigen::VectorXf& StftConfig::synthesis_gain() const {
+  return synthesis_gain_;
+}
+
+}  // namespace rtff
@@ -0,0 +1,162 @@
+#ifndef RTFF_STFT_CONFIG_H_
+#define RTFF_STFT_CONFIG_H_
+
+#include <memory>
+#include <system_error>
+
+#include <Eigen/Core>
+
+#include "rtff/fft/window_type.h"
+
+namespace rtff {
+
+/**
+ * @brief the immutable part of a short time fourier transform configuration.
+ * It holds the read only tables every stream of the same configuration uses,
+ * so that they are computed and stored once, and shared between streams and
+ * threads
+ */
+class StftConfig {
+ public:
+  /**
+   * @brief how an inverse transform is scaled before the overlap-add
+   */
+  enum class GainType : uint8_t {
+    /** the windows are constant overlap-add with a unit sum and the synthesis
+       window is rectangular: nothing to apply */
+    None,
+    /** the windows are constant overlap-add and the synthesis window is
+       rectangular: a single scale is applied */
+    Scalar,
+    /** a gain is applied per sample */
+    Window
+  };
+
+  /**
+   * @brief get the configuration, shared with every user of the same
+   * parameters
+   * @param fft_size: the length in samples of the fourier transform window
+   * @param overlap: the number of samples kept between each frame
+   * @param window_type: the type of the analysis and synthesis windows
+   * @param err: an error code that gets set if the parameters are invalid
+   * @return the configuration, nullptr on error
+   */
+  static std::shared_ptr<const StftConfig> Get(uint32_t fft_size,
+                                               uint32_t overlap,
+                                               fft_window::Type window_type,
+                                               std::error_code& err);
+  /**
+   * @brief get the configuration, shared with every user of the same
+   * parameters
+   * @param fft_size: the length in samples of the fourier transform window
+   * @param overlap: the number of samples kept between each frame
+   * @param analysis_window_type: the type of the analysis window
+   * @param synthesis_window_type: the type of the synthesis window
+   * @param err: an error code that gets set if the parameters are invalid
+   * @return the configuration, nullptr on error
+   */
+  static std::shared_ptr<const StftConfig> Get(
+      uint32_t fft_size, uint32_t overlap,
+      fft_window::Type analysis_window_type,
+      fft_window::Type synthesis_window_type, std::error_code& err);
+  /**
+   * @brief get an overlap-save configuration, shared with every user of the
+   * same parameters.
+   * Frames are not windowed, the hop size is fft_size - filter_length + 1 and
+   * the synthesis keeps the last hop size samples of each inverse transform,
+   * discarding the circularly aliased head. It is exact for spectral
+   * multiplications by the response of a filter of at most filter_length taps
+   * @param fft_size: the length in samples of the fourier transform window
+   * @param filter_length: the maximum number of taps of the applied filters
+   * @param err: an error code that gets set if the parameters are invalid
+   * @return the configuration, nullptr on error
+   */
+  static std::shared_ptr<const StftConfig> GetOverlapSave(
+      uint32_t fft_size, uint32_t filter_length, std::error_code& err);
+
+  /**
+   * @return the fft size in samples
+   */
+  uint32_t fft_size() const;
+  /**
+   * @return the overlap in samples
+   */
+  uint32_t overlap() const;
+  /**
+   * @return the hop size in samples
+   */
+  uint32_t hop_size() const;
+  /**
+   * @return the window size in samples
+   */
+  uint32_t window_size() const;
+  /**
+   * @return true for an overlap-save configuration
+   */
+  bool overlap_save() const;
+  /**
+   * @return the type of the analysis window
+   */
+  fft_window::Type window_type() const;
+  /**
+   * @return the type of the synthesis window
+   */
+  fft_window::Type synthesis_window_type() const;
+
+  /**
+   * @return the window used for the analysis stage
+   */
+  const Eigen::VectorXf& analysis_window() const;
+  /**
+   * @return the window used for the synthesis stage. It is the analysis one
+   * when both types are the same
+   */
+  const Eigen::VectorXf& synthesis_window() const;
+  /**
+   * @return true if the overlapped analysis * synthesis windows sum to a
+   * constant (constant overlap-add)
+   */
+  bool cola() const;
+  /**
+   * @return how the inverse transforms are scaled
+   */
+  GainType gain_type() const;
+  /**
+   * @return the scale applied when the gain type is Scalar
+   */
+  float synthesis_scale() const;
+  /**
+   * @return the gain applied to an inverse transform before the overlap-add:
+   * the synthesis window divided by the overlapped analysis * synthesis
+   * windows. With constant overlap-add windows, the division is folded into
+   * a scale of the synthesis window
+   */
+  const Eigen::VectorXf& synthesis_gain() const;
+
+ private:
+  static std::shared_ptr<const StftConfig> Get(
+      uint32_t fft_size, uint32_t overlap,
+      fft_window::Type analysis_window_type,
+      fft_window::Type synthesis_window_type, bool overlap_save,
+      std::error_code& err);
+  StftConfig(uint32_t fft_size, uint32_t overlap,
+             fft_window::Type analysis_window_type,
+             fft_window::Type synthesis_window_type, bool overlap_save);
+
+  uint32_t fft_size_;
+  uint32_t overlap_;
+  bool overlap_save_;
+  fft_window::Type window_type_;
+  fft_window::Type synthesis_window_type_;
+  Eigen::VectorXf window_;
+  // empty when the synthesis window is the analysis one
+  Eigen::VectorXf synthesis_window_;
+  bool cola_;
+  GainType gain_type_;
+  float synthesis_scale_;
+  Eigen::VectorXf synthesis_gain_;
+};
+
+}  // namespace rtff
+
+#endif  // RTFF_STFT_CONFIG_H_
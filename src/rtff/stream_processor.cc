@@ -0,0 +1,208 @@
+#include "rtff/stream_processor.h"
+
+#include <algorithm>
+#include <cassert>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace rtff {
+
+StreamProcessor::StreamProcessor(uint32_t thread_count, bool pin_threads)
+    : pin_threads_(pin_threads),
+      ready_count_(0),
+      running_(true),
+      pending_count_(0) {
+  if (thread_count == 0) {
+    thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  for (uint32_t worker_idx = 0; worker_idx < thread_count; worker_idx++) {
+    workers_.emplace_back(new Worker);
+  }
+  // start the threads once every queue exists, they steal from each other
+  for (uint32_t worker_idx = 0; worker_idx < thread_count; worker_idx++) {
+    workers_[worker_idx]->thread =
+        std::thread(&StreamProcessor::Run, this, worker_idx);
+  }
+}
+
+StreamProcessor::~StreamProcessor() {
+  Wait();
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    running_.store(false);
+  }
+  wake_condition_.notify_all();
+  for (auto& worker : workers_) {
+    worker->thread.join();
+  }
+}
+
+uint32_t StreamProcessor::AddStream(std::shared_ptr<AbstractFilter> filter) {
+  std::lock_guard<std::mutex> lock(streams_mutex_);
+  auto stream_idx = static_cast<uint32_t>(streams_.size());
+  std::unique_ptr<Stream> stream(new Stream);
+  stream->filter = filter;
+  stream->home_worker = stream_idx % workers_.size();
+  stream->scheduled = false;
+  streams_.push_back(std::move(stream));
+  return stream_idx;
+}
+
+void StreamProcessor::Submit(uint32_t stream_idx, AudioBuffer* buffer,
+                             Callback callback) {
+  Stream* stream;
+  {
+    std::lock_guard<std::mutex> lock(streams_mutex_);
+    assert(stream_idx < streams_.size());
+    stream = streams_[stream_idx].get();
+  }
+  {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    pending_count_++;
+  }
+
+  bool schedule = false;
+  {
+    std::lock_guard<std::mutex> lock(stream->mutex);
+    stream->blocks.push_back(Block{buffer, std::move(callback)});
+    // a stream is in at most one queue, so its blocks can't run concurrently
+    if (!stream->scheduled) {
+      stream->scheduled = true;
+      schedule = true;
+    }
+  }
+  if (schedule) {
+    Schedule(stream, stream->home_worker);
+  }
+}
+
+std::future<void> StreamProcessor::Submit(uint32_t stream_idx,
+                                          AudioBuffer* buffer) {
+  auto promise = std::make_shared<std::promise<void>>();
+  auto future = promise->get_future();
+  Submit(stream_idx, buffer, [promise](AudioBuffer*) { promise->set_value(); });
+  return future;
+}
+
+void StreamProcessor::Wait() {
+  std::unique_lock<std::mutex> lock(pending_mutex_);
+  pending_condition_.wait(lock, [this] { return pending_count_ == 0; });
+}
+
+uint32_t StreamProcessor::thread_count() const { return workers_.size(); }
+
+uint32_t StreamProcessor::stream_count() const {
+  std::lock_guard<std::mutex> lock(streams_mutex_);
+  return streams_.size();
+}
+
+void StreamProcessor::Run(uint32_t worker_idx) {
+  if (pin_threads_) {
+    Pin(worker_idx);
+  }
+  while (true) {
+    auto stream = Pop(worker_idx);
+    if (stream) {
+      Process(stream, worker_idx);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    wake_condition_.wait(lock, [this] {
+      return ready_count_.load() > 0 || !running_.load();
+    });
+    if (!running_.load() && ready_count_.load() == 0) {
+      return;
+    }
+  }
+}
+
+void StreamProcessor::Schedule(Stream* stream, uint32_t worker_idx) {
+  {
+    auto& worker = *workers_[worker_idx];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.streams.push_back(stream);
+  }
+  {
+    // increment under the lock so that a worker can't miss the notification
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    ready_count_++;
+  }
+  wake_condition_.notify_one();
+}
+
+StreamProcessor::Stream* StreamProcessor::Pop(uint32_t worker_idx) {
+  // the own queue first, oldest stream first so that streams are served fairly
+  {
+    auto& worker = *workers_[worker_idx];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (!worker.streams.empty()) {
+      auto stream = worker.streams.front();
+      worker.streams.pop_front();
+      ready_count_--;
+      return stream;
+    }
+  }
+  // then steal the most recently scheduled stream of another worker
+  for (uint32_t offset = 1; offset < workers_.size(); offset++) {
+    auto& victim = *workers_[(worker_idx + offset) % workers_.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.streams.empty()) {
+      auto stream = victim.streams.back();
+      victim.streams.pop_back();
+      ready_count_--;
+      return stream;
+    }
+  }
+  return nullptr;
+}
+
+void StreamProcessor::Process(Stream* stream, uint32_t worker_idx) {
+  Block block;
+  {
+    std::lock_guard<std::mutex> lock(stream->mutex);
+    block = std::move(stream->blocks.front());
+    stream->blocks.pop_front();
+  }
+
+  stream->filter->ProcessBlock(block.buffer);
+  if (block.callback) {
+    block.callback(block.buffer);
+  }
+
+  bool schedule = false;
+  {
+    std::lock_guard<std::mutex> lock(stream->mutex);
+    if (stream->blocks.empty()) {
+      stream->scheduled = false;
+    } else {
+      schedule = true;
+    }
+  }
+  // process one block at a time, and go back at the end of the queue so that
+  // a busy stream doesn't starve the others. It stays on this worker, whose
+  // caches hold its state
+  if (schedule) {
+    Schedule(stream, worker_idx);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    pending_count_--;
+  }
+  pending_condition_.notify_all();
+}
+
+void StreamProcessor::Pin(uint32_t worker_idx) {
+#ifdef __linux__
+  auto core_count = std::max(std::thread::hardware_concurrency(), 1u);
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(worker_idx % core_count, &cpu_set);
+  pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set);
+#endif
+}
+
+}  // namespace rtff
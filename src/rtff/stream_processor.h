@@ -0,0 +1,137 @@
+#ifndef RTFF_STREAM_PROCESSOR_H_
+#define RTFF_STREAM_PROCESSOR_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "rtff/abstract_filter.h"
+#include "rtff/buffer/audio_buffer.h"
+
+namespace rtff {
+
+/**
+ * @brief Run the blocks of many independent filters on a fixed pool of
+ * worker threads.
+ * Each worker owns a queue of ready streams and steals from the other
+ * workers when its own queue is empty. The blocks of a stream are processed
+ * one at a time, in submission order, and preferably by the same worker so
+ * that the filter state stays in its caches.
+ */
+class StreamProcessor {
+ public:
+  /**
+   * @brief the function called once a block has been processed
+   */
+  using Callback = std::function<void(AudioBuffer* buffer)>;
+
+  /**
+   * @brief Constructor. Starts the worker threads
+   * @param thread_count: the number of workers. 0 uses one worker per
+   * hardware thread
+   * @param pin_threads: if true, each worker is pinned to a core. Only
+   * supported on linux, ignored elsewhere
+   */
+  explicit StreamProcessor(uint32_t thread_count = 0, bool pin_threads = false);
+  /**
+   * @brief Destructor. Waits for every submitted block and stops the workers
+   */
+  ~StreamProcessor();
+
+  StreamProcessor(const StreamProcessor&) = delete;
+  StreamProcessor& operator=(const StreamProcessor&) = delete;
+
+  /**
+   * @brief register a filter
+   * @param filter: an initialized filter. It must only be processed through
+   * the StreamProcessor from now on
+   * @return the stream index used to submit blocks
+   */
+  uint32_t AddStream(std::shared_ptr<AbstractFilter> filter);
+
+  /**
+   * @brief submit a block to be processed
+   * @param stream_idx: the stream index returned by AddStream
+   * @param buffer: the data, processed in place. It must stay valid until the
+   * callback is called
+   * @param callback: called from a worker thread once the block is processed
+   */
+  void Submit(uint32_t stream_idx, AudioBuffer* buffer, Callback callback);
+  /**
+   * @brief submit a block to be processed
+   * @param stream_idx: the stream index returned by AddStream
+   * @param buffer: the data, processed in place. It must stay valid until the
+   * future is ready
+   * @return a future that gets ready once the block is processed
+   */
+  std::future<void> Submit(uint32_t stream_idx, AudioBuffer* buffer);
+
+  /**
+   * @brief block until every submitted block has been processed
+   */
+  void Wait();
+
+  /**
+   * @return the number of worker threads
+   */
+  uint32_t thread_count() const;
+  /**
+   * @return the number of registered streams
+   */
+  uint32_t stream_count() const;
+
+ private:
+  struct Block {
+    AudioBuffer* buffer;
+    Callback callback;
+  };
+
+  struct Stream {
+    std::shared_ptr<AbstractFilter> filter;
+    // the worker the stream is scheduled on by default
+    uint32_t home_worker;
+    std::mutex mutex;
+    std::deque<Block> blocks;
+    // true while the stream is in a worker queue or being processed
+    bool scheduled;
+  };
+
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Stream*> streams;
+    std::thread thread;
+  };
+
+  void Run(uint32_t worker_idx);
+  void Schedule(Stream* stream, uint32_t worker_idx);
+  Stream* Pop(uint32_t worker_idx);
+  void Process(Stream* stream, uint32_t worker_idx);
+  void Pin(uint32_t worker_idx);
+
+  bool pin_threads_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+
+  mutable std::mutex streams_mutex_;
+  std::vector<std::unique_ptr<Stream>> streams_;
+
+  // wakes up idle workers
+  std::mutex wake_mutex_;
+  std::condition_variable wake_condition_;
+  std::atomic<uint64_t> ready_count_;
+  std::atomic<bool> running_;
+
+  // blocks submitted but not processed yet
+  std::mutex pending_mutex_;
+  std::condition_variable pending_condition_;
+  uint64_t pending_count_;
+};
+
+}  // namespace rtff
+
+#endif  // RTFF_STREAM_PROCESSOR_H_
@@ -0,0 +1,16 @@
+#include "rtff/synthesis_filter.h"
+
+namespace rtff {
+
+SynthesisFilter::SynthesisFilter()
+    : rtff::AbstractSynthesisFilter(),
+      execute([](std::vector<std::complex<float>*>, uint32_t) {}) {}
+
+SynthesisFilter::~SynthesisFilter() {}
+
+void SynthesisFilter::GenerateTransformedBlock(
+    std::vector<std::complex<float>*> data, uint32_t size) {
+  execute(data, size);
+}
+
+}  // namespace rtff
@@ -0,0 +1,32 @@
+#ifndef RTFF_SYNTHESIS_FILTER_H_
+#define RTFF_SYNTHESIS_FILTER_H_
+
+#include <functional>
+
+#include "rtff/abstract_synthesis_filter.h"
+
+namespace rtff {
+
+/**
+ * @brief Simple synthesis filter that calls the execute function to produce
+ * each frame
+ */
+class SynthesisFilter : public AbstractSynthesisFilter {
+ public:
+  SynthesisFilter();
+  virtual ~SynthesisFilter();
+
+  /**
+   * @brief the function producing each time frequency block
+   * @see rtff::AbstractSynthesisFilter::GenerateTransformedBlock for more.
+   */
+  std::function<void(std::vector<std::complex<float>*>, uint32_t)> execute;
+
+ protected:
+  void GenerateTransformedBlock(std::vector<std::complex<float>*> data,
+                                uint32_t size) override;
+};
+
+}  // namespace rtff
+
+#endif  // RTFF_SYNTHESIS_FILTER_H_
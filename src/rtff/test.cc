@@ -1,15 +1,37 @@
 #include <gtest/gtest.h>
 
+#include <fstream>
 #include <iostream>
+#include <limits>
 
 #include <Eigen/Core>
 
 #include "rtff/abstract_filter.h"
+#include "rtff/analysis_filter.h"
+#include "rtff/denormal.h"
 #include "rtff/filter.h"
+#include "rtff/filter_batch.h"
+#include "rtff/filter_chain.h"
+#include "rtff/filterbank.h"
+#include "rtff/multi_resolution_filter.h"
+#include "rtff/partitioned_convolver.h"
+#include "rtff/spectrogram_file.h"
+#include "rtff/stft_config.h"
+#include "rtff/stream_processor.h"
+#include "rtff/synthesis_filter.h"
 #include "wave/file.h"
 
 const std::string gResourcePath(TEST_RESOURCES_PATH);
 
+// the channels of a buffer as the columns of a matrix. Channels are padded
+// so the matrix has an outer stride
+Eigen::Map<Eigen::MatrixXf, 0, Eigen::OuterStride<>> Channels(
+    rtff::AudioBuffer& buffer) {
+  return Eigen::Map<Eigen::MatrixXf, 0, Eigen::OuterStride<>>(
+      buffer.data(0), buffer.frame_count(), buffer.channel_count(),
+      Eigen::OuterStride<>(buffer.channel_stride()));
+}
+
 class MyFilter : public rtff::AbstractFilter {
 private:
   void ProcessTransformedBlock(std::vector<std::complex<float>*> data,
@@ -146,7 +168,8 @@ TEST(RTFF, Filter) {
   }
 }
 
-uint32_t GetLatency(rtff::Filter& filter);
+template <typename FilterType>
+uint32_t GetLatency(FilterType& filter);
 
 TEST(RTFF, Latency) {
   rtff::Filter filter;
@@ -247,7 +270,8 @@ TEST(RTFF, LittleBlockSize) {
 }
 
 // Compute the filter latency by sending a Dirac and checking the filter output
-uint32_t GetLatency(rtff::Filter& filter) {
+template <typename FilterType>
+uint32_t GetLatency(FilterType& filter) {
   rtff::AudioBuffer buffer(filter.block_size(), filter.channel_count());
   auto block_size = filter.block_size();
 
@@ -275,6 +299,772 @@ uint32_t GetLatency(rtff::Filter& filter) {
   return latency;
 }
 
+// Integer processing must give the same result as the float path
+TEST(RTFF, IntegerProcessing) {
+  const auto channel_number = 2;
+  const auto block_size = 300;
+  rtff::Filter float_filter;
+  rtff::Filter integer_filter;
+  std::error_code err;
+  float_filter.Init(channel_number, err);
+  ASSERT_FALSE(err);
+  integer_filter.Init(channel_number, err);
+  ASSERT_FALSE(err);
+  float_filter.set_block_size(block_size);
+  integer_filter.set_block_size(block_size);
+
+  rtff::AudioBuffer buffer(block_size, channel_number);
+  std::vector<int16_t> interleaved(block_size * channel_number);
+  std::vector<int16_t> expected(block_size * channel_number);
+  for (auto index = 0; index < 50; index++) {
+    Eigen::Map<Eigen::VectorXf>(buffer.data(0), block_size).setRandom();
+    Eigen::Map<Eigen::VectorXf>(buffer.data(1), block_size).setRandom();
+    for (auto channel_idx = 0; channel_idx < channel_number; channel_idx++) {
+      rtff::pcm::FromFloat(buffer.data(channel_idx), block_size,
+                           interleaved.data() + channel_idx, channel_number,
+                           nullptr);
+      rtff::pcm::ToFloat(interleaved.data() + channel_idx, channel_number,
+                         block_size, buffer.data(channel_idx));
+    }
+
+    float_filter.ProcessBlock(&buffer);
+    integer_filter.ProcessInterleavedBlock(interleaved.data(),
+                                           interleaved.data());
+
+    for (auto channel_idx = 0; channel_idx < channel_number; channel_idx++) {
+      rtff::pcm::FromFloat(buffer.data(channel_idx), block_size,
+                           expected.data() + channel_idx, channel_number,
+                           nullptr);
+    }
+    ASSERT_EQ(interleaved, expected);
+  }
+}
+
+// Stage counters are only updated when the instrumentation is compiled in
+TEST(RTFF, StageCounters) {
+  const auto block_size = 256;
+  rtff::Filter filter;
+  std::error_code err;
+  filter.Init(2, 1024, 512, err);
+  ASSERT_FALSE(err);
+  filter.set_block_size(block_size);
+
+  rtff::AudioBuffer buffer(block_size, 2);
+  const auto block_count = 40;
+  for (auto index = 0; index < block_count; index++) {
+    filter.ProcessBlock(&buffer);
+  }
+
+  auto values = filter.stage_counters().values();
+  if (!rtff::StageCounters::enabled()) {
+    ASSERT_EQ(values.block_count, 0);
+    ASSERT_EQ(values.hop_count, 0);
+    ASSERT_EQ(values.copied_bytes, 0);
+    return;
+  }
+  ASSERT_EQ(values.block_count, block_count);
+  // one hop every two blocks
+  ASSERT_EQ(values.hop_count, block_count / 2);
+  ASSERT_EQ(values.copied_bytes,
+            (block_count * 2 * block_size + values.hop_count * (1024 + 512)) *
+                2 * sizeof(float));
+  for (auto stage_idx = 0; stage_idx < rtff::StageCounters::kStageCount;
+       stage_idx++) {
+    ASSERT_GT(values.stage_nanoseconds[stage_idx], 0);
+  }
+
+  filter.stage_counters().Reset();
+  ASSERT_EQ(filter.stage_counters().values().block_count, 0);
+}
+
+// Every block is compared to its real time budget once a sample rate is set
+TEST(RTFF, DeadlineMonitor) {
+  const auto block_size = 256;
+  rtff::Filter filter;
+  std::error_code err;
+  filter.Init(1, 1024, 512, err);
+  ASSERT_FALSE(err);
+  filter.set_block_size(block_size);
+  rtff::AudioBuffer buffer(block_size, 1);
+
+  // disabled by default
+  filter.ProcessBlock(&buffer);
+  ASSERT_EQ(filter.deadline_monitor().values().block_count, 0);
+
+  // a huge sample rate makes every block miss its deadline
+  filter.deadline_monitor().set_sample_rate(1e12);
+  const auto block_count = 10;
+  for (auto index = 0; index < block_count; index++) {
+    filter.ProcessBlock(&buffer);
+  }
+  auto values = filter.deadline_monitor().values();
+  ASSERT_EQ(values.block_count, block_count);
+  ASSERT_EQ(values.miss_count, block_count);
+  ASSERT_EQ(values.histogram[rtff::DeadlineMonitor::kBinCount - 1],
+            block_count);
+  ASSERT_GT(values.worst.load, 1);
+  ASSERT_EQ(values.worst.frame_count, block_size);
+  ASSERT_LE(values.worst.hop_count, 1);
+
+  filter.deadline_monitor().Reset();
+  filter.deadline_monitor().set_sample_rate(44100);
+  filter.ProcessBlock(&buffer);
+  values = filter.deadline_monitor().values();
+  ASSERT_EQ(values.block_count, 1);
+  ASSERT_EQ(values.miss_count, 0);
+}
+
+// Trace every block and stage into a chrome trace file
+TEST(RTFF, Tracer) {
+  const auto block_size = 256;
+  rtff::Filter filter;
+  std::error_code err;
+  filter.Init(1, 1024, 512, err);
+  ASSERT_FALSE(err);
+  filter.set_block_size(block_size);
+
+  auto path = gResourcePath + "/trace.json";
+  auto tracer = std::make_shared<rtff::Tracer>(64);
+  tracer->Start(path, err);
+  ASSERT_FALSE(err);
+  filter.set_tracer(tracer);
+
+  rtff::AudioBuffer buffer(block_size, 1);
+  const auto block_count = 8;
+  for (auto index = 0; index < block_count; index++) {
+    filter.ProcessBlock(&buffer);
+  }
+  tracer->Stop();
+  ASSERT_EQ(tracer->dropped_count(), 0);
+
+  std::ifstream file(path);
+  std::string content((std::istreambuf_iterator<char>(file)),
+                      std::istreambuf_iterator<char>());
+  auto count = [&content](const std::string& pattern) {
+    auto result = 0;
+    for (auto position = content.find(pattern); position != std::string::npos;
+         position = content.find(pattern, position + 1)) {
+      result++;
+    }
+    return result;
+  };
+  ASSERT_EQ(content.find("{\"displayTimeUnit\""), 0);
+  ASSERT_EQ(count("\"name\":\"ProcessBlock\""), block_count);
+  // one hop every two blocks
+  ASSERT_EQ(count("\"name\":\"Analyze\""), block_count / 2);
+  ASSERT_EQ(count("\"name\":\"Synthesize\""), block_count / 2);
+  ASSERT_NE(content.rfind("]}"), std::string::npos);
+
+  // a full queue drops the spans instead of blocking
+  rtff::Tracer small_tracer(2);
+  small_tracer.Record("span", 0, 1);
+  small_tracer.Record("span", 1, 2);
+  small_tracer.Record("span", 2, 3);
+  ASSERT_EQ(small_tracer.dropped_count(), 1);
+}
+
+// Transforming channels two by two must give the same output
+TEST(RTFF, PairTransforms) {
+  const auto block_size = 512;
+  for (auto channel_number : {2, 3}) {
+    for (auto fft_size : {2048, 1023}) {
+      rtff::Filter reference_filter;
+      rtff::Filter pair_filter;
+      std::error_code err;
+      reference_filter.Init(channel_number, fft_size, fft_size / 2, err);
+      ASSERT_FALSE(err);
+      pair_filter.set_pair_transforms(true, err);
+      ASSERT_FALSE(err);
+      pair_filter.Init(channel_number, fft_size, fft_size / 2, err);
+      ASSERT_FALSE(err);
+      ASSERT_TRUE(pair_filter.pair_transforms());
+      reference_filter.set_block_size(block_size);
+      pair_filter.set_block_size(block_size);
+
+      // keep the spectra to compare them
+      std::vector<Eigen::VectorXcf> reference_spectra;
+      reference_filter.execute = [&](std::vector<std::complex<float>*> data,
+                                     uint32_t size) {
+        reference_spectra.clear();
+        for (auto channel_data : data) {
+          reference_spectra.push_back(
+              Eigen::Map<Eigen::VectorXcf>(channel_data, size));
+          // with a spurious imaginary part on the DC bin
+          channel_data[0] += std::complex<float>(0, 1);
+        }
+      };
+      pair_filter.execute = [&](std::vector<std::complex<float>*> data,
+                                uint32_t size) {
+        for (auto channel_idx = 0; channel_idx < data.size(); channel_idx++) {
+          auto spectrum = Eigen::Map<Eigen::VectorXcf>(data[channel_idx], size);
+          ASSERT_TRUE(spectrum.isApprox(reference_spectra[channel_idx], 1e-4));
+          data[channel_idx][0] += std::complex<float>(0, 1);
+        }
+      };
+
+      rtff::AudioBuffer reference(block_size, channel_number);
+      rtff::AudioBuffer buffer(block_size, channel_number);
+      for (auto index = 0; index < 20; index++) {
+        for (auto channel_idx = 0; channel_idx < channel_number;
+             channel_idx++) {
+          auto data = Eigen::Map<Eigen::VectorXf>(buffer.data(channel_idx),
+                                                  block_size);
+          data.setRandom();
+          Eigen::Map<Eigen::VectorXf>(reference.data(channel_idx),
+                                      block_size) = data;
+        }
+        reference_filter.ProcessBlock(&reference);
+        pair_filter.ProcessBlock(&buffer);
+        for (auto channel_idx = 0; channel_idx < channel_number;
+             channel_idx++) {
+          auto expected = Eigen::Map<Eigen::VectorXf>(
+              reference.data(channel_idx), block_size);
+          auto result =
+              Eigen::Map<Eigen::VectorXf>(buffer.data(channel_idx), block_size);
+          ASSERT_LT((result - expected).cwiseAbs().maxCoeff(), 1e-4);
+        }
+      }
+    }
+  }
+}
+
+// Skipping silent and inactive channels must not change the output
+TEST(RTFF, SilenceDetection) {
+  const auto channel_number = 2;
+  const auto block_size = 256;
+  rtff::Filter reference_filter;
+  rtff::Filter silence_filter;
+  std::error_code err;
+  reference_filter.Init(channel_number, err);
+  ASSERT_FALSE(err);
+  silence_filter.Init(channel_number, err);
+  ASSERT_FALSE(err);
+  reference_filter.set_block_size(block_size);
+  silence_filter.set_block_size(block_size);
+  silence_filter.set_silence_detection(true);
+
+  auto reference_calls = 0;
+  auto silence_calls = 0;
+  auto gain = [](std::vector<std::complex<float>*> data, uint32_t size) {
+    for (auto channel_data : data) {
+      Eigen::Map<Eigen::VectorXcf>(channel_data, size) *= 0.5;
+    }
+  };
+  reference_filter.execute = [&](std::vector<std::complex<float>*> data,
+                                 uint32_t size) {
+    reference_calls++;
+    gain(data, size);
+  };
+  silence_filter.execute = [&](std::vector<std::complex<float>*> data,
+                               uint32_t size) {
+    silence_calls++;
+    gain(data, size);
+  };
+
+  rtff::AudioBuffer reference(block_size, channel_number);
+  rtff::AudioBuffer buffer(block_size, channel_number);
+  for (auto index = 0; index < 120; index++) {
+    for (auto channel_idx = 0; channel_idx < channel_number; channel_idx++) {
+      auto data = Eigen::Map<Eigen::VectorXf>(buffer.data(channel_idx),
+                                              block_size);
+      // long silences, shorter on the first channel
+      if ((index / (20 + channel_idx * 10)) % 2 == 0) {
+        data.setRandom();
+      } else {
+        data.setZero();
+      }
+      Eigen::Map<Eigen::VectorXf>(reference.data(channel_idx), block_size) =
+          data;
+    }
+    reference_filter.ProcessBlock(&reference);
+    silence_filter.ProcessBlock(&buffer);
+    for (auto channel_idx = 0; channel_idx < channel_number; channel_idx++) {
+      ASSERT_TRUE(std::equal(buffer.data(channel_idx),
+                             buffer.data(channel_idx) + block_size,
+                             reference.data(channel_idx)));
+    }
+  }
+  ASSERT_LT(silence_calls, reference_calls);
+
+  // an inactive channel outputs zeros once its tail is flushed
+  silence_filter.set_channel_active(1, false);
+  ASSERT_FALSE(silence_filter.channel_active(1));
+  for (auto index = 0; index < 40; index++) {
+    Eigen::Map<Eigen::VectorXf>(buffer.data(0), block_size).setRandom();
+    Eigen::Map<Eigen::VectorXf>(buffer.data(1), block_size).setRandom();
+    silence_filter.ProcessBlock(&buffer);
+    if (index > 20) {
+      ASSERT_TRUE(Eigen::Map<Eigen::VectorXf>(buffer.data(1), block_size)
+                      .isZero(0));
+      ASSERT_FALSE(Eigen::Map<Eigen::VectorXf>(buffer.data(0), block_size)
+                       .isZero(0));
+    }
+  }
+}
+
+// More than 255 channels, processed by groups, give the same output as
+// independent mono filters
+TEST(RTFF, ManyChannels) {
+  const auto channel_number = 300;
+  const auto block_size = 128;
+  rtff::Filter filter;
+  std::error_code err;
+  filter.Init(channel_number, 256, 128, err);
+  ASSERT_FALSE(err);
+  filter.set_block_size(block_size);
+  ASSERT_EQ(filter.channel_count(), channel_number);
+
+  const std::vector<uint32_t> checked_channels = {0, 7, 8, 150, 299};
+  std::vector<std::shared_ptr<rtff::Filter>> mono_filters;
+  for (auto channel_idx : checked_channels) {
+    auto mono_filter = std::make_shared<rtff::Filter>();
+    mono_filter->Init(1, 256, 128, err);
+    ASSERT_FALSE(err);
+    mono_filter->set_block_size(block_size);
+    mono_filters.push_back(mono_filter);
+  }
+
+  rtff::AudioBuffer buffer(block_size, channel_number);
+  rtff::AudioBuffer mono_buffer(block_size, 1);
+  for (auto index = 0; index < 10; index++) {
+    Channels(buffer)
+        .setRandom();
+    std::vector<Eigen::VectorXf> expected;
+    for (auto checked_idx = 0; checked_idx < checked_channels.size();
+         checked_idx++) {
+      std::copy(buffer.data(checked_channels[checked_idx]),
+                buffer.data(checked_channels[checked_idx]) + block_size,
+                mono_buffer.data(0));
+      mono_filters[checked_idx]->ProcessBlock(&mono_buffer);
+      expected.push_back(
+          Eigen::Map<Eigen::VectorXf>(mono_buffer.data(0), block_size));
+    }
+    filter.ProcessBlock(&buffer);
+    for (auto checked_idx = 0; checked_idx < checked_channels.size();
+         checked_idx++) {
+      auto result = Eigen::Map<Eigen::VectorXf>(
+          buffer.data(checked_channels[checked_idx]), block_size);
+      ASSERT_TRUE(result.isApprox(expected[checked_idx], 1e-5));
+    }
+  }
+}
+
+// Test the constant overlap-add detection and the reconstruction of the
+// window families
+TEST(RTFF, WindowReconstruction) {
+  using Type = rtff::fft_window::Type;
+  using GainType = rtff::StftConfig::GainType;
+  struct Case {
+    Type analysis;
+    Type synthesis;
+    uint32_t overlap;
+    bool cola;
+    GainType gain_type;
+  };
+  const uint32_t fft_size = 512;
+  const std::vector<Case> cases = {
+      {Type::SqrtHann, Type::SqrtHann, 256, true, GainType::Window},
+      {Type::Vorbis, Type::Vorbis, 256, true, GainType::Window},
+      {Type::PeriodicHann, Type::Rectangular, 256, true, GainType::None},
+      {Type::PeriodicHann, Type::Rectangular, 384, true, GainType::Scalar},
+      {Type::PeriodicHamming, Type::Rectangular, 256, true, GainType::Scalar},
+      {Type::Kaiser, Type::Kaiser, 384, false, GainType::Window},
+      {Type::Hamming, Type::Hamming, 256, false, GainType::Window}};
+
+  for (auto& test_case : cases) {
+    std::error_code err;
+    auto config = rtff::StftConfig::Get(fft_size, test_case.overlap,
+                                        test_case.analysis,
+                                        test_case.synthesis, err);
+    ASSERT_FALSE(err);
+    ASSERT_EQ(config->cola(), test_case.cola);
+    ASSERT_EQ(config->gain_type(), test_case.gain_type);
+
+    // a pass-through filter gives back the delayed input
+    rtff::Filter filter;
+    filter.Init(1, fft_size, test_case.overlap, test_case.analysis,
+                test_case.synthesis, err);
+    ASSERT_FALSE(err);
+    auto block_size = fft_size - test_case.overlap;
+    filter.set_block_size(block_size);
+    const auto block_count = 20;
+    Eigen::VectorXf input = Eigen::VectorXf::Random(block_size * block_count);
+    Eigen::VectorXf output(input.size());
+    rtff::AudioBuffer buffer(block_size, 1);
+    for (auto block_idx = 0; block_idx < block_count; block_idx++) {
+      auto block = Eigen::Map<Eigen::VectorXf>(buffer.data(0), block_size);
+      block = input.segment(block_idx * block_size, block_size);
+      filter.ProcessBlock(&buffer);
+      output.segment(block_idx * block_size, block_size) = block;
+    }
+    auto latency = filter.FrameLatency();
+    // skip the first frame, which isn't fully overlapped
+    auto start = fft_size;
+    auto count = input.size() - latency - start;
+    ASSERT_TRUE(output.segment(latency + start, count)
+                    .isApprox(input.segment(start, count), 1e-4));
+  }
+}
+
+// Test that identical configurations are shared
+TEST(RTFF, StftConfig) {
+  std::error_code err;
+  auto config = rtff::StftConfig::Get(1024, 768, rtff::fft_window::Type::Hann,
+                                      err);
+  ASSERT_FALSE(err);
+  ASSERT_EQ(config->hop_size(), 256);
+  ASSERT_EQ(config->analysis_window().size(), 1024);
+  ASSERT_EQ(&config->analysis_window(), &config->synthesis_window());
+
+  auto same = rtff::StftConfig::Get(1024, 768, rtff::fft_window::Type::Hann,
+                                    err);
+  ASSERT_FALSE(err);
+  ASSERT_EQ(config, same);
+  auto other = rtff::StftConfig::Get(1024, 512, rtff::fft_window::Type::Hann,
+                                     err);
+  ASSERT_FALSE(err);
+  ASSERT_NE(config, other);
+
+  rtff::StftConfig::Get(1024, 1024, rtff::fft_window::Type::Hann, err);
+  ASSERT_TRUE(err);
+}
+
+// Test that a batch of filters gives the same result as separate filters
+TEST(RTFF, FilterBatch) {
+  const auto block_size = 128;
+  const std::vector<uint32_t> channel_counts = {1, 2, 3, 20};
+  std::error_code err;
+
+  rtff::FilterBatch batch;
+  std::vector<std::shared_ptr<rtff::Filter>> references;
+  std::vector<rtff::AudioBuffer> buffers;
+  for (auto filter_idx = 0; filter_idx < channel_counts.size(); filter_idx++) {
+    for (auto is_reference : {false, true}) {
+      auto filter = std::make_shared<rtff::Filter>();
+      filter->Init(channel_counts[filter_idx], 256, 192, err);
+      ASSERT_FALSE(err);
+      filter->set_block_size(block_size);
+      auto gain = 1.0f / (filter_idx + 1);
+      filter->execute = [gain](std::vector<std::complex<float>*> data,
+                               uint32_t size) {
+        for (auto channel_data : data) {
+          Eigen::Map<Eigen::VectorXcf>(channel_data, size) *= gain;
+        }
+      };
+      if (is_reference) {
+        references.push_back(filter);
+      } else {
+        batch.AddFilter(filter, err);
+        ASSERT_FALSE(err);
+      }
+    }
+    buffers.emplace_back(block_size, channel_counts[filter_idx]);
+  }
+  ASSERT_EQ(batch.filter_count(), channel_counts.size());
+
+  // filters with another configuration are rejected
+  auto other = std::make_shared<rtff::Filter>();
+  other->Init(1, 512, 256, err);
+  ASSERT_FALSE(err);
+  other->set_block_size(block_size);
+  batch.AddFilter(other, err);
+  ASSERT_TRUE(err);
+  err.clear();
+  // so are filters with another denormal flush setting
+  other->Init(1, 256, 192, err);
+  ASSERT_FALSE(err);
+  other->set_block_size(block_size);
+  other->set_denormal_flush(false);
+  batch.AddFilter(other, err);
+  ASSERT_TRUE(err);
+  err.clear();
+
+  std::vector<rtff::AudioBuffer*> buffer_ptrs;
+  for (auto& buffer : buffers) {
+    buffer_ptrs.push_back(&buffer);
+  }
+  for (auto index = 0; index < 20; index++) {
+    std::vector<rtff::AudioBuffer> expected;
+    for (auto filter_idx = 0; filter_idx < buffers.size(); filter_idx++) {
+      auto& buffer = buffers[filter_idx];
+      Channels(buffer)
+          .setRandom();
+      expected.push_back(buffer);
+      references[filter_idx]->ProcessBlock(&expected.back());
+    }
+    batch.ProcessBlocks(buffer_ptrs);
+    for (auto filter_idx = 0; filter_idx < buffers.size(); filter_idx++) {
+      auto channel_count = buffers[filter_idx].channel_count();
+      auto result = Channels(buffers[filter_idx]);
+      auto expected_result = Channels(expected[filter_idx]);
+      ASSERT_TRUE(result.isApprox(expected_result, 1e-5));
+    }
+  }
+}
+
+// Test that the stream processor gives the same result as a serial processing
+TEST(RTFF, StreamProcessor) {
+  const auto stream_count = 6;
+  const auto block_count = 20;
+  const auto block_size = 256;
+  const auto channel_number = 2;
+  std::error_code err;
+
+  rtff::StreamProcessor processor(3);
+  ASSERT_EQ(processor.thread_count(), 3);
+  std::vector<std::shared_ptr<rtff::Filter>> references;
+  for (auto stream_idx = 0; stream_idx < stream_count; stream_idx++) {
+    for (auto is_reference : {false, true}) {
+      auto filter = std::make_shared<rtff::Filter>();
+      filter->Init(channel_number, 512, 256, err);
+      ASSERT_FALSE(err);
+      filter->set_block_size(block_size);
+      // a different gain per stream, to check streams don't get mixed up
+      auto gain = 1.0f / (stream_idx + 1);
+      filter->execute = [gain](std::vector<std::complex<float>*> data,
+                               uint32_t size) {
+        for (auto channel_data : data) {
+          Eigen::Map<Eigen::VectorXcf>(channel_data, size) *= gain;
+        }
+      };
+      if (is_reference) {
+        references.push_back(filter);
+      } else {
+        ASSERT_EQ(processor.AddStream(filter), stream_idx);
+      }
+    }
+  }
+  ASSERT_EQ(processor.stream_count(), stream_count);
+
+  std::vector<std::vector<rtff::AudioBuffer>> buffers(stream_count);
+  std::vector<std::vector<rtff::AudioBuffer>> expected(stream_count);
+  for (auto stream_idx = 0; stream_idx < stream_count; stream_idx++) {
+    for (auto block_idx = 0; block_idx < block_count; block_idx++) {
+      rtff::AudioBuffer buffer(block_size, channel_number);
+      Channels(buffer)
+          .setRandom();
+      buffers[stream_idx].push_back(buffer);
+      references[stream_idx]->ProcessBlock(&buffer);
+      expected[stream_idx].push_back(buffer);
+    }
+  }
+
+  // interleave the streams, using both the callback and the future
+  std::atomic<int> processed_count(0);
+  std::vector<std::future<void>> futures;
+  for (auto block_idx = 0; block_idx < block_count; block_idx++) {
+    for (auto stream_idx = 0; stream_idx < stream_count; stream_idx++) {
+      auto buffer = &buffers[stream_idx][block_idx];
+      if (stream_idx % 2) {
+        futures.push_back(processor.Submit(stream_idx, buffer));
+      } else {
+        processor.Submit(stream_idx, buffer,
+                         [&processed_count](rtff::AudioBuffer*) {
+                           processed_count++;
+                         });
+      }
+    }
+  }
+  for (auto& future : futures) {
+    future.wait();
+  }
+  processor.Wait();
+  ASSERT_EQ(processed_count, block_count * stream_count / 2);
+
+  for (auto stream_idx = 0; stream_idx < stream_count; stream_idx++) {
+    for (auto block_idx = 0; block_idx < block_count; block_idx++) {
+      auto& buffer = buffers[stream_idx][block_idx];
+      auto& reference = expected[stream_idx][block_idx];
+      auto result = Channels(buffer);
+      auto expected_result = Channels(reference);
+      ASSERT_TRUE(result.isApprox(expected_result));
+    }
+  }
+}
+
+// Compare the partitioned convolution with a direct convolution, for blocks
+// aligned with the partitions or not, and when swapping impulse responses
+TEST(RTFF, PartitionedConvolver) {
+  const uint32_t partition_size = 64;
+  const uint32_t ir_size = 64 * 4 + 10;
+  const uint32_t input_count = 2;
+  const uint32_t output_count = 2;
+  const uint32_t signal_size = 64 * 40;
+
+  // output 0 gets both inputs, output 1 only the second one
+  std::vector<Eigen::VectorXf> first_irs, second_irs;
+  for (auto pair_idx = 0; pair_idx < input_count * output_count; pair_idx++) {
+    first_irs.push_back(Eigen::VectorXf::Random(ir_size));
+    second_irs.push_back(Eigen::VectorXf::Random(ir_size / 2));
+  }
+  auto pointers = [](const std::vector<Eigen::VectorXf>& irs) {
+    std::vector<const float*> data;
+    for (auto& ir : irs) {
+      data.push_back(ir.data());
+    }
+    data[2] = nullptr;
+    return data;
+  };
+
+  Eigen::MatrixXf input = Eigen::MatrixXf::Random(signal_size, input_count);
+  auto convolve = [&](const std::vector<Eigen::VectorXf>& irs,
+                      uint32_t output_idx) {
+    Eigen::VectorXf result = Eigen::VectorXf::Zero(signal_size);
+    for (uint32_t input_idx = 0; input_idx < input_count; input_idx++) {
+      if (output_idx == 1 && input_idx == 0) {
+        continue;
+      }
+      auto& ir = irs[output_idx * input_count + input_idx];
+      for (uint32_t sample_idx = 0; sample_idx < signal_size; sample_idx++) {
+        for (uint32_t tap_idx = 0; tap_idx < ir.size() && tap_idx <= sample_idx;
+             tap_idx++) {
+          result[sample_idx] +=
+              ir[tap_idx] * input(sample_idx - tap_idx, input_idx);
+        }
+      }
+    }
+    return result;
+  };
+
+  for (uint32_t block_size : {64, 128, 100}) {
+    std::error_code err;
+    rtff::PartitionedConvolver convolver;
+    convolver.Init(input_count, output_count, partition_size, 5, err);
+    ASSERT_FALSE(err);
+    convolver.set_block_size(block_size);
+    ASSERT_EQ(convolver.FrameLatency(),
+              block_size % partition_size ? partition_size : 0);
+
+    // too long impulse responses are rejected
+    std::vector<Eigen::VectorXf> long_irs(input_count * output_count,
+                                          Eigen::VectorXf::Ones(64 * 6));
+    convolver.Prepare(pointers(long_irs), 64 * 6, err);
+    ASSERT_TRUE(err);
+    err.clear();
+
+    auto first = convolver.Prepare(pointers(first_irs), ir_size, err);
+    ASSERT_FALSE(err);
+    auto second = convolver.Prepare(pointers(second_irs), ir_size / 2, err);
+    ASSERT_FALSE(err);
+    convolver.set_impulse_response(first, err);
+    ASSERT_FALSE(err);
+
+    Eigen::MatrixXf output = Eigen::MatrixXf::Zero(signal_size, output_count);
+    rtff::AudioBuffer input_block(block_size, input_count);
+    rtff::AudioBuffer output_block(block_size, output_count);
+    const uint32_t block_count = signal_size / block_size;
+    const uint32_t swap_block = block_count / 2;
+    for (uint32_t block_idx = 0; block_idx < block_count; block_idx++) {
+      if (block_idx == swap_block) {
+        convolver.set_impulse_response(second, err);
+        ASSERT_FALSE(err);
+      }
+      Channels(input_block) =
+          input.middleRows(block_idx * block_size, block_size);
+      convolver.ProcessBlock(input_block, &output_block);
+      output.middleRows(block_idx * block_size, block_size) =
+          Channels(output_block);
+    }
+
+    // the swap is effective from the first partition processed after it
+    auto latency = convolver.FrameLatency();
+    auto swap_frame = swap_block * block_size;
+    auto first_end = swap_frame / partition_size * partition_size;
+    auto second_start = first_end + partition_size;
+    auto second_end = block_count * block_size - latency;
+    for (uint32_t output_idx = 0; output_idx < output_count; output_idx++) {
+      auto expected_first = convolve(first_irs, output_idx);
+      auto expected_second = convolve(second_irs, output_idx);
+      ASSERT_TRUE(output.col(output_idx)
+                      .segment(latency, first_end - latency)
+                      .isApprox(expected_first.head(first_end - latency),
+                                1e-4));
+      ASSERT_TRUE(output.col(output_idx)
+                      .segment(second_start + latency,
+                               second_end - second_start)
+                      .isApprox(expected_second.segment(
+                                    second_start, second_end - second_start),
+                                1e-4));
+    }
+
+    // the audio thread moved on, so the first impulse responses can go
+    std::weak_ptr<const rtff::PartitionedConvolver::ImpulseResponse>
+        released = first;
+    first.reset();
+    ASSERT_FALSE(released.expired());
+    convolver.ReleaseUnused();
+    ASSERT_TRUE(released.expired());
+  }
+}
+
+// Overlap-save gives the exact linear convolution of a FIR applied to the
+// spectrum, with the reported latency
+TEST(RTFF, OverlapSave) {
+  const uint32_t fft_size = 512;
+  const uint32_t filter_length = 129;
+  const uint32_t signal_size = 44100;
+
+  rtff::Filter filter;
+  std::error_code err;
+  filter.InitOverlapSave(1, fft_size, filter_length + 1000, err);
+  ASSERT_TRUE(err);
+  err.clear();
+  filter.InitOverlapSave(1, fft_size, filter_length, err);
+  ASSERT_FALSE(err);
+  ASSERT_TRUE(filter.overlap_save());
+  ASSERT_EQ(filter.hop_size(), fft_size - filter_length + 1);
+  for (uint32_t block_size : {128, 384, 300, 1000}) {
+    filter.set_block_size(block_size);
+    ASSERT_EQ(filter.FrameLatency(), GetLatency(filter));
+  }
+
+  // the response of the FIR on the transform bins
+  Eigen::VectorXf taps = Eigen::VectorXf::Random(filter_length);
+  Eigen::VectorXcf response(fft_size / 2 + 1);
+  for (uint32_t bin_idx = 0; bin_idx < response.size(); bin_idx++) {
+    std::complex<double> sum = 0;
+    for (uint32_t tap_idx = 0; tap_idx < filter_length; tap_idx++) {
+      sum += std::polar<double>(taps[tap_idx],
+                                -2 * M_PI * bin_idx * tap_idx / fft_size);
+    }
+    response[bin_idx] = sum;
+  }
+  filter.execute = [&response](std::vector<std::complex<float>*> data,
+                               uint32_t size) {
+    Eigen::Map<Eigen::VectorXcf>(data[0], size).array() *= response.array();
+  };
+
+  const uint32_t block_size = 300;
+  filter.InitOverlapSave(1, fft_size, filter_length, err);
+  ASSERT_FALSE(err);
+  filter.set_block_size(block_size);
+  Eigen::VectorXf input = Eigen::VectorXf::Random(signal_size);
+  Eigen::VectorXf output(signal_size);
+  rtff::AudioBuffer buffer(block_size, 1);
+  const uint32_t block_count = signal_size / block_size;
+  for (uint32_t block_idx = 0; block_idx < block_count; block_idx++) {
+    Eigen::Map<Eigen::VectorXf>(buffer.data(0), block_size) =
+        input.segment(block_idx * block_size, block_size);
+    filter.ProcessBlock(&buffer);
+    output.segment(block_idx * block_size, block_size) =
+        Eigen::Map<Eigen::VectorXf>(buffer.data(0), block_size);
+  }
+
+  auto latency = filter.FrameLatency();
+  auto size = block_count * block_size - latency;
+  Eigen::VectorXf expected = Eigen::VectorXf::Zero(size);
+  for (uint32_t sample_idx = 0; sample_idx < size; sample_idx++) {
+    for (uint32_t tap_idx = 0; tap_idx < filter_length && tap_idx <= sample_idx;
+         tap_idx++) {
+      expected[sample_idx] += taps[tap_idx] * input[sample_idx - tap_idx];
+    }
+  }
+  // skip the first blocks, when the output buffer isn't full yet
+  const uint32_t start = 2 * fft_size;
+  ASSERT_TRUE(output.segment(latency + start, size - start)
+                  .isApprox(expected.tail(size - start), 1e-4));
+}
+
 // Test the Hann window
 TEST(RTFF, HannWindow) {
   rtff::Filter filter;
@@ -294,3 +1084,892 @@ TEST(RTFF, HannWindow) {
     filter.ProcessBlock(&buffer);
   }
 }
+
+// Buffers backed by huge pages give the same output, also once the block size
+// changed
+TEST(RTFF, HugePages) {
+  const uint32_t channel_count = 2;
+  std::vector<Eigen::MatrixXf> outputs;
+  for (bool huge_pages : {false, true}) {
+    MyFilter filter;
+    filter.set_huge_pages(huge_pages);
+    ASSERT_EQ(filter.huge_pages(), huge_pages);
+    std::error_code err;
+    filter.Init(channel_count, 2048, 1536, rtff::fft_window::Type::Hann, err);
+    ASSERT_FALSE(err);
+
+    std::srand(0);
+    Eigen::MatrixXf output(0, channel_count);
+    for (uint32_t block_size : {512, 300}) {
+      filter.set_block_size(block_size);
+      rtff::AudioBuffer buffer(block_size, channel_count);
+      for (auto block_idx = 0; block_idx < 20; block_idx++) {
+        Channels(buffer).setRandom();
+        filter.ProcessBlock(&buffer);
+        output.conservativeResize(output.rows() + block_size, Eigen::NoChange);
+        output.bottomRows(block_size) = Channels(buffer);
+      }
+    }
+    outputs.push_back(output);
+  }
+  ASSERT_EQ(outputs[0], outputs[1]);
+}
+
+// Denormals are flushed while processing only, and the overlap-add tail can
+// be flushed to zero
+TEST(RTFF, Denormals) {
+  volatile float tiny = std::numeric_limits<float>::min();
+  auto denormal = [&tiny]() { return tiny / 16; };
+  ASSERT_NE(denormal(), 0);
+  if (rtff::ScopedDenormalFlush::Supported()) {
+    rtff::ScopedDenormalFlush flush;
+    ASSERT_EQ(denormal(), 0);
+    {
+      rtff::ScopedDenormalFlush nested;
+      ASSERT_EQ(denormal(), 0);
+    }
+    ASSERT_EQ(denormal(), 0);
+  }
+  ASSERT_NE(denormal(), 0);
+
+  // a burst of noise followed by silence
+  const uint32_t channel_count = 2;
+  const uint32_t block_size = 256;
+  std::vector<Eigen::MatrixXf> outputs;
+  for (float threshold : {0.f, 1e-3f}) {
+    rtff::Filter filter;
+    std::error_code err;
+    filter.Init(channel_count, 1024, 768, rtff::fft_window::Type::Hann, err);
+    ASSERT_FALSE(err);
+    filter.set_block_size(block_size);
+    filter.set_silence_detection(true);
+    filter.set_tail_flush_threshold(threshold);
+    ASSERT_EQ(filter.tail_flush_threshold(), threshold);
+    ASSERT_TRUE(filter.denormal_flush());
+
+    std::srand(0);
+    Eigen::MatrixXf output(block_size * 20, channel_count);
+    rtff::AudioBuffer buffer(block_size, channel_count);
+    for (uint32_t block_idx = 0; block_idx < 20; block_idx++) {
+      if (block_idx < 4) {
+        Channels(buffer).setRandom();
+      } else {
+        Channels(buffer).setZero();
+      }
+      filter.ProcessBlock(&buffer);
+      // the floating point mode of the caller is restored
+      ASSERT_NE(denormal(), 0);
+      output.middleRows(block_idx * block_size, block_size) = Channels(buffer);
+    }
+    outputs.push_back(output);
+  }
+  ASSERT_TRUE(outputs[1].isApprox(outputs[0], 1e-2));
+  ASSERT_TRUE(outputs[1].bottomRows(block_size * 8).isZero(0));
+}
+
+// Switching configuration doesn't allocate nor glitch, and the latency matches
+// the new configuration once the switch is over
+TEST(RTFF, Reconfigure) {
+  const uint32_t channel_count = 2;
+  const uint32_t block_size = 256;
+  std::error_code err;
+  rtff::Filter filter;
+  // every processed frame has the size of the configuration being processed
+  filter.execute = [&filter](std::vector<std::complex<float>*> data,
+                             uint32_t size) {
+    ASSERT_EQ(size, filter.fft_size() / 2 + 1);
+  };
+  filter.Init(channel_count, 1024, 512, rtff::fft_window::Type::Hann, err);
+  ASSERT_FALSE(err);
+  filter.set_block_size(block_size);
+
+  // only prepared configurations can be switched to
+  filter.Reconfigure(2048, 1536, rtff::fft_window::Type::Hann, err);
+  ASSERT_TRUE(err);
+  err.clear();
+  filter.Prepare(4096, channel_count, err);
+  ASSERT_FALSE(err);
+  ASSERT_EQ(filter.max_fft_size(), 4096);
+  filter.PrepareConfiguration(8192, 4096, rtff::fft_window::Type::Hann, err);
+  ASSERT_TRUE(err);
+  err.clear();
+  filter.PrepareConfiguration(2048, 1536, rtff::fft_window::Type::Hann, err);
+  ASSERT_FALSE(err);
+  filter.PrepareConfiguration(4096, 2048, rtff::fft_window::Type::Hamming,
+                              err);
+  ASSERT_FALSE(err);
+  filter.Reconfigure(512, 256, rtff::fft_window::Type::Hann, err);
+  ASSERT_TRUE(err);
+  err.clear();
+
+  // a constant signal with a slow sine, so that a latency change can't be
+  // heard as a glitch
+  auto signal = [](uint32_t channel_idx, int64_t sample_idx) {
+    if (sample_idx < 0) {
+      return 0.f;
+    }
+    return 0.5f + 0.25f * std::sin(sample_idx * 0.01f + channel_idx);
+  };
+
+  // 1024 -> 2048 -> 4096 with another window -> back to 1024
+  struct Switch {
+    uint32_t fft_size;
+    uint32_t overlap;
+    rtff::fft_window::Type window_type;
+  };
+  const std::vector<Switch> switches = {
+      {2048, 1536, rtff::fft_window::Type::Hann},
+      {4096, 2048, rtff::fft_window::Type::Hamming},
+      {1024, 512, rtff::fft_window::Type::Hann}};
+  const uint32_t blocks_per_switch = 150;
+  rtff::AudioBuffer buffer(block_size, channel_count);
+  int64_t sample_idx = 0;
+  Eigen::internal::set_is_malloc_allowed(false);
+  for (auto& next : switches) {
+    auto latency = filter.FrameLatency();
+    for (uint32_t block_idx = 0; block_idx < blocks_per_switch; block_idx++) {
+      for (uint32_t channel_idx = 0; channel_idx < channel_count;
+           channel_idx++) {
+        for (uint32_t frame_idx = 0; frame_idx < block_size; frame_idx++) {
+          buffer.data(channel_idx)[frame_idx] =
+              signal(channel_idx, sample_idx + frame_idx);
+        }
+      }
+      // the last block of a switch is still crossfaded
+      auto switching = filter.reconfiguring();
+      filter.ProcessBlock(&buffer);
+      for (uint32_t channel_idx = 0; channel_idx < channel_count;
+           channel_idx++) {
+        for (uint32_t frame_idx = 0; frame_idx < block_size; frame_idx++) {
+          auto output = buffer.data(channel_idx)[frame_idx];
+          auto output_idx = sample_idx + frame_idx;
+          if (output_idx < latency + 4096) {
+            continue;
+          }
+          if (switching) {
+            // a crossfade of two delayed versions of the signal
+            ASSERT_LE(std::abs(output - 0.5f), 0.25f + 1e-3f);
+          } else {
+            ASSERT_NEAR(output,
+                        signal(channel_idx, output_idx - filter.FrameLatency()),
+                        1e-3);
+          }
+        }
+      }
+      sample_idx += block_size;
+      if (!filter.reconfiguring()) {
+        latency = filter.FrameLatency();
+      }
+    }
+    ASSERT_FALSE(filter.reconfiguring());
+
+    filter.Reconfigure(next.fft_size, next.overlap, next.window_type, err);
+    ASSERT_FALSE(err);
+    ASSERT_TRUE(filter.reconfiguring());
+    // the configuration only changes once the switch is over
+    ASSERT_EQ(filter.FrameLatency(), latency);
+  }
+  for (auto block_idx = 0; block_idx < 100 && filter.reconfiguring();
+       block_idx++) {
+    filter.ProcessBlock(&buffer);
+  }
+  Eigen::internal::set_is_malloc_allowed(true);
+  ASSERT_FALSE(filter.reconfiguring());
+  ASSERT_EQ(filter.fft_size(), 1024);
+  ASSERT_EQ(filter.windows_type(), rtff::fft_window::Type::Hann);
+
+  // switching back to the current configuration cancels the switch
+  filter.Reconfigure(2048, 1536, rtff::fft_window::Type::Hann, err);
+  ASSERT_FALSE(err);
+  ASSERT_TRUE(filter.reconfiguring());
+  filter.Reconfigure(1024, 512, rtff::fft_window::Type::Hann, err);
+  ASSERT_FALSE(err);
+  ASSERT_FALSE(filter.reconfiguring());
+
+  // batched filters can't switch configurations
+  auto batched = std::make_shared<rtff::Filter>();
+  batched->execute = [](std::vector<std::complex<float>*> data,
+                        uint32_t size) {};
+  batched->Prepare(4096, channel_count, err);
+  ASSERT_FALSE(err);
+  rtff::FilterBatch batch;
+  batch.AddFilter(batched, err);
+  ASSERT_EQ(err, std::errc::invalid_argument);
+}
+
+// The history keeps the last analyzed frames, ordered by time
+TEST(RTFF, FrameHistory) {
+  using Storage = rtff::FrameHistory::Storage;
+  const uint32_t channel_count = 2;
+  const uint32_t frame_count = 5;
+  for (auto storage : {Storage::Complex, Storage::Magnitude, Storage::Half}) {
+    rtff::Filter filter;
+    std::error_code err;
+    filter.Init(channel_count, 256, 128, rtff::fft_window::Type::Hann, err);
+    ASSERT_FALSE(err);
+    filter.set_block_size(128);
+    filter.set_frame_history(frame_count, storage);
+
+    // every frame the callback received, before it modifies them
+    std::vector<Eigen::MatrixXcf> received;
+    auto& history = filter.frame_history();
+    filter.execute = [&](std::vector<std::complex<float>*> data,
+                         uint32_t size) {
+      Eigen::MatrixXcf frame(size, channel_count);
+      for (uint32_t channel_idx = 0; channel_idx < channel_count;
+           channel_idx++) {
+        frame.col(channel_idx) =
+            Eigen::Map<Eigen::VectorXcf>(data[channel_idx], size);
+        Eigen::Map<Eigen::VectorXcf>(data[channel_idx], size).setZero();
+      }
+      received.push_back(frame);
+
+      ASSERT_EQ(history.size(), std::min<size_t>(received.size(),
+                                                 frame_count));
+      ASSERT_EQ(history.bin_count(), size);
+      for (uint32_t channel_idx = 0; channel_idx < channel_count;
+           channel_idx++) {
+        for (uint32_t age = 0; age < history.size(); age++) {
+          auto& expected = received[received.size() - 1 - age];
+          // frames are contiguous, from the oldest to the newest
+          auto frame_idx = (history.size() - 1 - age) * size;
+          if (storage == Storage::Magnitude) {
+            auto frame = Eigen::Map<const Eigen::VectorXf>(
+                history.magnitudes(channel_idx) + frame_idx, size);
+            ASSERT_TRUE(frame.isApprox(expected.col(channel_idx).cwiseAbs()));
+            continue;
+          }
+          Eigen::VectorXcf frame(size);
+          history.ReadFrame(age, channel_idx, frame.data());
+          if (storage == Storage::Complex) {
+            ASSERT_EQ(frame, expected.col(channel_idx));
+            ASSERT_EQ(frame, Eigen::Map<const Eigen::VectorXcf>(
+                                 history.frames(channel_idx) + frame_idx,
+                                 size));
+          } else {
+            ASSERT_TRUE(frame.isApprox(expected.col(channel_idx), 1e-3));
+          }
+        }
+      }
+    };
+
+    rtff::AudioBuffer buffer(128, channel_count);
+    for (auto block_idx = 0; block_idx < 20; block_idx++) {
+      Channels(buffer).setRandom();
+      filter.ProcessBlock(&buffer);
+    }
+    ASSERT_GT(received.size(), frame_count);
+  }
+
+  // half precision conversions round to nearest and keep special values
+  for (float value : {0.f, 1.f, -2.5f, 65504.f, 6.1035156e-05f,
+                      5.9604645e-08f, -0.333251953125f}) {
+    ASSERT_EQ(rtff::FrameHistory::HalfToFloat(
+                  rtff::FrameHistory::FloatToHalf(value)),
+              value);
+  }
+  ASSERT_EQ(rtff::FrameHistory::HalfToFloat(
+                rtff::FrameHistory::FloatToHalf(1e6f)),
+            std::numeric_limits<float>::infinity());
+  // ties go to the even mantissa
+  ASSERT_EQ(rtff::FrameHistory::FloatToHalf(1 + 2.f / 4096), 0x3c00);
+  ASSERT_EQ(rtff::FrameHistory::FloatToHalf(1 + 6.f / 4096), 0x3c02);
+}
+
+// The callback sees the next analyzed frames, and the output is delayed by the
+// lookahead hops
+TEST(RTFF, Lookahead) {
+  const uint32_t channel_count = 2;
+  const uint32_t lookahead = 3;
+  const uint32_t block_size = 128;
+  const uint32_t block_count = 30;
+  for (auto silence_detection : {false, true}) {
+    std::error_code err;
+    rtff::Filter reference;
+    reference.Init(channel_count, 256, 128, rtff::fft_window::Type::Hann, err);
+    ASSERT_FALSE(err);
+    reference.set_block_size(block_size);
+    rtff::Filter filter;
+    filter.Init(channel_count, 256, 128, rtff::fft_window::Type::Hann, err);
+    ASSERT_FALSE(err);
+    filter.set_block_size(block_size);
+    filter.set_silence_detection(silence_detection);
+    filter.set_lookahead(lookahead);
+    ASSERT_EQ(filter.lookahead(), lookahead);
+    ASSERT_EQ(filter.FrameLatency(),
+              reference.FrameLatency() + lookahead * filter.hop_size());
+
+    // every frame the callback received, with its lookahead frames
+    std::vector<Eigen::MatrixXcf> received;
+    std::vector<std::vector<Eigen::MatrixXcf>> lookahead_frames;
+    filter.execute = [&](std::vector<std::complex<float>*> data,
+                         uint32_t size) {
+      Eigen::MatrixXcf frame(size, channel_count);
+      std::vector<Eigen::MatrixXcf> next_frames(lookahead, frame);
+      for (uint32_t channel_idx = 0; channel_idx < channel_count;
+           channel_idx++) {
+        auto channel = Eigen::Map<Eigen::VectorXcf>(data[channel_idx], size);
+        frame.col(channel_idx) = channel;
+        channel *= 0.5f;
+        for (uint32_t frame_idx = 1; frame_idx <= lookahead; frame_idx++) {
+          next_frames[frame_idx - 1].col(channel_idx) =
+              Eigen::Map<const Eigen::VectorXcf>(
+                  filter.lookahead_frame(frame_idx, channel_idx), size);
+        }
+      }
+      received.push_back(frame);
+      lookahead_frames.push_back(next_frames);
+    };
+    reference.execute = [](std::vector<std::complex<float>*> data,
+                           uint32_t size) {
+      for (auto channel : data) {
+        Eigen::Map<Eigen::VectorXcf>(channel, size) *= 0.5f;
+      }
+    };
+
+    Eigen::MatrixXf output(block_size * block_count, channel_count);
+    Eigen::MatrixXf expected(block_size * block_count, channel_count);
+    rtff::AudioBuffer buffer(block_size, channel_count);
+    rtff::AudioBuffer reference_buffer(block_size, channel_count);
+    for (uint32_t block_idx = 0; block_idx < block_count; block_idx++) {
+      Channels(buffer).setRandom();
+      Channels(reference_buffer) = Channels(buffer);
+      filter.ProcessBlock(&buffer);
+      reference.ProcessBlock(&reference_buffer);
+      output.middleRows(block_idx * block_size, block_size) = Channels(buffer);
+      expected.middleRows(block_idx * block_size, block_size) =
+          Channels(reference_buffer);
+    }
+
+    // lookahead frames are the next frames, before they are processed
+    ASSERT_GT(received.size(), lookahead + 1);
+    for (size_t idx = 0; idx + lookahead < received.size(); idx++) {
+      for (uint32_t frame_idx = 1; frame_idx <= lookahead; frame_idx++) {
+        ASSERT_EQ(lookahead_frames[idx][frame_idx - 1],
+                  received[idx + frame_idx]);
+      }
+    }
+    auto delay = lookahead * filter.hop_size();
+    ASSERT_TRUE(output.topRows(delay).isZero());
+    ASSERT_TRUE(output.bottomRows(output.rows() - delay)
+                    .isApprox(expected.topRows(expected.rows() - delay)));
+  }
+
+  // the filters of a chain read the lookahead frames of their segment
+  std::error_code err;
+  auto filter = std::make_shared<rtff::Filter>();
+  filter->Init(1, 256, 128, err);
+  ASSERT_FALSE(err);
+  filter->set_lookahead(1);
+  filter->set_block_size(block_size);
+  std::vector<Eigen::VectorXcf> received;
+  std::vector<Eigen::VectorXcf> next_frames;
+  filter->execute = [&](std::vector<std::complex<float>*> data,
+                        uint32_t size) {
+    received.push_back(Eigen::Map<Eigen::VectorXcf>(data[0], size));
+    next_frames.push_back(
+        Eigen::Map<const Eigen::VectorXcf>(filter->lookahead_frame(1, 0), size));
+  };
+  rtff::FilterChain chain;
+  chain.Add(filter, err);
+  ASSERT_FALSE(err);
+  chain.set_block_size(block_size);
+  ASSERT_EQ(chain.FrameLatency(), filter->FrameLatency());
+  rtff::AudioBuffer buffer(block_size, 1);
+  for (uint32_t block_idx = 0; block_idx < 10; block_idx++) {
+    Channels(buffer).setRandom();
+    chain.ProcessBlock(&buffer);
+  }
+  ASSERT_GT(received.size(), 2);
+  for (size_t idx = 0; idx + 1 < received.size(); idx++) {
+    ASSERT_EQ(next_frames[idx], received[idx + 1]);
+  }
+
+  // batched filters have no lookahead
+  rtff::FilterBatch batch;
+  batch.AddFilter(filter, err);
+  ASSERT_EQ(err, std::errc::invalid_argument);
+}
+
+// The sparse projections match the dense band x bin matrix
+TEST(RTFF, Filterbank) {
+  const uint32_t fft_size = 1024;
+  const uint32_t bin_count = fft_size / 2 + 1;
+  // more channels than a projection group
+  const uint32_t channel_count = 11;
+  std::error_code err;
+  std::vector<rtff::Filterbank> filterbanks(3);
+  filterbanks[0].InitMel(fft_size, 44100, 40, 0, 22050, err);
+  ASSERT_FALSE(err);
+  filterbanks[1].InitConstantQ(fft_size, 44100, 32.7f, 12, 84, err);
+  ASSERT_FALSE(err);
+  Eigen::MatrixXf custom = Eigen::MatrixXf::Zero(bin_count, 3);
+  custom.col(0).segment(10, 5).setConstant(0.5f);
+  custom.col(2).segment(100, 300).setRandom();
+  filterbanks[2].Init(bin_count, 3, custom.data(), err);
+  ASSERT_FALSE(err);
+
+  Eigen::MatrixXcf frames = Eigen::MatrixXcf::Random(bin_count, channel_count);
+  std::vector<const std::complex<float>*> data;
+  for (uint32_t channel_idx = 0; channel_idx < channel_count; channel_idx++) {
+    data.push_back(frames.col(channel_idx).data());
+  }
+  for (size_t filterbank_idx = 0; filterbank_idx < filterbanks.size();
+       filterbank_idx++) {
+    auto& filterbank = filterbanks[filterbank_idx];
+    auto band_count = filterbank.band_count();
+    ASSERT_EQ(filterbank.bin_count(), bin_count);
+    Eigen::MatrixXf dense = Eigen::MatrixXf::Zero(band_count, bin_count);
+    for (uint32_t band_idx = 0; band_idx < band_count; band_idx++) {
+      // every triangular band weights at least a bin
+      if (filterbank_idx < 2) {
+        ASSERT_GT(filterbank.band_size(band_idx), 0);
+      }
+      dense.row(band_idx).segment(filterbank.band_start(band_idx),
+                                  filterbank.band_size(band_idx)) =
+          Eigen::Map<const Eigen::RowVectorXf>(
+              filterbank.band_weights(band_idx),
+              filterbank.band_size(band_idx));
+    }
+    if (filterbank_idx < 2) {
+      // sparse enough to matter
+      ASSERT_LT((dense.array() != 0).count(), dense.size() / 10);
+    }
+
+    Eigen::MatrixXf bands(band_count, channel_count);
+    std::vector<float*> band_data;
+    for (uint32_t channel_idx = 0; channel_idx < channel_count;
+         channel_idx++) {
+      band_data.push_back(bands.col(channel_idx).data());
+    }
+    for (auto power : {false, true}) {
+      Eigen::MatrixXf magnitudes =
+          power ? frames.cwiseAbs2().eval() : frames.cwiseAbs().eval();
+      Eigen::internal::set_is_malloc_allowed(false);
+      filterbank.ProjectMagnitudes(data.data(), channel_count,
+                                   band_data.data(), power);
+      Eigen::internal::set_is_malloc_allowed(true);
+      ASSERT_TRUE(bands.isApprox(dense * magnitudes, 1e-5));
+
+      bands.setZero();
+      std::vector<const float*> magnitude_data;
+      for (uint32_t channel_idx = 0; channel_idx < channel_count;
+           channel_idx++) {
+        magnitude_data.push_back(magnitudes.col(channel_idx).data());
+      }
+      Eigen::internal::set_is_malloc_allowed(false);
+      filterbank.Project(magnitude_data.data(), channel_count,
+                         band_data.data());
+      Eigen::internal::set_is_malloc_allowed(true);
+      ASSERT_TRUE(bands.isApprox(dense * magnitudes, 1e-5));
+    }
+
+    // the inverse projection is projected back onto the same bands
+    Eigen::MatrixXf bins(bin_count, channel_count);
+    std::vector<float*> bin_data;
+    std::vector<const float*> const_band_data;
+    for (uint32_t channel_idx = 0; channel_idx < channel_count;
+         channel_idx++) {
+      bin_data.push_back(bins.col(channel_idx).data());
+      const_band_data.push_back(bands.col(channel_idx).data());
+    }
+    Eigen::internal::set_is_malloc_allowed(false);
+    filterbank.Unproject(const_band_data.data(), channel_count,
+                         bin_data.data());
+    Eigen::internal::set_is_malloc_allowed(true);
+    ASSERT_TRUE((dense * bins).isApprox(bands, 1e-3));
+  }
+  // the dense weights of a custom filterbank are kept as they are
+  ASSERT_EQ(filterbanks[2].band_start(0), 10);
+  ASSERT_EQ(filterbanks[2].band_size(0), 5);
+  ASSERT_EQ(filterbanks[2].band_size(1), 0);
+
+  // constant-Q bands get wider with the frequency
+  auto& constant_q = filterbanks[1];
+  ASSERT_GT(constant_q.band_size(83), constant_q.band_size(60));
+
+  rtff::Filterbank filterbank;
+  filterbank.InitMel(fft_size, 44100, 40, 0, 30000, err);
+  ASSERT_EQ(err, std::errc::invalid_argument);
+  err.clear();
+  filterbank.InitConstantQ(fft_size, 44100, 32.7f, 12, 200, err);
+  ASSERT_EQ(err, std::errc::invalid_argument);
+}
+
+// Every resolution is computed from the same input and the synthesis one
+// gives the expected latency
+TEST(RTFF, MultiResolution) {
+  rtff::MultiResolutionFilter filter;
+  std::error_code err;
+  // the block size can be set before Init
+  filter.set_block_size(512);
+  ASSERT_EQ(filter.block_size(), 512);
+  filter.Init(1, {{256, 64}, {1024, 256}, {4096, 1024}}, 1,
+              rtff::fft_window::Type::Hann, err);
+  ASSERT_FALSE(err);
+  ASSERT_EQ(filter.step_size(), 64);
+
+  std::vector<uint32_t> update_count(3, 0);
+  filter.execute = [&update_count](
+                       std::vector<rtff::MultiResolutionFilter::Frame>& frames) {
+    ASSERT_EQ(frames.size(), 3);
+    ASSERT_EQ(frames[0].size, 129);
+    ASSERT_EQ(frames[1].size, 513);
+    ASSERT_EQ(frames[2].size, 2049);
+    for (auto resolution_idx = 0; resolution_idx < frames.size();
+         resolution_idx++) {
+      update_count[resolution_idx] += frames[resolution_idx].updated;
+    }
+  };
+
+  filter.set_block_size(1024);
+  rtff::AudioBuffer buffer(filter.block_size(), filter.channel_count());
+  for (auto index = 0; index < 20; index++) {
+    filter.ProcessBlock(&buffer);
+  }
+  // the first step updates every resolution
+  ASSERT_EQ(update_count[1], (update_count[0] + 3) / 4);
+  ASSERT_EQ(update_count[2], (update_count[0] + 15) / 16);
+
+  filter.execute = [](std::vector<rtff::MultiResolutionFilter::Frame>&) {};
+  filter.set_block_size(512);
+  ASSERT_EQ(filter.FrameLatency(), GetLatency(filter));
+  filter.set_block_size(300);
+  ASSERT_EQ(filter.FrameLatency(), GetLatency(filter));
+
+  // invalid hop sizes
+  filter.Init(1, {{256, 64}, {1024, 100}}, -1, rtff::fft_window::Type::Hann,
+              err);
+  ASSERT_TRUE(err);
+}
+
+// Chained filters sharing a configuration are applied on a single frame
+TEST(RTFF, FilterChain) {
+  auto channel_number = 1;
+  auto block_size = 512;
+  std::error_code err;
+  auto half_gain = [](std::vector<std::complex<float>*> data, uint32_t size) {
+    Eigen::Map<Eigen::VectorXcf>(data[0], size) *= 0.5f;
+  };
+
+  rtff::FilterChain chain(false);
+  for (auto index = 0; index < 2; index++) {
+    auto filter = std::make_shared<rtff::Filter>();
+    filter->Init(channel_number, err);
+    ASSERT_FALSE(err);
+    filter->execute = half_gain;
+    chain.Add(filter, err);
+    ASSERT_FALSE(err);
+  }
+  chain.set_block_size(block_size);
+  ASSERT_EQ(chain.segment_count(), 1);
+
+  rtff::Filter reference;
+  reference.Init(channel_number, err);
+  ASSERT_FALSE(err);
+  reference.execute = [](std::vector<std::complex<float>*> data,
+                         uint32_t size) {
+    Eigen::Map<Eigen::VectorXcf>(data[0], size) *= 0.25f;
+  };
+  reference.set_block_size(block_size);
+  ASSERT_EQ(chain.FrameLatency(), reference.FrameLatency());
+
+  rtff::AudioBuffer buffer(block_size, channel_number);
+  rtff::AudioBuffer reference_buffer(block_size, channel_number);
+  for (auto index = 0; index < 50; index++) {
+    Eigen::Map<Eigen::VectorXf>(buffer.data(0), block_size).setRandom();
+    std::copy(buffer.data(0), buffer.data(0) + block_size,
+              reference_buffer.data(0));
+    chain.ProcessBlock(&buffer);
+    reference.ProcessBlock(&reference_buffer);
+    ASSERT_EQ(Eigen::Map<Eigen::VectorXf>(buffer.data(0), block_size),
+              Eigen::Map<Eigen::VectorXf>(reference_buffer.data(0), block_size));
+  }
+
+  // a different configuration can't be merged
+  auto other = std::make_shared<rtff::Filter>();
+  other->Init(channel_number, 1024, 512, err);
+  ASSERT_FALSE(err);
+  chain.Add(other, err);
+  ASSERT_TRUE(err);
+
+  // unless the chain is allowed to split
+  err.clear();
+  rtff::FilterChain split_chain;
+  auto first = std::make_shared<rtff::Filter>();
+  first->Init(channel_number, err);
+  ASSERT_FALSE(err);
+  split_chain.Add(first, err);
+  ASSERT_FALSE(err);
+  split_chain.Add(other, err);
+  ASSERT_FALSE(err);
+  ASSERT_EQ(split_chain.segment_count(), 2);
+  split_chain.set_block_size(block_size);
+  ASSERT_EQ(split_chain.FrameLatency(), GetLatency(split_chain));
+}
+
+// The analysis only filter sees the same frames as a full filter
+TEST(RTFF, AnalysisFilter) {
+  auto channel_number = 2;
+  std::error_code err;
+  rtff::Filter filter;
+  filter.Init(channel_number, err);
+  ASSERT_FALSE(err);
+  // no zero padding at the beginning of the full filter
+  filter.set_block_size(filter.fft_size());
+  rtff::AnalysisFilter analysis;
+  analysis.Init(channel_number, err);
+  ASSERT_FALSE(err);
+
+  std::vector<Eigen::VectorXcf> expected;
+  filter.execute = [&expected](std::vector<std::complex<float>*> data,
+                               uint32_t size) {
+    for (auto channel_data : data) {
+      expected.push_back(Eigen::Map<Eigen::VectorXcf>(channel_data, size));
+    }
+  };
+  uint32_t frame_idx = 0;
+  analysis.execute = [&expected, &frame_idx](
+                         std::vector<const std::complex<float>*> data,
+                         uint32_t size) {
+    for (auto channel_data : data) {
+      ASSERT_LT(frame_idx, expected.size());
+      ASSERT_EQ(Eigen::Map<const Eigen::VectorXcf>(channel_data, size),
+                expected[frame_idx]);
+      frame_idx++;
+    }
+  };
+
+  rtff::AudioBuffer buffer(filter.block_size(), channel_number);
+  for (auto index = 0; index < 10; index++) {
+    for (auto channel_idx = 0; channel_idx < channel_number; channel_idx++) {
+      Eigen::Map<Eigen::VectorXf>(buffer.data(channel_idx),
+                                  buffer.frame_count())
+          .setRandom();
+    }
+    // the full filter modifies the buffer in place
+    rtff::AudioBuffer copy = buffer;
+    filter.ProcessBlock(&copy);
+    Eigen::internal::set_is_malloc_allowed(false);
+    analysis.ProcessBlock(buffer);
+    Eigen::internal::set_is_malloc_allowed(true);
+  }
+  ASSERT_GT(frame_idx, 0);
+}
+
+// Frames produced by an analysis filter are resynthesized by the synthesis
+// filter
+TEST(RTFF, SynthesisFilter) {
+  auto channel_number = 1;
+  std::error_code err;
+  rtff::AnalysisFilter analysis;
+  analysis.Init(channel_number, err);
+  ASSERT_FALSE(err);
+  rtff::SynthesisFilter synthesis;
+  synthesis.Init(channel_number, err);
+  ASSERT_FALSE(err);
+  auto block_size = 300;
+  synthesis.set_block_size(block_size);
+
+  std::vector<Eigen::VectorXcf> frames;
+  analysis.execute = [&frames](std::vector<const std::complex<float>*> data,
+                               uint32_t size) {
+    frames.push_back(Eigen::Map<const Eigen::VectorXcf>(data[0], size));
+  };
+  auto frame_count = 44100;
+  Eigen::VectorXf input = Eigen::VectorXf::Random(frame_count);
+  rtff::AudioBuffer buffer(block_size, channel_number);
+  for (auto sample_idx = 0; sample_idx + block_size <= frame_count;
+       sample_idx += block_size) {
+    std::copy(input.data() + sample_idx,
+              input.data() + sample_idx + block_size, buffer.data(0));
+    analysis.ProcessBlock(buffer);
+  }
+
+  uint32_t frame_idx = 0;
+  synthesis.execute = [&frames, &frame_idx](
+                          std::vector<std::complex<float>*> data,
+                          uint32_t size) {
+    if (frame_idx < frames.size()) {
+      Eigen::Map<Eigen::VectorXcf>(data[0], size) = frames[frame_idx];
+    }
+    frame_idx++;
+  };
+  Eigen::VectorXf output(frame_count);
+  rtff::AudioBuffer output_buffer(block_size, channel_number);
+  for (auto sample_idx = 0; sample_idx + block_size <= frame_count;
+       sample_idx += block_size) {
+    synthesis.ProcessBlock(&output_buffer);
+    std::copy(output_buffer.data(0), output_buffer.data(0) + block_size,
+              output.data() + sample_idx);
+  }
+
+  // once every overlapping frames have been added, we get the input back
+  auto start = synthesis.fft_size();
+  auto length = frames.size() * synthesis.hop_size() - start;
+  ASSERT_TRUE(output.segment(start, length)
+                  .isApprox(input.segment(start, length), 1e-4));
+}
+
+// Frames written while analyzing are mapped back, and the complex ones
+// resynthesize exactly
+TEST(RTFF, SpectrogramFile) {
+  using Storage = rtff::FrameHistory::Storage;
+  const uint32_t channel_count = 2;
+  const uint32_t block_size = 256;
+  const uint32_t sample_count = 44100;
+  const std::string path = gResourcePath + "/rtff_spectrogram_test.rtfs";
+  std::error_code err;
+  rtff::AnalysisFilter analysis;
+  Eigen::MatrixXf input = Eigen::MatrixXf::Random(sample_count, channel_count);
+
+  for (auto storage : {Storage::Complex, Storage::Magnitude, Storage::Half}) {
+    // a new stream for each storage
+    analysis.Init(channel_count, 1024, 768, rtff::fft_window::Type::Hann, err);
+    ASSERT_FALSE(err);
+    rtff::SpectrogramFormat format;
+    format.fft_size = analysis.fft_size();
+    format.hop_size = analysis.hop_size();
+    format.window_type = rtff::fft_window::Type::Hann;
+    format.synthesis_window_type = rtff::fft_window::Type::Hann;
+    format.sample_rate = 48000;
+    format.channel_count = channel_count;
+    format.storage = storage;
+    // the queue holds every frame, so none is dropped
+    rtff::SpectrogramWriter writer(sample_count / analysis.hop_size());
+    writer.Open(path, format, err);
+    ASSERT_FALSE(err);
+
+    std::vector<Eigen::MatrixXcf> frames;
+    analysis.execute = [&](std::vector<const std::complex<float>*> data,
+                           uint32_t size) {
+      Eigen::MatrixXcf frame(size, channel_count);
+      for (uint32_t channel_idx = 0; channel_idx < channel_count;
+           channel_idx++) {
+        frame.col(channel_idx) =
+            Eigen::Map<const Eigen::VectorXcf>(data[channel_idx], size);
+      }
+      frames.push_back(frame);
+      ASSERT_TRUE(writer.Push(data.data()));
+    };
+    rtff::AudioBuffer buffer(block_size, channel_count);
+    for (uint32_t sample_idx = 0; sample_idx + block_size <= sample_count;
+         sample_idx += block_size) {
+      Channels(buffer) = input.middleRows(sample_idx, block_size);
+      analysis.ProcessBlock(buffer);
+    }
+    writer.Close(err);
+    ASSERT_FALSE(err);
+    ASSERT_EQ(writer.dropped_count(), 0);
+
+    rtff::SpectrogramReader reader;
+    reader.Open(path, err);
+    ASSERT_FALSE(err);
+    ASSERT_EQ(reader.frame_count(), frames.size());
+    ASSERT_EQ(reader.format().fft_size, format.fft_size);
+    ASSERT_EQ(reader.format().hop_size, format.hop_size);
+    ASSERT_EQ(reader.format().window_type, format.window_type);
+    ASSERT_EQ(reader.format().sample_rate, format.sample_rate);
+    ASSERT_EQ(reader.format().channel_count, channel_count);
+    ASSERT_EQ(reader.format().storage, storage);
+    auto bin_count = reader.format().bin_count();
+    for (uint64_t frame_idx = 0; frame_idx < reader.frame_count();
+         frame_idx++) {
+      for (uint32_t channel_idx = 0; channel_idx < channel_count;
+           channel_idx++) {
+        Eigen::VectorXcf expected = frames[frame_idx].col(channel_idx);
+        if (storage == Storage::Magnitude) {
+          ASSERT_TRUE(Eigen::Map<const Eigen::VectorXf>(
+                          reader.magnitudes(frame_idx, channel_idx), bin_count)
+                          .isApprox(expected.cwiseAbs()));
+          continue;
+        }
+        Eigen::VectorXcf frame(bin_count);
+        reader.ReadFrame(frame_idx, channel_idx, frame.data());
+        if (storage == Storage::Complex) {
+          ASSERT_EQ(frame, expected);
+        } else {
+          ASSERT_TRUE(frame.isApprox(expected, 1e-3));
+        }
+      }
+    }
+    if (storage != Storage::Complex) {
+      continue;
+    }
+
+    // synthesizing the mapped frames gives the same output as synthesizing
+    // the analyzed ones
+    Eigen::MatrixXf outputs[2];
+    for (auto mapped : {false, true}) {
+      rtff::SynthesisFilter synthesis;
+      synthesis.Init(channel_count, reader.format().fft_size,
+                     reader.format().fft_size - reader.format().hop_size,
+                     reader.format().window_type, err);
+      ASSERT_FALSE(err);
+      synthesis.set_block_size(block_size);
+      uint64_t frame_idx = 0;
+      synthesis.execute = [&](std::vector<std::complex<float>*> data,
+                              uint32_t size) {
+        if (frame_idx < reader.frame_count()) {
+          for (uint32_t channel_idx = 0; channel_idx < channel_count;
+               channel_idx++) {
+            auto output = Eigen::Map<Eigen::VectorXcf>(data[channel_idx], size);
+            if (mapped) {
+              output = Eigen::Map<const Eigen::VectorXcf>(
+                  reader.frame(frame_idx, channel_idx), size);
+            } else {
+              output = frames[frame_idx].col(channel_idx);
+            }
+          }
+        }
+        frame_idx++;
+      };
+      auto& output = outputs[mapped];
+      output.resize(sample_count / block_size * block_size, channel_count);
+      rtff::AudioBuffer output_buffer(block_size, channel_count);
+      for (uint32_t sample_idx = 0; sample_idx < output.rows();
+           sample_idx += block_size) {
+        synthesis.ProcessBlock(&output_buffer);
+        output.middleRows(sample_idx, block_size) = Channels(output_buffer);
+      }
+    }
+    ASSERT_EQ(outputs[1], outputs[0]);
+    auto start = format.fft_size;
+    auto length = frames.size() * format.hop_size - start;
+    ASSERT_TRUE(outputs[1]
+                    .middleRows(start, length)
+                    .isApprox(input.middleRows(start, length), 1e-4));
+  }
+
+  // a file cut short keeps its complete frames
+  rtff::SpectrogramReader reader;
+  reader.Open(path, err);
+  ASSERT_FALSE(err);
+  auto frame_count = reader.frame_count();
+  auto stride = reader.format().frame_stride();
+  auto fft_size = reader.format().fft_size;
+  reader.Close();
+  std::ifstream file(path, std::ios::binary);
+  std::string content((std::istreambuf_iterator<char>(file)),
+                      std::istreambuf_iterator<char>());
+  file.close();
+  // the header fields are little endian
+  auto header = reinterpret_cast<const uint8_t*>(content.data());
+  ASSERT_EQ(header[8] | header[9] << 8 | header[10] << 16 | header[11] << 24,
+            fft_size);
+  std::ofstream truncated(path, std::ios::binary | std::ios::trunc);
+  truncated.write(content.data(), content.size() - stride / 2);
+  truncated.close();
+  reader.Open(path, err);
+  ASSERT_FALSE(err);
+  ASSERT_EQ(reader.frame_count(), frame_count - 1);
+  reader.Close();
+
+  // other files are rejected
+  std::ofstream other(path, std::ios::binary | std::ios::trunc);
+  other << std::string(128, 'x');
+  other.close();
+  reader.Open(path, err);
+  ASSERT_EQ(err, std::errc::invalid_argument);
+  std::remove(path.c_str());
+}